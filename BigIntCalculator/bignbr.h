@@ -44,7 +44,7 @@ enum eSign
 	SIGN_NEGATIVE,
 };
 
-extern long long lModularMult;
+extern thread_local long long lModularMult;
 bool BigNbrIsZero(const limb *value, int nbrLength);
 //void squareRoot(const limb *argument, limb *sqRoot, int len, int *pLenSqRoot);
 void squareRoot(const Znum &arg, Znum & sqRoot);
@@ -317,11 +317,14 @@ extern BigInteger TestNbrBI;
 extern limb *TestNbr;
 extern limb *MontgomeryMultR2;
 extern limb  *MontgomeryMultR1;
+extern limb *MontgomeryMultN;
 //extern int NumberLength;
 #define NumberLength TestNbrBI.nbrLimbs
 extern int groupLen;
 
-void FactoringSIQSx(const Znum &NbrToFactor, Znum &Factor);
+void FactoringSIQSx(const Znum &NbrToFactor, Znum &Factor,
+	std::vector<Znum> *factorList = NULL);
+void SIQSTune(int minDigits, int maxDigits);
 void multiply(const limb *factor1, const limb *factor2, limb *result, int len, int *ResultLen);
 void int2dec(char **pOutput, long long nbr);
 void Bin2Dec(const limb *binary, char *decimal, int nbrLimbs, int groupLength);
@@ -378,5 +381,23 @@ int ZtoLimbs(limb *number, Znum numberZ, int numLen);
 int ZtoBigNbr(int number[], Znum numberZ);
 void LimbstoZ(const limb *number, Znum &numberZ, const int numLen);
 
+/* ECM step 1 on ECM_SIMD_LANES curves at once (ecmsimd.cpp). The other
+functions must not be called unless ecmSimdLanes returns a non-zero value. */
+#define ECM_SIMD_LANES 4
+#define PRAC_SWAP 16      // flag in a step of a PRAC chain: swap d and e first
+int ecmSimdLanes(void);
+void ecmSimdLoad(int lane, const limb *X, const limb *Z, const limb *AA);
+void ecmSimdStore(int lane, limb *X, limb *Z);
+void ecmSimdPrac(const unsigned char *steps);
+void ecmSimdDuplicate(void);
+
+/* ECM step 1 with the mpn functions of GMP on 64-bit limbs (ecmmpn.cpp).
+ecmMpnInit must be called first for each N. */
+void ecmMpnInit(const Znum &zN);
+void ecmMpnLoad(const limb *X, const limb *Z, const limb *AA);
+void ecmMpnStore(limb *X, limb *Z);
+void ecmMpnPrac(const unsigned char *steps);
+void ecmMpnDuplicate(void);
+
 typedef void(*mmCback)(void);
 extern mmCback modmultCallback;
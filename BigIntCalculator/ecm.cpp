@@ -21,6 +21,11 @@ Profiling indicates that about 2/3 of the CPU time is used during Modular Multip
 #define  _CRT_SECURE_NO_DEPRECATE
 #include <iostream>
 #include <Windows.h>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <map>
+#include <vector>
 #include "showtime.h"
 #include "bignbr.h"
 #include "factor.h"
@@ -32,7 +37,8 @@ static COORD coordScreen = { 0, 0 };    // home for the cursor
 static CONSOLE_SCREEN_BUFFER_INFO csbi;
 
 static int yieldFreq;
-int ElipCurvNo;            // Elliptic Curve Number
+std::atomic<int> ElipCurvNo;   // Elliptic Curve Number; last curve handed out
+bool ecmMpn = true;            // step 1 with GMP mpn arithmetic (ecmmpn.cpp)
 static int limits[] = { 10, 10, 10, 10, 10, 15, 22, 26, 35, 50, 100, 150, 250 };
 
 
@@ -48,6 +54,10 @@ static int limits[] = { 10, 10, 10, 10, 10, 15, 22, 26, 35, 50, 100, 150, 250 };
 #endif
 #define HALF_SIEVE_SIZE (SIEVE_SIZE/2)
 
+#define STAGE2_FFT 1         // 1 = FFT continuation in step 2, 0 = standard continuation
+#define FFT_B2_MULT 1000     // B2 = B1 * FFT_B2_MULT with the FFT continuation
+#define SIMD_STAGE1 1        // 1 = step 1 on several curves at once with AVX2
+
 enum eEcmResult
 {
 	FACTOR_NOT_FOUND = 0,
@@ -56,32 +66,42 @@ enum eEcmResult
 	ECM_ERROR
 };
 
-static limb AA[MAX_LEN];
-static limb DX[MAX_LEN];
-static limb DZ[MAX_LEN];
-static limb M[MAX_LEN];
-static limb TX[MAX_LEN];
-static limb TZ[MAX_LEN];
-static limb UX[MAX_LEN];
-static limb UZ[MAX_LEN];
-static limb W3[MAX_LEN];
-static limb W4[MAX_LEN];
-static limb Aux1[MAX_LEN], Aux2[MAX_LEN], Aux3[MAX_LEN], Aux4[MAX_LEN];      // work variables
-
-
-static unsigned char sieve[10 * SIEVE_SIZE];
-static unsigned char sieve2310[SIEVE_SIZE];
-static int sieveidx[GROUP_SIZE];
-static limb GcdAccumulated[MAX_LEN];
+/* curves run concurrently, one per thread. All the state of a curve is
+thread_local; the Montgomery parameters of N are only read while curves run. */
+static std::atomic<bool> ecmStop;  // set when a curve finds a factor
+static std::mutex ecmMutex;        // serialises screen output and the result
+static Znum ecmFactor;             // first factor found by any thread
+static enum eEcmResult ecmResult;
+static thread_local int ecmThreadNumber = 0;
+
+static thread_local limb AA[MAX_LEN];
+static thread_local limb DX[MAX_LEN];
+static thread_local limb DZ[MAX_LEN];
+static thread_local limb M[MAX_LEN];
+static thread_local limb TX[MAX_LEN];
+static thread_local limb TZ[MAX_LEN];
+static thread_local limb UX[MAX_LEN];
+static thread_local limb UZ[MAX_LEN];
+static thread_local limb W3[MAX_LEN];
+static thread_local limb W4[MAX_LEN];
+static thread_local limb Aux1[MAX_LEN], Aux2[MAX_LEN], Aux3[MAX_LEN], Aux4[MAX_LEN];      // work variables
+
+
+static thread_local unsigned char sieve[10 * SIEVE_SIZE];
+static thread_local unsigned char sieve2310[SIEVE_SIZE];
+#if !STAGE2_FFT
+static thread_local int sieveidx[GROUP_SIZE];
+#endif
+static thread_local limb GcdAccumulated[MAX_LEN];
 
-static int indexM, maxIndexM;
-static bool foundByLehman;
+static thread_local int indexM, maxIndexM;
+static std::atomic<bool> foundByLehman;
 
 static int SmallPrime[670] = { 0 }; /* Primes < 5000 */
-static int nbrPrimes, indexPrimes, StepECM;
+static thread_local int nbrPrimes, indexPrimes, StepECM;
 char lowerText[30000];
 char *ptrLowerText;
-static Znum BiGD;   // used by function gcdIsOne to return result
+static thread_local Znum BiGD;   // used by function gcdIsOne to return result
 /* forward function declarations */
 static void add3(limb *x3, limb *z3, const limb *x2, const limb *z2, 
 	const limb *x1, const limb *z1, const limb *x, const limb *z);
@@ -194,15 +214,25 @@ static int lucas_cost(int n, double v)
 	return c;
 }
 
-/* computes nP from P=(x:z) and puts the result in (x:z). Assumes n>2. 
-uses global variables Aux1, Aux2, Aux3, Aux4 */
-static void prac(int n, limb *x, limb *z, limb *xT, limb *zT, limb *xT2, limb *zT2)
+/* The Lucas chain used by prac depends only on n, not on the curve, so the
+chains for all odd primes <= B1 are worked out once and shared by all curves.
+Each step of a chain is one byte: the number of the condition in Table 4
+(1 to 9), plus PRAC_SWAP if d and e are swapped first. A zero ends the chain.
+The same chains drive the SIMD version of prac in ecmsimd.cpp. */
+struct pracChains {
+	std::vector<int> primes;              // odd primes <= B1
+	std::vector<unsigned int> offsets;    // start of the chain for each prime
+	std::vector<unsigned char> steps;     // all the chains
+	std::vector<int> mults;               // modular multiplications of each chain
+};
+static std::mutex pracMutex;
+static std::map<long long, pracChains> pracCache;
+
+/* append the chain that computes nP to steps and return the number of
+modular multiplications it needs. Assumes n>2. */
+static int PracChain(int n, std::vector<unsigned char> &steps)
 {
-	int d, e, r, i;
-	limb *t;
-	limb *xA = x, *zA = z;
-	limb *xB = Aux1, *zB = Aux2;
-	limb *xC = Aux3, *zC = Aux4;
+	int d, e, r, i, cost;
 	double v[] =
 	{
 		1.61803398875,
@@ -227,91 +257,185 @@ static void prac(int n, limb *x, limb *z, limb *xT, limb *zT, limb *xT2, limb *z
 			i = d;
 		}
 	}
+	cost = r;
 	d = n;
 	r = (int)((double)d / v[i] + 0.5);
 	/* first iteration always begins by Condition 3, then a swap */
 	d = n - r;
 	e = 2 * r - n;
-	memcpy(xB, xA, NumberLength * sizeof(limb));   // B <- A
-	memcpy(zB, zA, NumberLength * sizeof(limb));
-	memcpy(xC, xA, NumberLength * sizeof(limb));   // C <- A
-	memcpy(zC, zA, NumberLength * sizeof(limb));
-	duplicate(xA, zA, xA, zA); /* A=2*A */
 	while (d != e) {
+		unsigned char step = 0;
 		if (d < e) {
 			r = d;   d = e;  e = r;   // swap d & e
-			t = xA; xA = xB; xB = t;  // swap xA & Xb
-			t = zA; zA = zB; zB = t;  // swap zA & zB
+			step = PRAC_SWAP;
 		}
-		/* do the first line of Table 4 whose condition qualifies */
+		/* find the first line of Table 4 whose condition qualifies */
 		if (4 * d <= 5 * e && ((d + e) % 3) == 0) { /* condition 1 */
 			r = (2 * d - e) / 3;
 			e = (2 * e - d) / 3;
 			d = r;
+			step += 1;
+		}
+		else if (4 * d <= 5 * e && (d - e) % 6 == 0) { /* condition 2 */
+			d = (d - e) / 2;
+			step += 2;
+		}
+		else if (d <= (4 * e)) {                       /* condition 3 */
+			d -= e;
+			step += 3;
+		}
+		else if ((d + e) % 2 == 0) {               /* condition 4 */
+			d = (d - e) / 2;
+			step += 4;
+		}
+		else if (d % 2 == 0) {                    /* condition 5 */
+			d /= 2;
+			step += 5;
+		}
+		else if (d % 3 == 0) {                   /* condition 6 */
+			d = d / 3 - e;
+			step += 6;
+		}
+		else if ((d + e) % 3 == 0) {                  /* condition 7 */
+			d = (d - 2 * e) / 3;
+			step += 7;
+		}
+		else if ((d - e) % 3 == 0) {                 /* condition 8 */
+			d = (d - e) / 3;
+			step += 8;
+		}
+		else if (e % 2 == 0) { /* condition 9 */
+			e /= 2;
+			step += 9;
+		}
+		steps.push_back(step);
+	}
+	steps.push_back(0);
+	return cost;
+}
+
+/* get the chains for all odd primes <= B1, working them out the first time
+they are needed */
+static const pracChains &GetPracChains(long long B1)
+{
+	std::lock_guard<std::mutex> pracLock(pracMutex);
+	auto found = pracCache.find(B1);
+	if (found != pracCache.end()) {
+		return found->second;
+	}
+	pracChains &chains = pracCache[B1];
+	std::vector<bool> composite(B1 + 1);
+	for (long long p = 3; p <= B1; p += 2) {
+		if (composite[p]) {
+			continue;
+		}
+		for (long long m = p * p; m <= B1; m += 2 * p) {
+			composite[m] = true;
+		}
+		chains.primes.push_back((int)p);
+		chains.offsets.push_back((unsigned int)chains.steps.size());
+		chains.mults.push_back(PracChain((int)p, chains.steps));
+	}
+	return chains;
+}
+
+/* The mpn and SIMD versions of step 1 do not call modmult, so they add the
+multiplications done by their chains to lModularMult and call the status
+display themselves. */
+static void CountStage1Mults(long long mults) {
+	lModularMult += mults;
+	if (modmultCallback != nullptr) {
+		modmultCallback();
+	}
+}
+
+/* get the chain for the odd prime p */
+static const unsigned char *PracSteps(const pracChains &chains, int p)
+{
+	auto it = std::lower_bound(chains.primes.begin(), chains.primes.end(), p);
+	return &chains.steps[chains.offsets[it - chains.primes.begin()]];
+}
+
+/* computes nP from P=(x:z) and puts the result in (x:z), where steps is the
+chain for n from PracChain.
+uses global variables Aux1, Aux2, Aux3, Aux4 */
+static void prac(const unsigned char *steps, limb *x, limb *z, limb *xT, limb *zT, limb *xT2, limb *zT2)
+{
+	limb *t;
+	limb *xA = x, *zA = z;
+	limb *xB = Aux1, *zB = Aux2;
+	limb *xC = Aux3, *zC = Aux4;
+
+	memcpy(xB, xA, NumberLength * sizeof(limb));   // B <- A
+	memcpy(zB, zA, NumberLength * sizeof(limb));
+	memcpy(xC, xA, NumberLength * sizeof(limb));   // C <- A
+	memcpy(zC, zA, NumberLength * sizeof(limb));
+	duplicate(xA, zA, xA, zA); /* A=2*A */
+	for (; *steps != 0; steps++) {
+		if (*steps & PRAC_SWAP) {
+			t = xA; xA = xB; xB = t;  // swap xA & Xb
+			t = zA; zA = zB; zB = t;  // swap zA & zB
+		}
+		/* do the line of Table 4 chosen by PracChain */
+		switch (*steps & (PRAC_SWAP - 1)) {
+		case 1:
 			add3(xT, zT, xA, zA, xB, zB, xC, zC); /* T = f(A,B,C) */
 			add3(xT2, zT2, xT, zT, xA, zA, xB, zB); /* T2 = f(T,A,B) */
 			add3(xB, zB, xB, zB, xT, zT, xA, zA); /* B = f(B,T,A) */
 			t = xA; xA = xT2; xT2 = t; /* swap A and T2 */
 			t = zA; zA = zT2; zT2 = t; /* swap A and T2 */
-		}
+			break;
 
-		else if (4 * d <= 5 * e && (d - e) % 6 == 0) { /* condition 2 */
-			d = (d - e) / 2;
+		case 2:
 			add3(xB, zB, xA, zA, xB, zB, xC, zC); /* B = f(A,B,C) */
 			duplicate(xA, zA, xA, zA);       /* A = 2*A */
-		}
+			break;
 
-		else if (d <= (4 * e)) {                       /* condition 3 */
-			d -= e;
+		case 3:
 			add3(xT, zT, xB, zB, xA, zA, xC, zC); /* T = f(B,A,C) */
 			t = xB; xB = xT; xT = xC; xC = t;
 			t = zB; zB = zT; zT = zC; zC = t; /* circular permutation (B,T,C) */
-		} 
+			break;
 
-		else if ((d + e) % 2 == 0) {               /* condition 4 */
-			d = (d - e) / 2;
+		case 4:
 			add3(xB, zB, xB, zB, xA, zA, xC, zC); /* B = f(B,A,C) */
 			duplicate(xA, zA, xA, zA); /* A = 2*A */
-		}
+			break;
 
-		else if (d % 2 == 0) {                    /* condition 5 */
-			d /= 2;
+		case 5:
 			add3(xC, zC, xC, zC, xA, zA, xB, zB); /* C = f(C,A,B) */
 			duplicate(xA, zA, xA, zA); /* A = 2*A */
-		}
-		 
-		else if (d % 3 == 0) {                   /* condition 6 */
-			d = d / 3 - e;
+			break;
+
+		case 6:
 			duplicate(xT, zT, xA, zA); /* T1 = 2*A */
 			add3(xT2, zT2, xA, zA, xB, zB, xC, zC); /* T2 = f(A,B,C) */
 			add3(xA, zA, xT, zT, xA, zA, xA, zA); /* A = f(T1,A,A) */
 			add3(xT, zT, xT, zT, xT2, zT2, xC, zC); /* T1 = f(T1,T2,C) */
 			t = xC; xC = xB; xB = xT; xT = t;
 			t = zC; zC = zB; zB = zT; zT = t; /* circular permutation (C,B,T) */
-		}
+			break;
 
-		else if ((d + e) % 3 == 0) {                  /* condition 7 */
-			d = (d - 2 * e) / 3;
+		case 7:
 			add3(xT, zT, xA, zA, xB, zB, xC, zC); /* T1 = f(A,B,C) */
 			add3(xB, zB, xT, zT, xA, zA, xB, zB); /* B = f(T1,A,B) */
 			duplicate(xT, zT, xA, zA);
 			add3(xA, zA, xA, zA, xT, zT, xA, zA);     /* A = 3*A */
-		}
+			break;
 
-		else if ((d - e) % 3 == 0) {                 /* condition 8 */
-			d = (d - e) / 3;
+		case 8:
 			add3(xT, zT, xA, zA, xB, zB, xC, zC); /* T1 = f(A,B,C) */
 			add3(xC, zC, xC, zC, xA, zA, xB, zB); /* C = f(A,C,B) */
 			t = xB; xB = xT; xT = t;
 			t = zB; zB = zT; zT = t; /* swap B and T */
 			duplicate(xT, zT, xA, zA);
 			add3(xA, zA, xA, zA, xT, zT, xA, zA); /* A = 3*A */
-		}
+			break;
 
-		else if (e % 2 == 0) { /* condition 9 */
-			e /= 2;
+		case 9:
 			add3(xC, zC, xC, zC, xB, zB, xA, zA); /* C = f(C,B,A) */
 			duplicate(xB, zB, xB, zB);            /* B = 2*B */
+			break;
 		}
 	}
 
@@ -387,7 +511,7 @@ static void duplicate(limb *x2, limb *z2, const limb *x1, const limb *z1)
 The value of the gcd is returned in BiGD
 Uses global variables Temp1, BiGD, NumberLength */
 static int gcdIsOne(const limb *value, const Znum &zN, int line) {
-	static Znum Temp1;
+	static thread_local Znum Temp1;
 
 	LimbstoZ(value, Temp1, NumberLength);    // Temp1 = value
 
@@ -409,6 +533,225 @@ static int gcdIsOne(const limb *value, const Znum &zN, int line) {
 	return 2;      // GCD is greater than one.
 }
 
+/* Generate the curve for curveNo with the parametrisation A0 =
+2*(curveNo+1)/(3*(curveNo+1)^2 - 1). Sets AA, X and Z. Returns 1 if the
+curve is usable, or 0 to select another curve. */
+static int MontgomeryCurve(int curveNo, limb *X, limb *Z) {
+	static thread_local limb A0[MAX_LEN];     // A0 <- 2*(ElipCurvNo+1)/(3*(ElipCurvNo+1)^2 - 1) (mod TestNbr)
+	static thread_local limb A02[MAX_LEN];    // A02 <- A0^2
+	static thread_local limb A03[MAX_LEN];    // A03 <- A0^3
+
+	//  Compute A0 <- 2 * (curveNo+1)*modinv(3 * (curveNo+1) ^ 2 - 1, N) mod N
+	// Aux2 <- 1 in Montgomery notation.
+	memcpy(Aux2, MontgomeryMultR1, NumberLength * sizeof(limb));
+	modmultInt(Aux2, curveNo + 1, Aux2);           // Aux2 <- curveNo + 1 (mod TestNbr)
+	modmultInt(Aux2, 2, Aux1);                     // Aux1 <- 2*(curveNo+1) (mod TestNbr)
+	modmultInt(Aux2, curveNo + 1, Aux3);           // Aux3 <- (curveNo + 1)^2 (mod TestNbr)
+	modmultInt(Aux3, 3, Aux3);                     // Aux3 <- 3*(curveNo + 1)^2 (mod TestNbr)
+	                                             // Aux2 <- 3*(curveNo + 1)^2 - 1 (mod TestNbr)
+	SubtBigNbrModN(Aux3, MontgomeryMultR1, Aux2, TestNbr, NumberLength);
+	ModInvBigNbr(Aux2, Aux2, TestNbr, NumberLength);  // Aux2 = 1/Aux2
+	modmult(Aux1, Aux2, A0);       // A0 <- 2*(curveNo+1)/(3*(curveNo+1)^2 - 1) (mod TestNbr)
+#ifdef log
+	logf(A0);
+#endif
+
+	//  if A0*(A0 ^ 2 - 1)*(9 * A0 ^ 2 - 1) mod N=0 then select another curve.
+	modmult(A0, A0, A02);          // A02 <- A0^2
+	modmult(A02, A0, A03);         // A03 <- A0^3
+	SubtBigNbrModN(A03, A0, Aux1, TestNbr, NumberLength);  // Aux1 <- A0^3 - A0
+	modmultInt(A02, 9, Aux2);      // Aux2 <- 9*A0^2
+	SubtBigNbrModN(Aux2, MontgomeryMultR1, Aux2, TestNbr, NumberLength); // Aux2 <- 9*A0^2-1
+	modmult(Aux1, Aux2, Aux3);
+#ifdef log
+	logf(Aux3);
+#endif
+	if (BigNbrIsZero(Aux3, NumberLength)) {
+		return 0;  // select another curve
+	}
+	
+	modmultInt(A0, 4, Z);  //   Z <- 4 * A0 mod N
+
+	//   A = (-3 * A0 ^ 4 - 6 * A0 ^ 2 + 1)*modinv(4 * A0 ^ 3, N) mod N
+	modmultInt(A02, 6, Aux1);      // Aux1 <- 6*A0^2
+	SubtBigNbrModN(MontgomeryMultR1, Aux1, Aux1, TestNbr, NumberLength);
+	modmult(A02, A02, Aux2);       // Aux2 <- A0^4
+	modmultInt(Aux2, 3, Aux2);     // Aux2 <- 3*A0^4
+
+	SubtBigNbrModN(Aux1, Aux2, Aux1, TestNbr, NumberLength);
+	// Aux1 = -3 * A0 ^ 4 - 6 * A0 ^ 2
+
+	modmultInt(A03, 4, Aux2);                         // Aux2 <- 4*A0^3
+	ModInvBigNbr(Aux2, Aux3, TestNbr, NumberLength);  // Aux3 = 1/(4*A0^3) 
+	modmult(Aux1, Aux3, A0);
+
+	//   AA <- (A + 2)*modinv(4*A0, N) mod N
+	modmultInt(MontgomeryMultR1, 2, Aux2);  // Aux2 <- 2
+	AddBigNbrModNB(A0, Aux2, Aux1, TestNbr, NumberLength); // Aux1 <- A0+2
+	modmultInt(MontgomeryMultR1, 4, Aux2);  // Aux2 <- 4
+	ModInvBigNbr(Aux2, Aux2, TestNbr, NumberLength);
+	modmult(Aux1, Aux2, AA);             // AA = Aux1/Aux2 = 
+	//   X <- (3 * A0 ^ 2 + 1) mod N
+	modmultInt(A02, 3, Aux1);    // Aux1 <- 3*A0^2
+	AddBigNbrModNB(Aux1, MontgomeryMultR1, X, TestNbr, NumberLength);
+	return 1;
+}
+
+#if SIMD_STAGE1
+/* Curves whose step 1 was done by SimdStage1 together with an earlier curve.
+They use the curves from MontgomeryCurve. */
+static thread_local int batchCurve[ECM_SIMD_LANES];     // curve number, 0 = none
+static thread_local bool batchPending[ECM_SIMD_LANES];  // not yet taken by ecmCurve
+static thread_local int batchResult[ECM_SIMD_LANES];    // as returned by SimdStage1
+static thread_local long long batchB1;
+static thread_local limb batchX[ECM_SIMD_LANES][MAX_LEN];
+static thread_local limb batchZ[ECM_SIMD_LANES][MAX_LEN];
+static thread_local limb batchAA[ECM_SIMD_LANES][MAX_LEN];
+
+/* forget the curves of the last batch */
+static void ClearBatch(void) {
+	memset(batchCurve, 0, sizeof(batchCurve));
+	memset(batchPending, 0, sizeof(batchPending));
+}
+
+/* return the next curve of the batch, or 0 if there are none left */
+static int NextBatchCurve(void) {
+	for (int lane = 0; lane < ECM_SIMD_LANES; lane++) {
+		if (batchPending[lane]) {
+			batchPending[lane] = false;
+			return batchCurve[lane];
+		}
+	}
+	return 0;
+}
+
+/* Do step 1 for curveNo and the next ECM_SIMD_LANES-1 curves at the same
+time, or get the result for curveNo if it was part of an earlier batch.
+Returns 1 if (X:Z) and AA hold the result of step 1 for curveNo, 2 if a
+factor was found (in BiGD), 3 if all the factors of N were found at the same
+time, so that Pass 1 must start again from the point of the curve, or 0 if
+step 1 must be done as usual. */
+static int SimdStage1(const Znum &zN, int curveNo, long long B1, limb *X, limb *Z) {
+	int lane, rc;
+	long long mults = 0;
+
+	for (lane = 0; lane < ECM_SIMD_LANES; lane++) {
+		if (batchCurve[lane] == curveNo) {
+			batchCurve[lane] = 0;
+			if (batchB1 != B1) {
+				return 0;
+			}
+			if (batchResult[lane] != 1) {
+				return batchResult[lane];
+			}
+			memcpy(X, batchX[lane], NumberLength * sizeof(limb));
+			memcpy(Z, batchZ[lane], NumberLength * sizeof(limb));
+			memcpy(AA, batchAA[lane], NumberLength * sizeof(limb));
+			return 1;
+		}
+	}
+	if (ecmSimdLanes() == 0) {
+		return 0;      // no AVX2, or N too small or too large
+	}
+
+	/* lane 0 is curveNo. It is generated last so that AA, X and Z are left
+	with its curve. */
+	batchB1 = B1;
+	batchCurve[0] = curveNo;
+	for (lane = 1; lane < ECM_SIMD_LANES; lane++) {
+		batchCurve[lane] = ++ElipCurvNo;
+		batchPending[lane] = true;
+	}
+	for (lane = ECM_SIMD_LANES - 1; lane >= 0; lane--) {
+		batchResult[lane] = MontgomeryCurve(batchCurve[lane], X, Z);  // 0 if the curve cannot be used
+		ecmSimdLoad(lane, X, Z, AA);
+		memcpy(batchAA[lane], AA, NumberLength * sizeof(limb));
+	}
+
+	/* multiply by the powers of 2, then by the powers of the odd primes */
+	const pracChains &chains = GetPracChains(B1);
+	for (long long I = 1; I <= B1; I <<= 1) {
+		ecmSimdDuplicate();
+		mults += DUP;
+	}
+	for (size_t i = 0; i < chains.primes.size(); i++) {
+		long long P = chains.primes[i];
+		for (long long IP = P; IP <= B1; IP *= P) {
+			ecmSimdPrac(&chains.steps[chains.offsets[i]]);
+			mults += chains.mults[i];
+		}
+		if ((i & 0xff) == 0) {
+			indexPrimes = (int)i;
+			CountStage1Mults(mults);
+			mults = 0;
+			if (ecmStop) {
+				ClearBatch();
+				return 0;    // another thread found a factor
+			}
+		}
+	}
+	indexPrimes = nbrPrimes;
+	CountStage1Mults(mults);
+
+	for (lane = 0; lane < ECM_SIMD_LANES; lane++) {
+		ecmSimdStore(lane, batchX[lane], batchZ[lane]);
+		if (batchResult[lane] == 0) {
+			continue;
+		}
+		rc = gcdIsOne(batchZ[lane], zN, __LINE__);
+		if (rc > 1) {
+			ClearBatch();
+			return 2;            // the factor found by any of the curves
+		}
+		batchResult[lane] = (rc == 0 ? 3 : 1);   // 3 if all the factors were found at once
+	}
+	return SimdStage1(zN, curveNo, B1, X, Z);   // get the result for lane 0
+}
+#endif
+
+/* Do step 1 for the Montgomery form of the curve with the mpn functions of
+GMP, using the same PRAC chains as prac. Returns 1 if (X:Z) holds the result,
+2 if a factor was found (in BiGD), 3 if all the factors were found at the
+same time or 0 if another thread found a factor. (X:Z) is only changed if
+the result is 1, so that Pass 1 can start from the point of the curve. */
+static int MpnStage1(const Znum &zN, long long B1, limb *X, limb *Z) {
+	static thread_local limb XS[MAX_LEN], ZS[MAX_LEN];
+	const pracChains &chains = GetPracChains(B1);
+	long long mults = 0;
+	int rc;
+
+	ecmMpnInit(zN);
+	ecmMpnLoad(X, Z, AA);
+	for (long long I = 1; I <= B1; I <<= 1) {
+		ecmMpnDuplicate();
+		mults += DUP;
+	}
+	for (size_t i = 0; i < chains.primes.size(); i++) {
+		long long P = chains.primes[i];
+		for (long long IP = P; IP <= B1; IP *= P) {
+			ecmMpnPrac(&chains.steps[chains.offsets[i]]);
+			mults += chains.mults[i];
+		}
+		if ((i & 0xff) == 0) {
+			indexPrimes = (int)i;
+			CountStage1Mults(mults);
+			mults = 0;
+			if (ecmStop) {
+				return 0;    // another thread found a factor
+			}
+		}
+	}
+	indexPrimes = nbrPrimes;
+	CountStage1Mults(mults);
+	ecmMpnStore(XS, ZS);
+	rc = gcdIsOne(ZS, zN, __LINE__);
+	if (rc == 1) {
+		memcpy(X, XS, NumberLength * sizeof(limb));
+		memcpy(Z, ZS, NumberLength * sizeof(limb));
+	}
+	return (rc == 0 ? 3 : rc);
+}
+
 static void GenerateSieve(int initial) {
 	int i, j, Q, initModQ;
 	for (i = 0; i < 10 * SIEVE_SIZE; i += SIEVE_SIZE)
@@ -515,14 +858,20 @@ static void GenerateSieve(int initial) {
 //}
 
 #ifdef __EMSCRIPTEN__
+static thread_local long long nextStatusMult;   // lModularMult for the next check
+
 void showECMStatus(void) {
 	char status[200];
 	int elapsedTime;
 	char *ptrStatus;
-	if ((lModularMult % yieldFreq) != 0)
+	if (ecmThreadNumber != 0) {
+		return;      // only report progress of the curve on the main thread
+	}
+	if (lModularMult < nextStatusMult)
 	{
 		return;
 	}
+	nextStatusMult = lModularMult + yieldFreq;
 	elapsedTime = (int)(tenths() - originalTenthSecond);
 	if (elapsedTime / 10 <= oldTimeElapsed/10 +5)
 	{
@@ -668,25 +1017,24 @@ static void upOneLine(void) {
 }
 
 /* can return value:
-FACTOR_NOT_FOUND   (not used??)
+FACTOR_NOT_FOUND   another thread found a factor (ecmStop set)
 CHANGE_TO_SIQS
-FACTOR_FOUND   - value of factor is returned in global variable BiGD
+FACTOR_FOUND   - value of factor is returned in Zfactor
 ERROR              (not used??)  
-uses work variables UX, UZ, TX, TZ */
+uses work variables UX, UZ, TX, TZ. Each thread takes the next curve
+number from ElipCurvNo, so threads never run the same curve. */
 static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
-	static limb A0[MAX_LEN];     // A0 <- 2*(ElipCurvNo+1)/(3*(ElipCurvNo+1)^2 - 1) (mod TestNbr)
-	static limb A02[MAX_LEN];    // A02 <- A0^2
-	static limb A03[MAX_LEN];    // A03 <- A0^3
-
-	static limb W1[MAX_LEN];
-	static limb W2[MAX_LEN];
-	static limb WX[MAX_LEN];
-	static limb WZ[MAX_LEN];
-	static limb X[MAX_LEN];
-	static limb Z[MAX_LEN];
-	static limb Xaux[MAX_LEN];       // copy of X
-	static limb Zaux[MAX_LEN];       // copy of Z
-	static limb root[GROUP_SIZE][MAX_LEN];
+	static thread_local limb W1[MAX_LEN];
+	static thread_local limb W2[MAX_LEN];
+	static thread_local limb X[MAX_LEN];
+	static thread_local limb Z[MAX_LEN];
+	static thread_local limb Xaux[MAX_LEN];       // copy of X
+	static thread_local limb Zaux[MAX_LEN];       // copy of Z
+#if !STAGE2_FFT
+	static thread_local limb WX[MAX_LEN];
+	static thread_local limb WZ[MAX_LEN];
+	static thread_local limb root[GROUP_SIZE][MAX_LEN];
+#endif
 
 #ifdef __EMSCRIPTEN__
 	//char text[20];
@@ -697,15 +1045,25 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 		char *ptrText;
 #endif
 		int I, Pass;
-		int i, j, u;
+		int i, u;
 		long long L1, L2, LS, P, IP, Paux = 1;
+		int curveNo, stage1;
 
-		ElipCurvNo++;   // increment curve number
+		if (ecmStop) {
+			return FACTOR_NOT_FOUND;   // another thread found a factor
+		}
+		curveNo = 0;
+#if SIMD_STAGE1
+		curveNo = NextBatchCurve();  // curves already taken by SimdStage1 come first
+#endif
+		if (curveNo == 0) {
+			curveNo = ++ElipCurvNo;   // take the next curve number
+		}
 
 #ifdef __EMSCRIPTEN__
 		//			text[0] = '7';
 		//ptrText = &text[1];
-		//			int2dec(&ptrText, ElipCurvNo);
+		//			int2dec(&ptrText, curveNo);
 		//			printf ("%s\n", text);
 #endif
 		L2 = mpz_sizeinbase(ZT(zN),10);        // Get number of digits.
@@ -714,7 +1072,7 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 		if (L1 > 30 && L1 <= 90 && L2 >= 30 && L2 <= 90)    // If between 30 and 90 digits...
 		{                             // Switch to SIQS.
 			int limit = limits[((int)L1 - 31) / 5];  // e.g if L1<=55, limit=10
-			if (ElipCurvNo  >= limit) {                          
+			if (curveNo  >= limit) {                          
 #ifdef log
 					fprintf_s(logfile, "Change to SIQS\n");
 #endif       
@@ -724,7 +1082,7 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 
 		/* Try to factor N using Lehman algorithm. Result in Zfactor. 
 		This seldom achieves anything, but when it does it saves a lot of time */
-		int kx = ElipCurvNo;
+		int kx = curveNo;
 		const int mult = 5;  /* could change value of mult to use Lehman 
 							 more, or less, relative to ECM. Benchmark testing
 							 needed to estimate best value */
@@ -745,45 +1103,49 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 			}
 		}
 
-		/* set L1, L2, LS, Paux and nbrPrimes according to value of ElipCurvNo */
+		/* set L1, L2, LS, Paux and nbrPrimes according to value of curveNo */
 		L1 = 2000;
 		L2 = 200000;
 		LS = 45;
-		Paux = ElipCurvNo;
+		Paux = curveNo;
 		nbrPrimes = 303; /* Number of primes less than 2000 */
-		if (ElipCurvNo > 25) {
-			if (ElipCurvNo < 326) {   // 26 to 325
+		if (curveNo > 25) {
+			if (curveNo < 326) {   // 26 to 325
 				L1 = 50000;
 				L2 = 5000000;
 				LS = 224;
-				Paux = ElipCurvNo - 24;
+				Paux = curveNo - 24;
 				nbrPrimes = 5133; /* Number of primes less than 50000 */
 			}
 			else {
-				if (ElipCurvNo < 2000) {  // 326 to 1999
+				if (curveNo < 2000) {  // 326 to 1999
 					L1 = 1000000;
 					L2 = 100000000;
 					LS = 1001;
-					Paux = ElipCurvNo - 299;
+					Paux = curveNo - 299;
 					nbrPrimes = 78498; /* Number of primes less than 1000000 */
 				}
 				else {   // >= 2000
 					L1 = 11000000;
 					L2 = 1100000000;
 					LS = 3316;
-					Paux = ElipCurvNo - 1900;
+					Paux = curveNo - 1900;
 					nbrPrimes = 726517; /* Number of primes less than 11000000 */
 				}
 			}
 		}
+#if STAGE2_FFT
+		L2 = L1 * FFT_B2_MULT;   // the FFT continuation reaches much higher B2
+#endif
 #ifdef __EMSCRIPTEN__
 		/* print status message */
+		std::unique_lock<std::mutex> screenLock(ecmMutex);
 		ptrText = ptrLowerText;  // Point after number that is being factored.
 		auto elapsedTime = (int)(tenths() - originalTenthSecond);
 		GetDHMSt(&ptrText, elapsedTime);
 		strcpy(ptrText, lang ? " ECM Curva " : " ECM Curve ");
 		ptrText += strlen(ptrText);
-		int2dec(&ptrText, ElipCurvNo);   // Show curve number.
+		int2dec(&ptrText, curveNo);   // Show curve number.
 		strcpy(ptrText, lang ? " usando límites B1=" : " using bounds B1=");
 		ptrText += strlen(ptrText);
 		int2dec(&ptrText, L1);   // Show first bound.
@@ -813,6 +1175,7 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 		fprintf_s(logfile, "%s", ptrLowerText);
 		fflush(logfile);
 #endif
+		screenLock.unlock();
 #if 0
 		primalityString =
 			textAreaContents
@@ -848,63 +1211,14 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 			}
 		} /* end for */
 		lowerTextArea.setText(
-			primalityString + ElipCurvNo + "\n" + UpperLine + "\n" + LowerLine);
-#endif
+			primalityString + curveNo + "\n" + UpperLine + "\n" + LowerLine);
 #endif
-
-		//  Compute A0 <- 2 * (ElipCurvNo+1)*modinv(3 * (ElipCurvNo+1) ^ 2 - 1, N) mod N
-		// Aux2 <- 1 in Montgomery notation.
-		memcpy(Aux2, MontgomeryMultR1, NumberLength * sizeof(limb));
-		modmultInt(Aux2, ElipCurvNo + 1, Aux2);        // Aux2 <- ElipCurvNo + 1 (mod TestNbr)
-		modmultInt(Aux2, 2, Aux1);                     // Aux1 <- 2*(ElipCurvNo+1) (mod TestNbr)
-		modmultInt(Aux2, ElipCurvNo + 1, Aux3);        // Aux3 <- (ElipCurvNo + 1)^2 (mod TestNbr)
-		modmultInt(Aux3, 3, Aux3);                     // Aux3 <- 3*(ElipCurvNo + 1)^2 (mod TestNbr)
-		                                             // Aux2 <- 3*(ElipCurvNo + 1)^2 - 1 (mod TestNbr)
-		SubtBigNbrModN(Aux3, MontgomeryMultR1, Aux2, TestNbr, NumberLength);
-		ModInvBigNbr(Aux2, Aux2, TestNbr, NumberLength);  // Aux2 = 1/Aux2
-		modmult(Aux1, Aux2, A0);       // A0 <- 2*(ElipCurvNo+1)/(3*(ElipCurvNo+1)^2 - 1) (mod TestNbr)
-#ifdef log
-		logf(A0);
 #endif
 
-		//  if A0*(A0 ^ 2 - 1)*(9 * A0 ^ 2 - 1) mod N=0 then select another curve.
-		modmult(A0, A0, A02);          // A02 <- A0^2
-		modmult(A02, A0, A03);         // A03 <- A0^3
-		SubtBigNbrModN(A03, A0, Aux1, TestNbr, NumberLength);  // Aux1 <- A0^3 - A0
-		modmultInt(A02, 9, Aux2);      // Aux2 <- 9*A0^2
-		SubtBigNbrModN(Aux2, MontgomeryMultR1, Aux2, TestNbr, NumberLength); // Aux2 <- 9*A0^2-1
-		modmult(Aux1, Aux2, Aux3);
-#ifdef log
-		logf(Aux3);
-#endif
-		if (BigNbrIsZero(Aux3, NumberLength)) {
+		if (MontgomeryCurve(curveNo, X, Z) == 0) {
 			continue;  // select another curve
 		}
-		
-		modmultInt(A0, 4, Z);  //   Z <- 4 * A0 mod N
-
-		//   A = (-3 * A0 ^ 4 - 6 * A0 ^ 2 + 1)*modinv(4 * A0 ^ 3, N) mod N
-		modmultInt(A02, 6, Aux1);      // Aux1 <- 6*A0^2
-		SubtBigNbrModN(MontgomeryMultR1, Aux1, Aux1, TestNbr, NumberLength);
-		modmult(A02, A02, Aux2);       // Aux2 <- A0^4
-		modmultInt(Aux2, 3, Aux2);     // Aux2 <- 3*A0^4
-
-		SubtBigNbrModN(Aux1, Aux2, Aux1, TestNbr, NumberLength);
-		// Aux1 = -3 * A0 ^ 4 - 6 * A0 ^ 2
-
-		modmultInt(A03, 4, Aux2);                         // Aux2 <- 4*A0^3
-		ModInvBigNbr(Aux2, Aux3, TestNbr, NumberLength);  // Aux3 = 1/(4*A0^3) 
-		modmult(Aux1, Aux3, A0);
-
-		//   AA <- (A + 2)*modinv(4*A0, N) mod N
-		modmultInt(MontgomeryMultR1, 2, Aux2);  // Aux2 <- 2
-		AddBigNbrModNB(A0, Aux2, Aux1, TestNbr, NumberLength); // Aux1 <- A0+2
-		modmultInt(MontgomeryMultR1, 4, Aux2);  // Aux2 <- 4
-		ModInvBigNbr(Aux2, Aux2, TestNbr, NumberLength);
-		modmult(Aux1, Aux2, AA);             // AA = Aux1/Aux2 = 
-		//   X <- (3 * A0 ^ 2 + 1) mod N
-		modmultInt(A02, 3, Aux1);    // Aux1 <- 3*A0^2
-		AddBigNbrModNB(Aux1, MontgomeryMultR1, X, TestNbr, NumberLength);
+
 		/**************/
 		/* First step */
 		/**************/
@@ -916,7 +1230,44 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 #endif
 		// GcdAccumulated = 1
 		memcpy(GcdAccumulated, MontgomeryMultR1, (NumberLength + 1) * sizeof(limb));
-		for (Pass = 0; Pass < 2; Pass++) {
+		Pass = 0;
+		/* Small numbers do step 1 for several curves at once with SIMD
+		instructions, and other numbers do it with GMP arithmetic unless
+		ecmMpn is off. Otherwise the loop below does it with Pass = 0. If all
+		the factors are found at the same time, Pass 1 starts again from
+		(Xaux:Zaux) and checks the gcd after every prime. */
+		StepECM = 1;
+		indexPrimes = 0;
+		stage1 = 0;
+#if SIMD_STAGE1
+		stage1 = SimdStage1(zN, curveNo, L1, X, Z);
+		if (stage1 == 0 && ecmStop) {
+			return FACTOR_NOT_FOUND;   // another thread found a factor
+		}
+#endif
+		if (stage1 == 0 && ecmMpn) {
+			stage1 = MpnStage1(zN, L1, X, Z);
+		}
+		switch (stage1) {
+		case 1:
+			Pass = 2;            // go to step 2
+			break;
+		case 2:
+			Zfactor = BiGD;
+			return FACTOR_FOUND;
+		case 3:              // all the factors were found at once
+			memcpy(X, Xaux, NumberLength * sizeof(limb));
+			memcpy(Z, Zaux, NumberLength * sizeof(limb));
+			Pass = 1;
+			break;
+		default:
+			if (ecmStop) {
+				return FACTOR_NOT_FOUND;   // another thread found a factor
+			}
+		}
+		for (; Pass < 2; Pass++) {
+			const pracChains &chains = GetPracChains(L1);   // shared by all curves
+			const unsigned char *pracSteps;
 #ifdef log
 			fprintf(logfile, "starting pass %d \n", Pass);
 #endif
@@ -955,10 +1306,14 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 			do {
 				indexPrimes++;
 				P = SmallPrime[indexM];
+				pracSteps = PracSteps(chains, (int)P);
 				for (IP = P; IP <= L1; IP *= P) {
-					prac((int)P, X, Z, W1, W2, W3, W4);
+					prac(pracSteps, X, Z, W1, W2, W3, W4);
 				}
 				indexM++;
+				if (ecmStop) {
+					return FACTOR_NOT_FOUND;   // another thread found a factor
+				}
 				if (Pass == 0) {
 					// GcdAccumulated *= Z
 					modmult(GcdAccumulated, Z, Aux1);
@@ -1009,7 +1364,10 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 						break;
 					}
 					indexPrimes++;
-					prac((int)(P + 2 * i), X, Z, W1, W2, W3, W4);
+					prac(PracSteps(chains, (int)(P + 2 * i)), X, Z, W1, W2, W3, W4);
+					if (ecmStop) {
+						return FACTOR_NOT_FOUND;   // another thread found a factor
+					}
 					if (Pass == 0) {
 						// GcdAccumulated *= Z;
 						modmult(GcdAccumulated, Z, Aux1);
@@ -1050,11 +1408,40 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 			}
 		} /* end for Pass */
 
+#if STAGE2_FFT
+		/********************************************/
+		/* Second step (using the FFT continuation) */
+		/********************************************/
+		{
+			Znum zX, zZ, zA24, zR1;
+			StepECM = 2;
+			indexM = 0;
+			maxIndexM = 100;       // indexM shows progress in percent
+			/* X/Z is the same in Montgomery notation, but AA must be converted */
+			LimbstoZ(X, zX, NumberLength);
+			LimbstoZ(Z, zZ, NumberLength);
+			LimbstoZ(AA, zA24, NumberLength);
+			LimbstoZ(MontgomeryMultR1, zR1, NumberLength);
+			mpz_invert(ZT(zR1), ZT(zR1), ZT(zN));
+			zA24 = zA24 * zR1 % zN;
+			BiGD = ecmStage2Fft(zN, zX, zZ, zA24, L1, L2, &ecmStop, &indexM);
+			if (BiGD != 1 && BiGD != zN) {
+				Zfactor = BiGD;
+				return FACTOR_FOUND;
+			}
+			/* BiGD = zN only if a single point or difference is a multiple of
+			N. The standard continuation would get the same difference, so
+			the next curve is tried. */
+			if (ecmStop) {
+				return FACTOR_NOT_FOUND;   // another thread found a factor
+			}
+		}
+#else
 		  /******************************************************/
 		  /* Second step (using improved standard continuation) */
 		  /******************************************************/
 		StepECM = 2;
-		j = 0;
+		int j = 0;
 		for (u = 1; u < SIEVE_SIZE; u += 2) {
 			if (u % 3 == 0 || u % 5 == 0 || u % 7 == 0
 #if MAX_PRIME_SIEVE == 11
@@ -1193,6 +1580,9 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 			Qaux = (int)(L1 / (2 * SIEVE_SIZE));
 			maxIndexM = (int)(L2 / (2 * SIEVE_SIZE));
 			for (indexM = 0; indexM <= maxIndexM; indexM++) {
+				if (ecmStop) {
+					return FACTOR_NOT_FOUND;   // another thread found a factor
+				}
 				if (indexM >= Qaux) { // If inside step 2 range... 
 					if (indexM == 0) {
 						ModInvBigNbr(UZ, Aux3, TestNbr, NumberLength);
@@ -1276,7 +1666,7 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 				if (rc == 1) {
 #ifdef log
 					logf(GcdAccumulated);
-					fprintf(logfile, "exit from curve %d  \n", ElipCurvNo);
+					fprintf(logfile, "exit from curve %d  \n", curveNo);
 #endif
 					break;    // GCD is one, so this curve does not find a factor.
 				}
@@ -1293,6 +1683,7 @@ static enum eEcmResult ecmCurve(const Znum &zN, Znum &Zfactor) {
 				}
 			} // end if (Pass == 0)
 		} /* end for Pass */
+#endif
 
 	}       /* End curve calculation */
 }
@@ -1313,6 +1704,8 @@ static void ecminit(Znum zN) {
 #ifdef _DEBUG
 	GetMontgomeryParms(zN);
 #endif
+	TestNbr[NumberLength].x = 0;   // so curve threads only read TestNbr
+	MontgomeryMultR1[NumberLength].x = 0;   // and MontgomeryMultR1
 	first = true;
 
 	/* set variables to zero */
@@ -1371,6 +1764,25 @@ static void ecminit(Znum zN) {
 	}
 }
 
+/* run curves until this thread or another one finds a factor, or it is time
+to switch to SIQS. The first factor found is saved in ecmFactor. */
+static void ecmThread(const Znum &zN, int threadNumber) {
+	Znum factor;
+
+	ecmThreadNumber = threadNumber;
+#if SIMD_STAGE1
+	ClearBatch();      // curves left over from the last number
+#endif
+	if (ecmCurve(zN, factor) == FACTOR_FOUND) {
+		std::lock_guard<std::mutex> guard(ecmMutex);
+		if (!ecmStop) {
+			ecmStop = true;        // cancel the curves on the other threads
+			ecmFactor = factor;
+			ecmResult = FACTOR_FOUND;
+		}
+	}
+}
+
 /* returns true if successful. The factor found is returned in global Znum Zfactor */
 bool ecm(Znum &zN, long long maxdivisor) {
 
@@ -1385,22 +1797,35 @@ bool ecm(Znum &zN, long long maxdivisor) {
 #endif
 
 	ecminit(zN);  // initialise values
+	ZfactorList.clear();
 
 	foundByLehman = false;
+	int nbrThreads = (int)std::thread::hardware_concurrency();
+	if (nbrThreads < 1) {
+		nbrThreads = 1;
+	}
 	do {
-		enum eEcmResult ecmResp = ecmCurve(zN, Zfactor);
-		if (ecmResp == CHANGE_TO_SIQS) {    // Perform SIQS
-			FactoringSIQSx(zN, Zfactor); // factor found is returned in Zfactor
-			break;
+		/* each thread runs curves until a factor is found; if no thread finds
+		one before the curve limit, all of them return CHANGE_TO_SIQS */
+		ecmStop = false;
+		ecmResult = CHANGE_TO_SIQS;
+		{
+			std::vector<std::thread> threadArray;
+			for (int threadNumber = 1; threadNumber < nbrThreads; threadNumber++) {
+				threadArray.emplace_back(ecmThread, std::cref(zN), threadNumber);
+			}
+			ecmThread(zN, 0);    // main thread runs curves too
+			for (auto &t : threadArray) {
+				t.join();
+			}
 		}
-		else if (ecmResp == FACTOR_FOUND) {
+		if (ecmResult == CHANGE_TO_SIQS) {    // Perform SIQS
+			FactoringSIQSx(zN, Zfactor, &ZfactorList); // factors found are returned in Zfactor and ZfactorList
 			break;
 		}
-		// statements below cannot be executed as ecmResp always = CHANGE_TO_SIQS or FACTOR_FOUND 
-		else if (ecmResp == ERROR)
-			return false;
+		Zfactor = ecmFactor;
 	//} while (!memcmp(BNgcd, TestNbr, NumberLength * sizeof(limb))); // while BNgcd = TestNbr
-	} while (zN == BiGD);
+	} while (zN == Zfactor);
 
 #if 0
 	lowerTextArea.setText("");
@@ -0,0 +1,256 @@
+/*
+This file is part of Alpertron Calculators.
+Copyright 2015 Dario Alejandro Alpern
+Alpertron Calculators is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+Alpertron Calculators is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with Alpertron Calculators.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ECM step 1 using the mpn functions of GMP/MPIR on full-size limbs (64 bits
+on x64) instead of the 31-bit limbs of modmult. A number takes about half as
+many limbs, and mpn_mul_n and mpn_addmul_1 use the assembler routines of the
+library. Montgomery multiplication is mpn_mul_n (or mpn_sqr) followed by a
+REDC that works one limb at a time, as mpn_redc_1 does inside GMP. The
+Montgomery constant is R = 2^(GMP_LIMB_BITS*n), so numbers are converted from
+and to the Montgomery notation of modmult when they are loaded and stored.
+All the work areas are allocated once per thread. */
+
+#include <cstring>
+#include "bignbr.h"
+#include "factor.h"
+
+/* limbs needed for a number of MAX_LEN 31-bit limbs */
+#define MPN_MAX_LIMBS ((MAX_LEN * BITS_PER_GROUP + GMP_LIMB_BITS - 1) / GMP_LIMB_BITS)
+
+typedef mp_limb_t mpnNbr[MPN_MAX_LIMBS];
+
+static thread_local mpnNbr mpnN;
+static thread_local mpnNbr mpnX, mpnZ, mpnAA;
+static thread_local mpnNbr xBm, zBm, xCm, zCm, xTm, zTm, xT2m, zT2m;
+static thread_local mpnNbr UXm, UZm, TXm, TZm;
+static thread_local mpnNbr mpnToMpn;    // R^2/R1 (mod N): from modmult notation to R
+static thread_local mpnNbr mpnToLimb;   // R1 (mod N): from R to modmult notation
+static thread_local mp_limb_t mpnProd[2 * MPN_MAX_LIMBS];
+static thread_local mp_limb_t mpnMontN;  // -1/N mod 2^GMP_LIMB_BITS
+static thread_local mp_size_t mpnLength;
+
+/* copy value (0 <= value < N) to r */
+static void ZtoMpn(const Znum &value, mp_limb_t *r) {
+	for (mp_size_t i = 0; i < mpnLength; i++) {
+		r[i] = mpz_getlimbn(ZT(value), i);
+	}
+}
+
+/* r = mpnProd/R (mod N). mpnProd holds 2*mpnLength limbs, less than N*R */
+static void MpnRedc(mp_limb_t *r) {
+	mp_limb_t *t = mpnProd;
+	for (mp_size_t i = 0; i < mpnLength; i++) {
+		/* after this t[i] is zero, so the carry into t[i+mpnLength] is kept
+		there until the end */
+		t[i] = mpn_addmul_1(t + i, mpnN, mpnLength, t[i] * mpnMontN);
+	}
+	mp_limb_t carry = mpn_add_n(r, t + mpnLength, t, mpnLength);
+	if (carry != 0 || mpn_cmp(r, mpnN, mpnLength) >= 0) {
+		mpn_sub_n(r, r, mpnN, mpnLength);
+	}
+}
+
+/* r = a*b/R (mod N). r may be the same as a or b */
+static void MpnModMult(const mp_limb_t *a, const mp_limb_t *b, mp_limb_t *r) {
+	if (a == b) {
+		mpn_sqr(mpnProd, a, mpnLength);
+	}
+	else {
+		mpn_mul_n(mpnProd, a, b, mpnLength);
+	}
+	MpnRedc(r);
+}
+
+/* r = a + b (mod N) */
+static void MpnAddMod(const mp_limb_t *a, const mp_limb_t *b, mp_limb_t *r) {
+	mp_limb_t carry = mpn_add_n(r, a, b, mpnLength);
+	if (carry != 0 || mpn_cmp(r, mpnN, mpnLength) >= 0) {
+		mpn_sub_n(r, r, mpnN, mpnLength);
+	}
+}
+
+/* r = a - b (mod N) */
+static void MpnSubtMod(const mp_limb_t *a, const mp_limb_t *b, mp_limb_t *r) {
+	if (mpn_sub_n(r, a, b, mpnLength) != 0) {
+		mpn_add_n(r, r, mpnN, mpnLength);
+	}
+}
+
+/* same as add3 in ecm.cpp: (x3:z3) = Q + R where Q-R = P = (x:z) */
+static void MpnAdd3(mp_limb_t *x3, mp_limb_t *z3, const mp_limb_t *x2, const mp_limb_t *z2,
+	const mp_limb_t *x1, const mp_limb_t *z1, const mp_limb_t *x, const mp_limb_t *z) {
+	MpnSubtMod(x2, z2, UXm);          // UX = x2-z2
+	MpnAddMod(x1, z1, UZm);           // UZ = x1+z1
+	MpnModMult(UXm, UZm, TZm);        // TZ = (x2-z2)*(x1+z1)
+	MpnAddMod(x2, z2, UZm);           // UZ = x2+z2
+	MpnSubtMod(x1, z1, TXm);          // TX = x1-z1
+	MpnModMult(TXm, UZm, UXm);        // UX = (x2+z2)*(x1-z1)
+	MpnAddMod(TZm, UXm, TXm);         // TX = 2*(x1*x2-z1*z2)
+	MpnModMult(TXm, TXm, UZm);        // UZ = 4*(x1*x2-z1*z2)^2
+	MpnSubtMod(TZm, UXm, TXm);        // TX = 2*(x2*z1-x1*z2)
+	MpnModMult(TXm, TXm, UXm);        // UX = 4*(x2*z1-x1*z2)^2
+	MpnModMult(UZm, z, TZm);          // TZ = 4*z*(x1*x2-z1*z2)^2
+	MpnModMult(x, UXm, z3);           // z3 = 4*x*(x2*z1-x1*z2)^2
+	memcpy(x3, TZm, mpnLength * sizeof(mp_limb_t)); // x3 may be the same as x
+}
+
+/* same as duplicate in ecm.cpp: (x2:z2) = 2*(x1:z1) */
+static void MpnDuplicate(mp_limb_t *x2, mp_limb_t *z2, const mp_limb_t *x1, const mp_limb_t *z1) {
+	MpnAddMod(x1, z1, TZm);           // TZ = x1+z1
+	MpnModMult(TZm, TZm, UZm);        // UZ = (x1+z1)^2
+	MpnSubtMod(x1, z1, TZm);          // TZ = x1-z1
+	MpnModMult(TZm, TZm, TXm);        // TX = (x1-z1)^2
+	MpnModMult(UZm, TXm, x2);         // x2 = (x1^2-z1^2)^2
+	MpnSubtMod(UZm, TXm, TZm);        // TZ = 4*x1*z1
+	MpnModMult(mpnAA, TZm, UZm);      // UZ = AA*TZ
+	MpnAddMod(UZm, TXm, UZm);         // UZ = TX + AA*TZ
+	MpnModMult(TZm, UZm, z2);         // z2 = TZ*UZ
+}
+
+/* convert the number in modmult notation to this engine's notation */
+static void LimbsToMpn(const limb *number, mp_limb_t *r) {
+	Znum value;
+	LimbstoZ(number, value, NumberLength);
+	ZtoMpn(value, r);
+	MpnModMult(r, mpnToMpn, r);
+}
+
+/* convert the number in this engine's notation to modmult notation */
+static void MpnToLimbs(const mp_limb_t *number, limb *r) {
+	Znum value;
+	MpnModMult(number, mpnToLimb, UXm);
+	mpz_import(ZT(value), mpnLength, -1, sizeof(mp_limb_t), 0, 0, UXm);
+	ZtoLimbs(r, value, NumberLength);
+}
+
+/* set up N = zN for the other functions of this file. TestNbr and
+MontgomeryMultR1 must already be set for zN. */
+void ecmMpnInit(const Znum &zN) {
+	Znum zR, zR1, zInv;
+	mpnLength = (mp_size_t)mpz_size(ZT(zN));
+	ZtoMpn(zN, mpnN);
+
+	/* Newton iteration for 1/N mod 2^GMP_LIMB_BITS: N*N = 1 mod 8 for N odd,
+	and each step doubles the number of correct bits */
+	mp_limb_t inv = mpnN[0];
+	for (int bits = 3; bits < GMP_LIMB_BITS; bits *= 2) {
+		inv *= 2 - mpnN[0] * inv;
+	}
+	mpnMontN = (mp_limb_t)0 - inv;
+
+	zR = 1;
+	zR <<= (int)(mpnLength * GMP_LIMB_BITS);
+	zR %= zN;
+	LimbstoZ(MontgomeryMultR1, zR1, NumberLength);
+	mpz_invert(ZT(zInv), ZT(zR1), ZT(zN));
+	ZtoMpn(zR * zR % zN * zInv % zN, mpnToMpn);
+	ZtoMpn(zR1, mpnToLimb);
+}
+
+/* set the point (X:Z) and (A+2)/4 of the curve, all in Montgomery notation
+of modmult */
+void ecmMpnLoad(const limb *X, const limb *Z, const limb *AA) {
+	LimbsToMpn(X, mpnX);
+	LimbsToMpn(Z, mpnZ);
+	LimbsToMpn(AA, mpnAA);
+}
+
+/* get the point (X:Z) in Montgomery notation of modmult */
+void ecmMpnStore(limb *X, limb *Z) {
+	MpnToLimbs(mpnX, X);
+	MpnToLimbs(mpnZ, Z);
+}
+
+/* multiply the point by n, where steps is the chain for n built by
+PracChain in ecm.cpp. This is prac in ecm.cpp. */
+void ecmMpnPrac(const unsigned char *steps) {
+	mp_limb_t *t;
+	mp_limb_t *xA = mpnX, *zA = mpnZ;
+	mp_limb_t *xB = xBm, *zB = zBm;
+	mp_limb_t *xC = xCm, *zC = zCm;
+	mp_limb_t *xT = xTm, *zT = zTm;
+	mp_limb_t *xT2 = xT2m, *zT2 = zT2m;
+	const size_t size = mpnLength * sizeof(mp_limb_t);
+
+	memcpy(xB, xA, size);   // B <- A
+	memcpy(zB, zA, size);
+	memcpy(xC, xA, size);   // C <- A
+	memcpy(zC, zA, size);
+	MpnDuplicate(xA, zA, xA, zA);     // A = 2*A
+	for (; *steps != 0; steps++) {
+		if (*steps & PRAC_SWAP) {
+			t = xA; xA = xB; xB = t;
+			t = zA; zA = zB; zB = t;
+		}
+		switch (*steps & (PRAC_SWAP - 1)) {
+		case 1:
+			MpnAdd3(xT, zT, xA, zA, xB, zB, xC, zC);   // T = f(A,B,C)
+			MpnAdd3(xT2, zT2, xT, zT, xA, zA, xB, zB); // T2 = f(T,A,B)
+			MpnAdd3(xB, zB, xB, zB, xT, zT, xA, zA);   // B = f(B,T,A)
+			t = xA; xA = xT2; xT2 = t;                 // swap A and T2
+			t = zA; zA = zT2; zT2 = t;
+			break;
+		case 2:
+			MpnAdd3(xB, zB, xA, zA, xB, zB, xC, zC);   // B = f(A,B,C)
+			MpnDuplicate(xA, zA, xA, zA);              // A = 2*A
+			break;
+		case 3:
+			MpnAdd3(xT, zT, xB, zB, xA, zA, xC, zC);   // T = f(B,A,C)
+			t = xB; xB = xT; xT = xC; xC = t;          // circular permutation (B,T,C)
+			t = zB; zB = zT; zT = zC; zC = t;
+			break;
+		case 4:
+			MpnAdd3(xB, zB, xB, zB, xA, zA, xC, zC);   // B = f(B,A,C)
+			MpnDuplicate(xA, zA, xA, zA);              // A = 2*A
+			break;
+		case 5:
+			MpnAdd3(xC, zC, xC, zC, xA, zA, xB, zB);   // C = f(C,A,B)
+			MpnDuplicate(xA, zA, xA, zA);              // A = 2*A
+			break;
+		case 6:
+			MpnDuplicate(xT, zT, xA, zA);              // T1 = 2*A
+			MpnAdd3(xT2, zT2, xA, zA, xB, zB, xC, zC); // T2 = f(A,B,C)
+			MpnAdd3(xA, zA, xT, zT, xA, zA, xA, zA);   // A = f(T1,A,A)
+			MpnAdd3(xT, zT, xT, zT, xT2, zT2, xC, zC); // T1 = f(T1,T2,C)
+			t = xC; xC = xB; xB = xT; xT = t;          // circular permutation (C,B,T)
+			t = zC; zC = zB; zB = zT; zT = t;
+			break;
+		case 7:
+			MpnAdd3(xT, zT, xA, zA, xB, zB, xC, zC);   // T1 = f(A,B,C)
+			MpnAdd3(xB, zB, xT, zT, xA, zA, xB, zB);   // B = f(T1,A,B)
+			MpnDuplicate(xT, zT, xA, zA);
+			MpnAdd3(xA, zA, xA, zA, xT, zT, xA, zA);   // A = 3*A
+			break;
+		case 8:
+			MpnAdd3(xT, zT, xA, zA, xB, zB, xC, zC);   // T1 = f(A,B,C)
+			MpnAdd3(xC, zC, xC, zC, xA, zA, xB, zB);   // C = f(A,C,B)
+			t = xB; xB = xT; xT = t;                   // swap B and T
+			t = zB; zB = zT; zT = t;
+			MpnDuplicate(xT, zT, xA, zA);
+			MpnAdd3(xA, zA, xA, zA, xT, zT, xA, zA);   // A = 3*A
+			break;
+		case 9:
+			MpnAdd3(xC, zC, xC, zC, xB, zB, xA, zA);   // C = f(C,B,A)
+			MpnDuplicate(xB, zB, xB, zB);              // B = 2*B
+			break;
+		}
+	}
+	MpnAdd3(mpnX, mpnZ, xA, zA, xB, zB, xC, zC);
+}
+
+/* multiply the point by 2 */
+void ecmMpnDuplicate(void) {
+	MpnDuplicate(mpnX, mpnZ, mpnX, mpnZ);
+}
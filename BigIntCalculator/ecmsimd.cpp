@@ -0,0 +1,320 @@
+/*
+This file is part of Alpertron Calculators.
+Copyright 2015 Dario Alejandro Alpern
+Alpertron Calculators is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+Alpertron Calculators is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with Alpertron Calculators.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ECM step 1 on ECM_SIMD_LANES curves at once using AVX2.
+All the curves work modulo the same N, so the limbs of N are broadcast to
+every lane, while limb j of the number for curve c is held in 64-bit lane c
+of vector j. The 31-bit limbs fit the 32x32->64 bit multiplication of
+_mm256_mul_epu32, and the sums of two products and a limb do not overflow
+64 bits, so Montgomery multiplication is the same as in modmult but works
+on 4 curves with each instruction. The curves follow the same PRAC chains,
+which depend only on the prime, so they stay in lockstep. */
+
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include "bignbr.h"
+#include "factor.h"
+#if defined(_M_X64) || defined(__x86_64__)
+#define ECM_X86_SIMD
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+#define SIMD_MAX_LIMBS 12     // N from 2 to 12 limbs
+
+#ifdef ECM_X86_SIMD
+#if defined(__GNUC__) && !defined(__AVX2__)
+#define ECM_AVX2 __attribute__((target("avx2")))
+#else
+#define ECM_AVX2
+#endif
+
+/* a number for each curve: limb j of lane c is at [4*j + c] */
+typedef uint64_t simdNbr[SIMD_MAX_LIMBS * ECM_SIMD_LANES];
+
+static thread_local simdNbr simdX, simdZ, simdAA;
+static thread_local simdNbr simdN;             // N in every lane
+static thread_local simdNbr xBs, zBs, xCs, zCs, xTs, zTs, xT2s, zT2s;
+static thread_local simdNbr UXs, UZs, TXs, TZs, Prods;
+static thread_local uint64_t simdMontN;        // -1/N mod 2^31
+static thread_local int simdLength;
+
+#define LOADV(p, j) _mm256_loadu_si256((const __m256i *)((p) + 4 * (j)))
+#define STOREV(p, j, v) _mm256_storeu_si256((__m256i *)((p) + 4 * (j)), (v))
+
+/* if the number in Prods is >= N, subtract N; store the result in r */
+ECM_AVX2 static void SimdReduce(uint64_t *r) {
+	const __m256i mask = _mm256_set1_epi64x(MAX_VALUE_LIMB);
+	const __m256i one = _mm256_set1_epi64x(1);
+	__m256i borrow = _mm256_setzero_si256();
+	__m256i diff[SIMD_MAX_LIMBS];
+	for (int j = 0; j < simdLength; j++) {
+		__m256i t = _mm256_sub_epi64(_mm256_sub_epi64(LOADV(Prods, j), LOADV(simdN, j)), borrow);
+		diff[j] = _mm256_and_si256(t, mask);
+		borrow = _mm256_srli_epi64(t, 63);
+	}
+	/* a borrow out of the top limb means that the number was less than N */
+	__m256i keep = _mm256_cmpeq_epi64(borrow, one);
+	for (int j = 0; j < simdLength; j++) {
+		STOREV(r, j, _mm256_blendv_epi8(diff[j], LOADV(Prods, j), keep));
+	}
+}
+
+/* r = a*b/R (mod N) in each lane. r may be the same as a or b */
+ECM_AVX2 static void SimdModMult(const uint64_t *a, const uint64_t *b, uint64_t *r) {
+	const __m256i mask = _mm256_set1_epi64x(MAX_VALUE_LIMB);
+	const __m256i montN = _mm256_set1_epi64x(simdMontN);
+	__m256i prod[SIMD_MAX_LIMBS];
+	int i, j;
+
+	for (j = 0; j < simdLength; j++) {
+		prod[j] = _mm256_setzero_si256();
+	}
+	for (i = 0; i < simdLength; i++) {
+		__m256i ai = LOADV(a, i);
+		__m256i pr = _mm256_add_epi64(_mm256_mul_epu32(ai, LOADV(b, 0)), prod[0]);
+		__m256i m = _mm256_and_si256(_mm256_mul_epu32(pr, montN), mask);
+		pr = _mm256_srli_epi64(_mm256_add_epi64(pr, _mm256_mul_epu32(m, LOADV(simdN, 0))),
+			BITS_PER_GROUP);
+		for (j = 1; j < simdLength; j++) {
+			pr = _mm256_add_epi64(pr, _mm256_mul_epu32(ai, LOADV(b, j)));
+			pr = _mm256_add_epi64(pr, _mm256_mul_epu32(m, LOADV(simdN, j)));
+			pr = _mm256_add_epi64(pr, prod[j]);
+			prod[j - 1] = _mm256_and_si256(pr, mask);
+			pr = _mm256_srli_epi64(pr, BITS_PER_GROUP);
+		}
+		prod[simdLength - 1] = pr;
+	}
+	for (j = 0; j < simdLength; j++) {
+		STOREV(Prods, j, prod[j]);
+	}
+	SimdReduce(r);
+}
+
+/* r = a + b (mod N) in each lane */
+ECM_AVX2 static void SimdAddMod(const uint64_t *a, const uint64_t *b, uint64_t *r) {
+	const __m256i mask = _mm256_set1_epi64x(MAX_VALUE_LIMB);
+	__m256i carry = _mm256_setzero_si256();
+	for (int j = 0; j < simdLength; j++) {
+		__m256i t = _mm256_add_epi64(_mm256_add_epi64(LOADV(a, j), LOADV(b, j)), carry);
+		STOREV(Prods, j, (j < simdLength - 1) ? _mm256_and_si256(t, mask) : t);
+		carry = _mm256_srli_epi64(t, BITS_PER_GROUP);
+	}
+	SimdReduce(r);
+}
+
+/* r = a - b (mod N) in each lane */
+ECM_AVX2 static void SimdSubtMod(const uint64_t *a, const uint64_t *b, uint64_t *r) {
+	const __m256i mask = _mm256_set1_epi64x(MAX_VALUE_LIMB);
+	__m256i borrow = _mm256_setzero_si256();
+	__m256i diff[SIMD_MAX_LIMBS];
+	int j;
+	for (j = 0; j < simdLength; j++) {
+		__m256i t = _mm256_sub_epi64(_mm256_sub_epi64(LOADV(a, j), LOADV(b, j)), borrow);
+		diff[j] = _mm256_and_si256(t, mask);
+		borrow = _mm256_srli_epi64(t, 63);
+	}
+	/* add N back in the lanes where a < b */
+	__m256i addN = _mm256_sub_epi64(_mm256_setzero_si256(), borrow);  // all ones or zero
+	__m256i carry = _mm256_setzero_si256();
+	for (j = 0; j < simdLength; j++) {
+		__m256i t = _mm256_add_epi64(_mm256_add_epi64(diff[j],
+			_mm256_and_si256(LOADV(simdN, j), addN)), carry);
+		STOREV(r, j, _mm256_and_si256(t, mask));
+		carry = _mm256_srli_epi64(t, BITS_PER_GROUP);
+	}
+}
+
+/* same as add3 in ecm.cpp: (x3:z3) = Q + R where Q-R = P = (x:z) */
+ECM_AVX2 static void SimdAdd3(uint64_t *x3, uint64_t *z3, const uint64_t *x2, const uint64_t *z2,
+	const uint64_t *x1, const uint64_t *z1, const uint64_t *x, const uint64_t *z) {
+	SimdSubtMod(x2, z2, UXs);         // UX = x2-z2
+	SimdAddMod(x1, z1, UZs);          // UZ = x1+z1
+	SimdModMult(UXs, UZs, TZs);       // TZ = (x2-z2)*(x1+z1)
+	SimdAddMod(x2, z2, UZs);          // UZ = x2+z2
+	SimdSubtMod(x1, z1, TXs);         // TX = x1-z1
+	SimdModMult(TXs, UZs, UXs);       // UX = (x2+z2)*(x1-z1)
+	SimdAddMod(TZs, UXs, TXs);        // TX = 2*(x1*x2-z1*z2)
+	SimdModMult(TXs, TXs, UZs);       // UZ = 4*(x1*x2-z1*z2)^2
+	SimdSubtMod(TZs, UXs, TXs);       // TX = 2*(x2*z1-x1*z2)
+	SimdModMult(TXs, TXs, UXs);       // UX = 4*(x2*z1-x1*z2)^2
+	SimdModMult(UZs, z, TZs);         // TZ = 4*z*(x1*x2-z1*z2)^2
+	SimdModMult(x, UXs, z3);          // z3 = 4*x*(x2*z1-x1*z2)^2
+	memcpy(x3, TZs, sizeof(simdNbr)); // x3 may be the same as x
+}
+
+/* same as duplicate in ecm.cpp: (x2:z2) = 2*(x1:z1) */
+ECM_AVX2 static void SimdDuplicate(uint64_t *x2, uint64_t *z2, const uint64_t *x1, const uint64_t *z1) {
+	SimdAddMod(x1, z1, TZs);          // TZ = x1+z1
+	SimdModMult(TZs, TZs, UZs);       // UZ = (x1+z1)^2
+	SimdSubtMod(x1, z1, TZs);         // TZ = x1-z1
+	SimdModMult(TZs, TZs, TXs);       // TX = (x1-z1)^2
+	SimdModMult(UZs, TXs, x2);        // x2 = (x1^2-z1^2)^2
+	SimdSubtMod(UZs, TXs, TZs);       // TZ = 4*x1*z1
+	SimdModMult(simdAA, TZs, UZs);    // UZ = AA*TZ
+	SimdAddMod(UZs, TXs, UZs);        // UZ = TX + AA*TZ
+	SimdModMult(TZs, UZs, z2);        // z2 = TZ*UZ
+}
+
+/* return true if this CPU (and the OS) supports AVX2 */
+static bool Avx2Support(void) {
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 0);
+	int maxLeaf = cpuInfo[0];
+	__cpuid(cpuInfo, 1);
+	bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+	if (osxsave && maxLeaf >= 7 && (_xgetbv(0) & 6) == 6) {
+		/* OS saves the YMM registers */
+		__cpuidex(cpuInfo, 7, 0);
+		return (cpuInfo[1] & (1 << 5)) != 0;
+	}
+	return false;
+}
+#endif
+
+/* return the number of curves that ecmSimdPrac works on at the same time,
+or 0 if it cannot be used for this N. Also sets up N for ecmSimdPrac. */
+int ecmSimdLanes(void) {
+#ifdef ECM_X86_SIMD
+	static const bool avx2 = Avx2Support();
+	if (!avx2 || NumberLength < 2 || NumberLength > SIMD_MAX_LIMBS) {
+		return 0;
+	}
+	simdLength = NumberLength;
+	simdMontN = (uint64_t)(unsigned int)MontgomeryMultN[0].x;
+	for (int j = 0; j < simdLength; j++) {
+		for (int c = 0; c < ECM_SIMD_LANES; c++) {
+			simdN[4 * j + c] = (uint64_t)(unsigned int)TestNbr[j].x;
+		}
+	}
+	return ECM_SIMD_LANES;
+#else
+	return 0;
+#endif
+}
+
+/* set the point (X:Z) and (A+2)/4 of the curve in lane, all in Montgomery
+notation */
+void ecmSimdLoad(int lane, const limb *X, const limb *Z, const limb *AA) {
+#ifdef ECM_X86_SIMD
+	for (int j = 0; j < simdLength; j++) {
+		simdX[4 * j + lane] = (uint64_t)(unsigned int)X[j].x;
+		simdZ[4 * j + lane] = (uint64_t)(unsigned int)Z[j].x;
+		simdAA[4 * j + lane] = (uint64_t)(unsigned int)AA[j].x;
+	}
+#endif
+}
+
+/* get the point (X:Z) of the curve in lane */
+void ecmSimdStore(int lane, limb *X, limb *Z) {
+#ifdef ECM_X86_SIMD
+	for (int j = 0; j < simdLength; j++) {
+		X[j].x = (int)simdX[4 * j + lane];
+		Z[j].x = (int)simdZ[4 * j + lane];
+	}
+#endif
+}
+
+/* multiply the point of every curve by n, where steps is the chain for n
+built by PracChain in ecm.cpp. This is prac in ecm.cpp on all lanes. */
+#ifdef ECM_X86_SIMD
+ECM_AVX2
+#endif
+void ecmSimdPrac(const unsigned char *steps) {
+#ifdef ECM_X86_SIMD
+	uint64_t *t;
+	uint64_t *xA = simdX, *zA = simdZ;
+	uint64_t *xB = xBs, *zB = zBs;
+	uint64_t *xC = xCs, *zC = zCs;
+	uint64_t *xT = xTs, *zT = zTs;
+	uint64_t *xT2 = xT2s, *zT2 = zT2s;
+
+	memcpy(xB, xA, sizeof(simdNbr));   // B <- A
+	memcpy(zB, zA, sizeof(simdNbr));
+	memcpy(xC, xA, sizeof(simdNbr));   // C <- A
+	memcpy(zC, zA, sizeof(simdNbr));
+	SimdDuplicate(xA, zA, xA, zA);     // A = 2*A
+	for (; *steps != 0; steps++) {
+		if (*steps & PRAC_SWAP) {
+			t = xA; xA = xB; xB = t;
+			t = zA; zA = zB; zB = t;
+		}
+		switch (*steps & (PRAC_SWAP - 1)) {
+		case 1:
+			SimdAdd3(xT, zT, xA, zA, xB, zB, xC, zC);   // T = f(A,B,C)
+			SimdAdd3(xT2, zT2, xT, zT, xA, zA, xB, zB); // T2 = f(T,A,B)
+			SimdAdd3(xB, zB, xB, zB, xT, zT, xA, zA);   // B = f(B,T,A)
+			t = xA; xA = xT2; xT2 = t;                  // swap A and T2
+			t = zA; zA = zT2; zT2 = t;
+			break;
+		case 2:
+			SimdAdd3(xB, zB, xA, zA, xB, zB, xC, zC);   // B = f(A,B,C)
+			SimdDuplicate(xA, zA, xA, zA);              // A = 2*A
+			break;
+		case 3:
+			SimdAdd3(xT, zT, xB, zB, xA, zA, xC, zC);   // T = f(B,A,C)
+			t = xB; xB = xT; xT = xC; xC = t;           // circular permutation (B,T,C)
+			t = zB; zB = zT; zT = zC; zC = t;
+			break;
+		case 4:
+			SimdAdd3(xB, zB, xB, zB, xA, zA, xC, zC);   // B = f(B,A,C)
+			SimdDuplicate(xA, zA, xA, zA);              // A = 2*A
+			break;
+		case 5:
+			SimdAdd3(xC, zC, xC, zC, xA, zA, xB, zB);   // C = f(C,A,B)
+			SimdDuplicate(xA, zA, xA, zA);              // A = 2*A
+			break;
+		case 6:
+			SimdDuplicate(xT, zT, xA, zA);              // T1 = 2*A
+			SimdAdd3(xT2, zT2, xA, zA, xB, zB, xC, zC); // T2 = f(A,B,C)
+			SimdAdd3(xA, zA, xT, zT, xA, zA, xA, zA);   // A = f(T1,A,A)
+			SimdAdd3(xT, zT, xT, zT, xT2, zT2, xC, zC); // T1 = f(T1,T2,C)
+			t = xC; xC = xB; xB = xT; xT = t;           // circular permutation (C,B,T)
+			t = zC; zC = zB; zB = zT; zT = t;
+			break;
+		case 7:
+			SimdAdd3(xT, zT, xA, zA, xB, zB, xC, zC);   // T1 = f(A,B,C)
+			SimdAdd3(xB, zB, xT, zT, xA, zA, xB, zB);   // B = f(T1,A,B)
+			SimdDuplicate(xT, zT, xA, zA);
+			SimdAdd3(xA, zA, xA, zA, xT, zT, xA, zA);   // A = 3*A
+			break;
+		case 8:
+			SimdAdd3(xT, zT, xA, zA, xB, zB, xC, zC);   // T1 = f(A,B,C)
+			SimdAdd3(xC, zC, xC, zC, xA, zA, xB, zB);   // C = f(A,C,B)
+			t = xB; xB = xT; xT = t;                    // swap B and T
+			t = zB; zB = zT; zT = t;
+			SimdDuplicate(xT, zT, xA, zA);
+			SimdAdd3(xA, zA, xA, zA, xT, zT, xA, zA);   // A = 3*A
+			break;
+		case 9:
+			SimdAdd3(xC, zC, xC, zC, xB, zB, xA, zA);   // C = f(C,B,A)
+			SimdDuplicate(xB, zB, xB, zB);              // B = 2*B
+			break;
+		}
+	}
+	SimdAdd3(simdX, simdZ, xA, zA, xB, zB, xC, zC);
+#endif
+}
+
+/* multiply the point of every curve by 2 */
+#ifdef ECM_X86_SIMD
+ECM_AVX2
+#endif
+void ecmSimdDuplicate(void) {
+#ifdef ECM_X86_SIMD
+	SimdDuplicate(simdX, simdZ, simdX, simdZ);
+#endif
+}
@@ -0,0 +1,464 @@
+/*
+This file is part of Alpertron Calculators.
+Copyright 2015 Dario Alejandro Alpern
+Alpertron Calculators is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+Alpertron Calculators is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with Alpertron Calculators.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* ECM stage 2 using the FFT continuation.
+If Q is the point found by stage 1 and its order mod a prime factor p of N is
+a prime in (B1, B2], then i*d*Q = +/- j*Q (mod p) for some i and some j < d/2
+prime to d, so x(i*d*Q) - x(j*Q) is a multiple of p. Instead of multiplying
+these differences one at a time, the baby step values x(j*Q) go into a product
+tree once. For each block of giant steps G(X) = product of (X - x(i*d*Q)) is
+evaluated at all the baby step values with a scaled remainder tree; the
+product of these values is the product of all the differences.
+Polynomials are multiplied by Kronecker substitution: the coefficients are
+packed into one big integer so that the multiplication is done by GMP, which
+uses FFT multiplication for large operands. Each block of k giant steps then
+costs O(M(k) log k) instead of k*k modular multiplications. */
+
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+#include "bignbr.h"
+#include "factor.h"
+
+#define POLY_SCHOOLBOOK    12   // use schoolbook multiplication up to this size
+#define STAGE2_MAX_BYTES   (16 << 20)   // limit for the coefficients of F
+
+typedef std::vector<Znum> poly;   // coefficients mod N, lowest degree first
+
+/* pack the coefficients of a into one integer, words 64-bit words each */
+static void PolyPack(const poly &a, size_t words, Znum &packed) {
+	std::vector<uint64_t> buffer(a.size() * words, 0);
+	for (size_t i = 0; i < a.size(); i++) {
+		mpz_export(&buffer[i * words], NULL, -1, sizeof(uint64_t), 0, 0, ZT(a[i]));
+	}
+	mpz_import(ZT(packed), buffer.size(), -1, sizeof(uint64_t), 0, 0, buffer.data());
+}
+
+/* c = a*b mod N. c may be the same as a or b */
+static void PolyMul(const poly &a, const poly &b, poly &c, const Znum &N) {
+	size_t na = a.size(), nb = b.size();
+	poly result;
+
+	if (na == 0 || nb == 0) {
+		c.clear();
+		return;
+	}
+	result.resize(na + nb - 1);
+	if (std::min(na, nb) <= POLY_SCHOOLBOOK) {
+		for (size_t i = 0; i < na; i++) {
+			for (size_t j = 0; j < nb; j++) {
+				mpz_addmul(ZT(result[i + j]), ZT(a[i]), ZT(b[j]));
+			}
+		}
+		for (auto &coeff : result) {
+			mpz_tdiv_r(ZT(coeff), ZT(coeff), ZT(N));
+		}
+	}
+	else {
+		/* each coefficient of the product is less than min(na,nb)*N^2 */
+		size_t bits = 2 * mpz_sizeinbase(ZT(N), 2) + 1;
+		for (size_t n = std::min(na, nb); n > 0; n >>= 1) {
+			bits++;
+		}
+		size_t words = (bits + 63) / 64;
+		Znum packedA, packedB, product;
+		PolyPack(a, words, packedA);
+		if (&a == &b) {
+			mpz_mul(ZT(product), ZT(packedA), ZT(packedA));
+		}
+		else {
+			PolyPack(b, words, packedB);
+			mpz_mul(ZT(product), ZT(packedA), ZT(packedB));
+		}
+		std::vector<uint64_t> buffer(result.size() * words, 0);
+		mpz_export(buffer.data(), NULL, -1, sizeof(uint64_t), 0, 0, ZT(product));
+		for (size_t i = 0; i < result.size(); i++) {
+			mpz_import(ZT(result[i]), words, -1, sizeof(uint64_t), 0, 0, &buffer[i * words]);
+			mpz_tdiv_r(ZT(result[i]), ZT(result[i]), ZT(N));
+		}
+	}
+	c.swap(result);
+}
+
+/* inv = 1/f mod X^k using Newton iteration. f[0] must be 1 */
+static void PolyInverse(const poly &f, size_t k, poly &inv, const Znum &N) {
+	size_t prec = 1;
+	poly t;
+
+	inv.assign(1, 1);
+	while (prec < k) {
+		prec = std::min(2 * prec, k);
+		t.assign(f.begin(), f.begin() + std::min(prec, f.size()));
+		PolyMul(t, inv, t, N);           // t = f*inv = 1 + O(X^(prec/2))
+		t.resize(prec);
+		for (auto &coeff : t) {          // t = 2 - f*inv
+			if (coeff != 0) {
+				coeff = N - coeff;
+			}
+		}
+		t[0] += 2;
+		if (t[0] >= N) {
+			t[0] -= N;
+		}
+		PolyMul(inv, t, inv, N);
+		inv.resize(prec);
+	}
+}
+
+/* tree[0] holds the polynomials X - points[i], each level above holds
+the products of pairs of the level below; an odd polynomial moves up unchanged.
+The last level holds the product of all of them. */
+static void ProductTree(const std::vector<Znum> &points, std::vector<std::vector<poly>> &tree,
+	const Znum &N) {
+	tree.assign(1, std::vector<poly>(points.size()));
+	for (size_t i = 0; i < points.size(); i++) {
+		tree[0][i].resize(2);
+		tree[0][i][0] = (points[i] == 0 ? Znum(0) : N - points[i]);
+		tree[0][i][1] = 1;
+	}
+	while (tree.back().size() > 1) {
+		std::vector<poly> &below = tree.back();
+		std::vector<poly> level((below.size() + 1) / 2);
+		for (size_t i = 0; i + 1 < below.size(); i += 2) {
+			PolyMul(below[i], below[i + 1], level[i / 2], N);
+		}
+		if (below.size() & 1) {
+			level.back() = below.back();
+		}
+		tree.push_back(std::move(level));
+	}
+}
+
+/* f = product of (X - points[i]), built like the product tree but without
+keeping the lower levels */
+static void PolyFromRoots(const std::vector<Znum> &points, poly &f, const Znum &N) {
+	std::vector<poly> level(points.size());
+	for (size_t i = 0; i < points.size(); i++) {
+		level[i].resize(2);
+		level[i][0] = (points[i] == 0 ? Znum(0) : N - points[i]);
+		level[i][1] = 1;
+	}
+	while (level.size() > 1) {
+		for (size_t i = 0; i + 1 < level.size(); i += 2) {
+			PolyMul(level[i], level[i + 1], level[i / 2], N);
+		}
+		if (level.size() & 1) {
+			level[level.size() / 2].swap(level.back());
+		}
+		level.resize((level.size() + 1) / 2);
+	}
+	f.swap(level[0]);
+}
+
+/* c = the first n coefficients of (f mod P)/P as a power series in 1/X,
+where P is the root of the tree and n is its degree. inv = 1/revP mod X^m
+for some m > deg(f), where revP is P with its coefficients reversed. */
+static void ScaledRemainderRoot(const std::vector<std::vector<poly>> &tree, const poly &f,
+	const poly &inv, poly &c, const Znum &N) {
+	const poly &P = tree.back()[0];
+	size_t n = P.size() - 1, degF = f.size() - 1;
+	poly revF(f.rbegin(), f.rend());
+	poly s;
+
+	/* f/P = X^(degF-n) * revF(1/X) / revP(1/X) */
+	PolyMul(revF, poly(inv.begin(), inv.begin() + degF + 1), s, N);
+	c.assign(n, 0);
+	for (size_t i = 1; i <= n; i++) {
+		if (i + degF >= n && i + degF - n < s.size()) {
+			c[i - 1] = s[i + degF - n];
+		}
+	}
+}
+
+/* Bernstein's scaled remainder tree: c holds the first n coefficients of
+(f mod P)/P, where P is the polynomial of degree n at node idx of level.
+If P = P1*P2, the coefficients for P1 are those of c*P2, so each node costs one
+multiplication and no division. At a leaf X - g the first coefficient is f(g). */
+static void ScaledRemainderTree(const std::vector<std::vector<poly>> &tree, size_t level,
+	size_t idx, const poly &c, std::vector<Znum> &values, const Znum &N) {
+	if (level == 0) {
+		values[idx] = c[0];
+		return;
+	}
+	const std::vector<poly> &below = tree[level - 1];
+	if (2 * idx + 1 >= below.size()) {     // polynomial was moved up unchanged
+		ScaledRemainderTree(tree, level - 1, 2 * idx, c, values, N);
+		return;
+	}
+	for (size_t side = 0; side < 2; side++) {
+		const poly &child = below[2 * idx + side];
+		const poly &sibling = below[2 * idx + 1 - side];
+		size_t degChild = child.size() - 1, degSibling = sibling.size() - 1;
+		poly revSibling(sibling.rbegin(), sibling.rend());
+		poly product;
+
+		/* coefficient i of c*P2 is sum of c[i+j]*P2[j], a middle product */
+		PolyMul(c, revSibling, product, N);
+		poly childC(product.begin() + degSibling, product.begin() + degSibling + degChild);
+		ScaledRemainderTree(tree, level - 1, 2 * idx + side, childC, values, N);
+	}
+}
+
+/* Montgomery curve arithmetic using X and Z only. a24 = (A+2)/4 */
+struct XZPoint {
+	Znum X, Z;
+};
+
+static void XDouble(XZPoint &r, const XZPoint &p, const Znum &a24, const Znum &N) {
+	Znum t1, t2, t3;
+	t1 = p.X + p.Z;
+	t1 = t1 * t1 % N;              // (X+Z)^2
+	t2 = p.X - p.Z;
+	t2 = t2 * t2 % N;              // (X-Z)^2
+	t3 = t1 - t2;                  // 4XZ
+	r.X = t1 * t2 % N;
+	r.Z = (t2 + a24 * t3) % N;
+	r.Z = r.Z * t3 % N;
+	if (r.Z < 0) {
+		r.Z += N;
+	}
+}
+
+/* r = p + q, where diff = p - q */
+static void XAdd(XZPoint &r, const XZPoint &p, const XZPoint &q, const XZPoint &diff,
+	const Znum &N) {
+	Znum u, v, s;
+	u = (p.X - p.Z) * (q.X + q.Z) % N;
+	v = (p.X + p.Z) * (q.X - q.Z) % N;
+	s = u + v;
+	u -= v;
+	s = s * s % N;
+	u = u * u % N;
+	s = s * diff.Z % N;
+	u = u * diff.X % N;
+	r.X = (s < 0 ? s + N : s);
+	r.Z = (u < 0 ? u + N : u);
+}
+
+/* r = n*p using the Montgomery ladder, n >= 1 */
+static void XMultiply(XZPoint &r, const XZPoint &p, unsigned long long n, const Znum &a24,
+	const Znum &N) {
+	XZPoint r0 = p, r1;
+	int bit = 63;
+
+	XDouble(r1, p, a24, N);
+	while (((n >> bit) & 1) == 0) {
+		bit--;
+	}
+	for (bit--; bit >= 0; bit--) {
+		if ((n >> bit) & 1) {
+			XAdd(r0, r1, r0, p, N);
+			XDouble(r1, r1, a24, N);
+		}
+		else {
+			XAdd(r1, r1, r0, p, N);
+			XDouble(r0, r0, a24, N);
+		}
+	}
+	r = r0;
+}
+
+/* replace each point by its affine x = X/Z using one inversion for all
+of them. If some Z is not invertible, return gcd(Z, N) in factor. If the
+product of the Z's catches all the factors of N, the Z's are looked at one by
+one, so that factor is N only if a single Z catches all of them. */
+static bool Normalise(const std::vector<XZPoint> &points, std::vector<Znum> &x, Znum &factor,
+	const Znum &N) {
+	std::vector<Znum> prefix(points.size());
+	Znum inv, acc = 1;
+
+	for (size_t i = 0; i < points.size(); i++) {
+		prefix[i] = acc;
+		acc = acc * points[i].Z % N;
+	}
+	if (mpz_invert(ZT(inv), ZT(acc), ZT(N)) == 0) {
+		factor = gcd(acc, N);
+		for (size_t i = 0; factor == N && i < points.size(); i++) {
+			Znum g = gcd(points[i].Z, N);
+			if (g != 1 && g != N) {
+				factor = g;
+			}
+		}
+		return false;
+	}
+	x.resize(points.size());
+	for (size_t i = points.size(); i-- > 0;) {
+		x[i] = prefix[i] * inv % N;
+		x[i] = x[i] * points[i].X % N;
+		inv = inv * points[i].Z % N;
+	}
+	return true;
+}
+
+static int GcdInt(int a, int b) {
+	while (b != 0) {
+		int t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+static int Totient(int n) {
+	int result = n;
+	for (int p = 2; p * p <= n; p++) {
+		if (n % p == 0) {
+			while (n % p == 0) {
+				n /= p;
+			}
+			result -= result / p;
+		}
+	}
+	if (n > 1) {
+		result -= result / n;
+	}
+	return result;
+}
+
+/* Find a proper factor of N when the product of the differences of all the
+blocks so far is a multiple of N. blockProducts holds the product of each
+block; the last one is the block in giantX, whose values G(x) at the baby
+steps x are in values. Goes down from the blocks to the values of the last
+block and then to the single differences of a value. Returns N only if a
+single difference is a multiple of N. */
+static Znum Stage2Backtrack(const std::vector<Znum> &blockProducts, const std::vector<Znum> &babyX,
+	const std::vector<Znum> &giantX, const std::vector<Znum> &values, const Znum &N) {
+	Znum factor;
+
+	for (auto &product : blockProducts) {
+		factor = gcd(product, N);
+		if (factor != 1 && factor != N) {
+			return factor;
+		}
+	}
+	/* the last block catches all the factors at once */
+	for (auto &value : values) {
+		factor = gcd(value, N);
+		if (factor != 1 && factor != N) {
+			return factor;
+		}
+	}
+	for (size_t j = 0; j < values.size(); j++) {
+		if (values[j] != 0) {
+			continue;
+		}
+		for (auto &x : giantX) {
+			factor = gcd(babyX[j] - x, N);
+			if (factor != 1 && factor != N) {
+				return factor;
+			}
+		}
+	}
+	return N;
+}
+
+/* Stage 2 from the point (X:Z) left by stage 1 on the curve with constant
+a24 = (A+2)/4, covering primes in (B1, B2]. Returns 1 if the curve found
+nothing, otherwise the gcd of N and the differences. When the product of all
+the differences catches all the factors of N at once, the gcds are done
+again block by block, then on smaller products, so the result is N only if
+a single difference or a single point catches all of them. Stops early and
+returns 1 when *stop becomes true. progress is set to the fraction of the
+work done, in percent. */
+Znum ecmStage2Fft(const Znum &N, const Znum &X, const Znum &Z, const Znum &a24,
+	long long B1, long long B2, const std::atomic<bool> *stop, int *progress) {
+	XZPoint Q, Q2, dQ, step, prev, next;
+	std::vector<XZPoint> points;
+	std::vector<Znum> babyX, giantX, values, blockProducts;
+	poly G, inv, c;
+	std::vector<std::vector<poly>> tree;
+	Znum factor, acc = 1;
+	int d, k;
+
+	/* choose d = 2310*m so that about sqrt(B2) giant steps go in each block */
+	double target = sqrt((double)B2 / 10.0);
+	size_t maxK = STAGE2_MAX_BYTES / (mpz_sizeinbase(ZT(N), 2) / 8 + 16);
+	for (d = 2310; ; d += 2310) {
+		k = Totient(d) / 2;
+		if (k >= target || (size_t)k * 2 > maxK) {
+			break;
+		}
+	}
+
+	/* baby steps: x(j*Q) for odd j < d/2, gcd(j, d) = 1 */
+	Q.X = X;
+	Q.Z = Z;
+	XDouble(Q2, Q, a24, N);
+	prev = Q;      // j = 1
+	XAdd(step, Q2, Q, Q, N);    // j = 3
+	points.push_back(Q);
+	for (int j = 3; j < d / 2; j += 2) {
+		if (GcdInt(j, d) == 1) {
+			points.push_back(step);
+		}
+		XAdd(next, step, Q2, prev, N);  // (j+2)Q = jQ + 2Q, difference (j-2)Q
+		prev = step;
+		step = next;
+	}
+	if (!Normalise(points, babyX, factor, N)) {
+		return factor;
+	}
+	ProductTree(babyX, tree, N);
+	/* blocks have at most k giant steps, so deg(G) <= k */
+	PolyInverse(poly(tree.back()[0].rbegin(), tree.back()[0].rend()), k + 1, inv, N);
+
+	/* giant steps: x(i*d*Q) for i from B1/d to B2/d + 1 */
+	long long first = std::max(1LL, B1 / d);
+	long long last = B2 / d + 1;
+	XMultiply(dQ, Q, d, a24, N);
+	if (first == 1) {
+		prev = dQ;
+		XDouble(step, dQ, a24, N);
+	}
+	else {
+		XMultiply(prev, Q, (unsigned long long)first * d, a24, N);
+		XMultiply(step, Q, (unsigned long long)(first + 1) * d, a24, N);
+	}
+	/* prev = first*d*Q, step = (first+1)*d*Q */
+	for (long long i = first; i <= last; ) {
+		if (stop != NULL && *stop) {
+			return 1;
+		}
+		points.clear();
+		for (; i <= last && points.size() < (size_t)k; i++) {
+			points.push_back(prev);
+			XAdd(next, step, dQ, prev, N);
+			prev = step;
+			step = next;
+		}
+		if (!Normalise(points, giantX, factor, N)) {
+			return factor;
+		}
+		PolyFromRoots(giantX, G, N);
+		values.resize(babyX.size());
+		ScaledRemainderRoot(tree, G, inv, c, N);
+		ScaledRemainderTree(tree, tree.size() - 1, 0, c, values, N);
+		Znum blockProduct = 1;
+		for (auto &value : values) {
+			blockProduct = blockProduct * value % N;
+		}
+		blockProducts.push_back(blockProduct);
+		acc = acc * blockProduct % N;
+		if (acc == 0) {
+			return Stage2Backtrack(blockProducts, babyX, giantX, values, N);
+		}
+		if (progress != NULL) {
+			*progress = (int)((i - first) * 100 / (last - first + 1));
+		}
+	}
+	return gcd(acc, N);
+}
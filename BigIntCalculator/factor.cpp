@@ -23,13 +23,14 @@ along with Alpertron Calculators.  If not, see <http://www.gnu.org/licenses/>.
 #include <cstdint>
 #include <cmath>
 #include <cassert>
+#include <atomic>
 #include <windows.h>
 #include <intrin.h>
 #include "showtime.h"
 #include "factor.h"
 
 /* miscellaneous external declarations */
-extern int ElipCurvNo;            // Elliptic Curve Number
+extern std::atomic<int> ElipCurvNo;   // Elliptic Curve Number
 
 void int2dec(char **pOutput, long long nbr);
 extern bool *primeFlags;
@@ -47,6 +48,7 @@ static long long Gamma[386];
 static long long Delta[386];
 static long long AurifQ[386];
 Znum Zfactor;
+std::vector<Znum> ZfactorList;
 
 static int Cos(int N) {
 	switch (N % 8) 	{
@@ -895,7 +897,13 @@ static bool factor(const Znum &toFactor, std::vector<zFactors> &Factors) {
 		if (!rv)
 			return false;  // failed to factorise number
 		 //Check whether factor is not one. In this case we found a proper factor.
-		if (Zfactor != 1) {
+		if (!ZfactorList.empty()) {
+			/* SIQS may split the number into more than 2 factors */
+			for (auto &f : ZfactorList)
+				insertBigFactor(Factors, f);
+			i = -1;			// restart loop at beginning!!
+		}
+		else if (Zfactor != 1) {
 			/* factor is not 1 */
 			insertBigFactor(Factors, Zfactor);
 			i = -1;			// restart loop at beginning!!
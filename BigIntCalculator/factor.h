@@ -15,6 +15,7 @@ You should have received a copy of the GNU General Public License
 along with Alpertron Calculators.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <atomic>
 #include "mpir.h"
 #include "boost/multiprecision/gmp.hpp" 
 #define ZT(a) a.backend().data()
@@ -39,8 +40,17 @@ public:
 
 void showECMStatus(void);
 bool ecm(Znum &Nz, long long maxdivisor);
+Znum ecmStage2Fft(const Znum &N, const Znum &X, const Znum &Z, const Znum &a24,
+	long long B1, long long B2, const std::atomic<bool> *stop, int *progress);
 extern int lang;
+extern bool ecmMpn;           // ECM step 1 with GMP mpn arithmetic, else 31-bit limbs
+extern bool siqsCheckpoint;   // save SIQS relations so that a run can be resumed
+extern int siqsFarmSize;       // number of SIQS sieving processes, 0 = no farm
+extern int siqsFarmIndex;      // 1 to siqsFarmSize: sieve, 0: merge relations
+extern std::string siqsMetricsName;  // SIQS metrics file, empty = none
+extern int siqsMetricsInterval;      // seconds between lines of metrics file
 extern Znum Zfactor;
+extern std::vector<Znum> ZfactorList;  // all factors found by SIQS, or empty
 
 /* access underlying mpz_t inside an bigint */
 #define ZT(a) a.backend().data()
@@ -23,10 +23,10 @@ along with Alpertron Calculators.  If not, see <http://www.gnu.org/licenses/>.
 
 #define KARATSUBA_CUTOFF 16
 
-static limb arr[4 * MAX_LEN];      /*    3 * changed to 4 * on 16/5/2019, because
+static thread_local limb arr[4 * MAX_LEN];      /*    3 * changed to 4 * on 16/5/2019, because
 							karatsuba exceeded arrray bound for large numbers */
-static limb arrayAux[3 * MAX_LEN];
-static int karatLength;
+static thread_local limb arrayAux[3 * MAX_LEN];
+static thread_local int karatLength;
 static void Karatsuba(int idxFactor1, int length, int diffIndex);
 
 #define PROLOG_MULTIPLICATION_DOUBLE                                    \
@@ -2371,6 +2371,16 @@ int main(int argc, char *argv[]) {
 		"KR(a,p) : Kronecker value for (a/p) \n"
 		"Also the following commands: X=hexadecimal o/p, D=decimal o/p \n"
 		"F = do factorisation, N = Don't factorise, S = Spanish, E=English\n"
+		"CHECKPOINT ON = save SIQS relations to a file so that an interrupted run \n"
+		"   on the same number is resumed, CHECKPOINT OFF = don't save them\n"
+		"FARM k/n = this is SIQS sieving process k of n, FARM MERGE/n = merge the\n"
+		"   relations of the n sieving processes and find the factor, FARM OFF\n"
+		"METRICS file [s] = append SIQS progress and phase times to file as JSON lines\n"
+		"   every s seconds (default 10), METRICS OFF = don't write them\n"
+		"SIQSTUNE m n = measure the best SIQS parameters for numbers of m to n digits\n"
+		"   and save them in siqsparams.txt\n"
+		"ECMMPN ON = do ECM step 1 with GMP arithmetic on 64-bit limbs (default),\n"
+		"   ECMMPN OFF = do it with 31-bit limbs\n"
 		"HELP (this message) and EXIT\n";
 
 	const static char ayuda[] =
@@ -2401,7 +2411,19 @@ int main(int argc, char *argv[]) {
 		"SumDivs(n)      : suma de divisores positivos de n primos o compuestos.\n"
 		"NumDigits(n, r) : cantidad de dígitos de n en base r.\n"
 		"SumDigits(n, r) : suma de dígitos de n en base r.\n"
-		"RevDigits(n, r) : halla el valor que se obtiene escribiendo para atrás los dígitos de n en base r.\n";
+		"RevDigits(n, r) : halla el valor que se obtiene escribiendo para atrás los dígitos de n en base r.\n"
+		"CHECKPOINT ON  : guardar las relaciones de SIQS en un archivo para reanudar una ejecución interrumpida\n"
+		"CHECKPOINT OFF : no guardar las relaciones de SIQS\n"
+		"FARM k/n       : este es el proceso de criba SIQS k de n\n"
+		"FARM MERGE/n   : combinar las relaciones de los n procesos de criba y hallar el factor\n"
+		"FARM OFF       : un solo proceso de criba SIQS\n"
+		"METRICS arch [s] : agregar el progreso de SIQS y los tiempos de cada fase al archivo\n"
+		"                 como líneas JSON cada s segundos (10 por omisión)\n"
+		"METRICS OFF    : no escribir las métricas de SIQS\n"
+		"SIQSTUNE m n   : medir los mejores parámetros de SIQS para números de m a n dígitos\n"
+		"                 y guardarlos en siqsparams.txt\n"
+		"ECMMPN ON      : paso 1 de ECM con aritmética de GMP en limbs de 64 bits (por omisión)\n"
+		"ECMMPN OFF     : paso 1 de ECM con limbs de 31 bits\n";
 
 	try {
 		hConsole = GetStdHandle(STD_OUTPUT_HANDLE);  // gete handle for console window
@@ -2466,6 +2488,45 @@ the _MSC_FULL_VER macro evaluates to 150020706 */
 			if (expupper == "N") { factorFlag = false; continue; } // don't do factorisation
 			if (expupper == "X") { hex = true; continue; }         // hexadecimal output
 			if (expupper == "D") { hex = false; continue; }        // decimal output
+			if (expupper == "CHECKPOINT ON") { siqsCheckpoint = true; continue; }   // save SIQS relations
+			if (expupper == "CHECKPOINT OFF") { siqsCheckpoint = false; continue; }
+			if (expupper == "ECMMPN ON") { ecmMpn = true; continue; }    // ECM step 1 arithmetic
+			if (expupper == "ECMMPN OFF") { ecmMpn = false; continue; }
+			if (expupper == "FARM OFF") { siqsFarmSize = 0; continue; }
+			if (expupper.substr(0, 5) == "FARM ") {    // SIQS sieve farm
+				int k, n;
+				if (sscanf(expupper.c_str(), "FARM MERGE/%d", &n) == 1 && n > 0) {
+					siqsFarmSize = n;
+					siqsFarmIndex = 0;
+					continue;
+				}
+				if (sscanf(expupper.c_str(), "FARM %d/%d", &k, &n) == 2 && k > 0 && k <= n) {
+					siqsFarmSize = n;
+					siqsFarmIndex = k;
+					continue;
+				}
+			}
+			if (expupper == "METRICS OFF") { siqsMetricsName.clear(); continue; }
+			if (expupper.substr(0, 8) == "METRICS ") {    // SIQS metrics file
+				char name[256];
+				int n;
+				/* skip the keyword in expr itself, because the file name
+				   keeps its case */
+				int k = sscanf(expr.c_str(), "%*s %255s %d", name, &n);
+				if (k >= 1) {
+					siqsMetricsName = name;
+					if (k == 2 && n > 0)
+						siqsMetricsInterval = n;
+					continue;
+				}
+			}
+			if (expupper.substr(0, 9) == "SIQSTUNE ") {   // tune SIQS parameters
+				int m, n;
+				if (sscanf(expupper.c_str(), "SIQSTUNE %d %d", &m, &n) == 2 && m >= 30 && m <= n) {
+					SIQSTune(m, n);
+					continue;
+				}
+			}
 			if (expupper == "TEST") {
 				doTests();         // do basic tests 
 				continue; 
@@ -41,17 +41,17 @@ limb *MontgomeryMultR2 = MontgomeryMultR2BI.limbs;
 //limb MontgomeryMultR1[MAX_LEN];
 //limb MontgomeryMultR2[MAX_LEN];
 static int powerOf2Exponent;
-static limb aux[MAX_LEN], aux2[MAX_LEN];
-static limb aux3[MAX_LEN], aux4[MAX_LEN];
-static limb aux5[MAX_LEN], aux6[MAX_LEN];
-static limb resultModOdd[MAX_LEN], resultModPower2[MAX_LEN];
+/* work areas are thread_local so that ECM curves can run on several threads
+at once, all using the same modulus */
+static thread_local limb aux[MAX_LEN], aux2[MAX_LEN];
+static thread_local limb aux3[MAX_LEN], aux4[MAX_LEN];
 static int NumberLength2;
 
-long long lModularMult;
+thread_local long long lModularMult;
 mmCback modmultCallback = nullptr;     // function pointer
-static limb U[MAX_LEN], V[MAX_LEN], R[MAX_LEN], S[MAX_LEN];
-static limb Ubak[MAX_LEN], Vbak[MAX_LEN];
-static BigInteger tmpDen, tmpNum, oddValue;
+static thread_local limb U[MAX_LEN], V[MAX_LEN], R[MAX_LEN], S[MAX_LEN];
+static thread_local limb Ubak[MAX_LEN], Vbak[MAX_LEN];
+static thread_local BigInteger tmpDen, tmpNum, oddValue;
 
 
 // Find the inverse of value m 2^(NumberLength*BITS_PER_GROUP)
@@ -1290,7 +1290,9 @@ void modmultIntExtended(const limb *factorBig, int factorInt, limb *result,
 		smallmodmult(factorBig->x, factorInt, result, pTestNbr->x);
 		return;
 	}
-	((limb *)factorBig + nbrLen)->x = 0;   // note: factorBig is modifed, but value does not change
+	if (((limb *)factorBig + nbrLen)->x != 0) {   // may be MontgomeryMultR1 shared by ECM threads
+		((limb *)factorBig + nbrLen)->x = 0;   // note: factorBig is modifed, but value does not change
+	}
 	dTestNbr = getMantissa(pTestNbr + nbrLen, nbrLen);
 	dFactorBig = getMantissa(factorBig + nbrLen, nbrLen);
 	TrialQuotient = (int)(unsigned int)floor(dFactorBig * (double)factorInt / dTestNbr + 0.5);
@@ -1565,7 +1567,9 @@ void ModInvBigNbr(const limb *num, limb *inv, const limb *mod, int nbrLen)
 	}
 	//  1. U <- M, V <- X, R <- 0, S <- 1, k <- 0
 	size = (nbrLen + 1) * sizeof(limb);
-	((limb *)mod + nbrLen)->x = 0;   // value of mod is not changed
+	if (((limb *)mod + nbrLen)->x != 0) {   // don't write TestNbr shared by ECM threads
+		((limb *)mod + nbrLen)->x = 0;   // value of mod is not changed
+	}
 	((limb *)num + nbrLen)->x = 0;   // value of num is not changed
 	memcpy(U, mod, size);
 	memcpy(V, num, size);
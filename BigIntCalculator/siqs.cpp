@@ -25,7 +25,27 @@ or https://en.wikipedia.org/wiki/Quadratic_sieve
 #include <string>
 #include <cmath>
 #include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <chrono>
+#include <ctime>
+#include <sys/stat.h>
 #include <Windows.h>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIQS_X86_SIMD
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 #include "bignbr.h"
 #include "factor.h"
 #include "showtime.h"
@@ -38,13 +58,28 @@ static CONSOLE_SCREEN_BUFFER_INFO csbi;
 extern BigInteger TestNbrBI;
 #define NumberLength TestNbrBI.nbrLimbs
 
-// These defines are valid for factoring up to 10^110.
+// These defines are valid for factoring up to 10^120. Tables whose size
+// depends on the factor base are allocated for each run (see SetSiqsTables).
 #define MAX_NBR_FACTORS         13
-#define MAX_PRIMES          150000
 #define MAX_LIMBS_SIQS          15
+#define PARTIAL_HASH_INITIAL  4096   // initial size of partial hash table (power of 2)
 #define MAX_FACTORS_RELATION    50
 #define LENGTH_OFFSET            0
+#define LANCZOS_MT_MIN      200000   // matrix entries needed to use threads in Block Lanczos
+#define FB_MT_MIN            20000   // candidate primes needed to use threads in factor base setup
+#define FILTER_EXCESS           40   // relations kept over the number of columns
+#define FILTER_MERGE_WEIGHT      6   // merge columns with up to this number of relations
+#define SEED_MULT       1141592621   // seed = SEED_MULT*seed + SEED_ADD
+#define SEED_ADD            321435
+#define FARM_POLL_SECONDS        5   // merge process reads spool files 
+#define FARM_WAIT_SECONDS     1800   // sieving process waits this long for the factor
+#define FARM_ACK_SECONDS        30   // wait for the other processes to read the factor
+#define PARAM_FILE  "siqsparams.txt"
+#define TUNE_STEP               10   // digits between sizes tuned
+#define TUNE_RUNS                3   // each setting is timed this many times
 #define MAX_SIEVE_LIMIT     100000
+#define DLP_MIN_DIGITS          82   // use double large primes from this size
+#define DLP_THRESHOLD_ADJ      0.4   // fraction of log(cofactor bound) subtracted from threshold
 
 #define DEBUG_SIQS               0
 #define __EMSCRIPTEN__
@@ -56,13 +91,17 @@ char *ptrSIQSStrings;
 int startSieveTenths;
 #endif
 
+/* Sieve data of the factor base as a structure of arrays: element i of 
+   each array is for prime i. The roots change for every polynomial, and 
+   with soln1 and each column of Bainv2 contiguous they can be updated for
+   several primes at a time with SIMD instructions. */
 typedef struct {
-	int value;
-	int modsqrt;
-	int Bainv2[MAX_NBR_FACTORS];
-	int Bainv2_0;
-	int soln1;
-	int difsoln;
+	int *value;
+	int *modsqrt;
+	int *Bainv2[MAX_NBR_FACTORS];   // Bainv2[j][i] is for prime i
+	int *Bainv2_0;
+	int *soln1;
+	int *difsoln;
 } PrimeSieveData;
 
 typedef struct {
@@ -73,14 +112,14 @@ typedef struct {
 static unsigned char SIQSInfoText[300];
 static int numberThreads = 1;
 static int matrixBLength;
-static long trialDivisions;
+static std::atomic<long> trialDivisions;
 static long smoothsFound;
 static long totalPartials;
 static long partialsFound;
-static long ValuesSieved;
+static std::atomic<long> ValuesSieved;
 static int nbrFactorBasePrimes;
-static int congruencesFound;
-static long polynomialsSieved;
+static std::atomic<int> congruencesFound;
+static std::atomic<long> polynomialsSieved;
 static int nbrPartials;
 static int multiplier;
 static int nbrFactorsA;
@@ -91,55 +130,237 @@ static int biTestNbr2[MAX_LIMBS_SIQS] = { 0 };
 static int biQuadrCoeff[MAX_LIMBS_SIQS] = { 0 };
 static int biLinearDelta[MAX_LIMBS_SIQS][MAX_LIMBS_SIQS] = { 0 };
 static long largePrimeUpperBound;
+static bool doubleLargePrime;         // use double large prime variation
+static double dlpCofactorBound;       // maximum cofactor for 2 large primes
+static double dlpMinComposite;        // smaller cofactors are prime
 static unsigned char logar2;
 static int aindex[MAX_NBR_FACTORS] = { 0 };
 //  static Thread threadArray[];
-static PrimeSieveData primeSieveData[MAX_PRIMES + 3] = { 0 };
-static PrimeTrialDivisionData primeTrialDivisionData[MAX_PRIMES] = { 0 };
+static PrimeSieveData *primeSieveData;
+static PrimeSieveData sieveDataTables;     // arrays in the arena
+static PrimeTrialDivisionData *primeTrialDivisionData;
 static int span;
 static int indexMinFactorA;
-static int threadNumber;
 static int nbrThreadFinishedPolySet;
+static int NumberLengthSiqs;        // copy of NumberLength for sieve threads; 
+                                    // ModInvBigNbr changes NumberLength temporarily
+static std::mutex amodqMutex;       // polynomial set initialisation (Java: synchronized(amodq))
+static std::condition_variable polySetReady;  // Java: TestNbr2.wait()/notifyAll()
+static std::mutex matrixBMutex;     // relation store (Java: synchronized(matrixB))
 static unsigned int oldSeed;
 static unsigned int newSeed;
 static int NbrPolynomials;
 static int SieveLimit;
-static int matrixPartial[MAX_PRIMES * 8][MAX_LIMBS_SIQS / 2 + 4] = { 0 };
-static int vectLeftHandSide[MAX_PRIMES + 50][MAX_FACTORS_RELATION] = { 0 };
-static int matrixPartialHashIndex[2048] = { 0 };
-static int matrixB[MAX_PRIMES + 50][MAX_FACTORS_RELATION] = { 0 };
+/* Partial relations (one large prime) are stored as records of
+   partialRecordSize ints: large prime (negative if the value was negative),
+   positive square root Ax+B and seed of the polynomial. partialHash is an
+   open addressing table with linear probing which holds the index of the
+   record (-1 = empty). It doubles its size when it becomes half full. */
+static std::vector<int> partialRecords;
+static std::vector<int> partialHash;
+static int partialHashBits;            // log2 of partialHash.size()
+static int partialRecordSize;
+static long long partialLookups;       // statistics of partialHash
+static long long partialProbes;
+static int partialMaxProbe;
+static int (*vectLeftHandSide)[MAX_FACTORS_RELATION];
+static int (*matrixB)[MAX_FACTORS_RELATION];
 static int amodq[MAX_NBR_FACTORS] = { 0 };
 static int tmodqq[MAX_NBR_FACTORS] = { 0 };
 static char threshold;
 static int smallPrimeUpperLimit;
 static int firstLimit;
+static int sieveArraySlack;        // room after the sieve array, see FactoringSIQSx
 static int secondLimit;
 static int thirdLimit;
-static int vectExpParity[MAX_PRIMES + 50] = { 0 };
-static int matrixAV[MAX_PRIMES] = { 0 };
-static int matrixV[MAX_PRIMES] = { 0 };
-static int matrixV1[MAX_PRIMES] = { 0 };
-static int matrixV2[MAX_PRIMES] = { 0 };
-static int matrixXmY[MAX_PRIMES] = { 0 };
-static int newColumns[MAX_PRIMES] = { 0 };
+static int *vectExpParity;
+static uint64_t *matrixAV;
+static uint64_t *matrixV;
+static uint64_t *matrixV1;
+static uint64_t *matrixV2;
+static uint64_t *matrixXmY;
+static int *newColumns;
 // Matrix that holds temporary data
-static int matrixCalc3[MAX_PRIMES] = { 0 };
-static int matrixTemp2[MAX_PRIMES] = { 0 };
+static uint64_t *matrixCalc3;
+static uint64_t *matrixTemp2;
+/* All the tables above that are sized from the factor base are carved out
+   of this arena, which only exists while FactoringSIQSx is running. */
+static std::vector<long long> siqsArena;
+/* The rows of the matrix passed to Block Lanczos are sums of relations:
+   filterRelations[i] holds the indexes of the relations of matrixB that
+   form row i and filterPrimes[i] the columns set to '1' in that row. */
+static std::vector<std::vector<int>> filterPrimes;
+static std::vector<std::vector<int>> filterRelations;
+/* factors of N found from the dependencies. Starts as {N}; every nontrivial
+   gcd splits the factors it divides. */
+static std::vector<Znum> siqsFactors;
 static int nbrPrimes2;
 //static BigInteger factorSiqs;
-static unsigned char onlyFactoring;
 static int matrixRows, matrixCols;
 static PrimeSieveData *firstPrimeSieveData;
 
+/* Bucket sieve: primes larger than a sieve block hit each block at most once
+   per root, so their hits are collected in one bucket per block and then 
+   added to the sieve array one block (L1 cache size) at a time. Each entry
+   holds the offset within the block (bits 0-15) and the logarithm to add
+   (bits 16-31). */
+typedef struct {
+	std::vector<uint32_t> entries;    // bucketSize entries for each block
+	std::vector<uint32_t *> end;      // first free entry of each bucket
+} SieveBuckets;
+static int sieveBlockBits;            // log2 of block size (in shorts)
+static int bucketLimit;               // first factor base index using buckets
+static int bucketSize;                // number of entries per bucket
+#define BUCKET_CHECK_PRIMES    256    // primes between bucket overflow checks
+
+/* The sieve array holds 8-bit logarithms: the low byte of each element is 
+   for the even polynomial and the high byte for the odd polynomial. A byte
+   with the most significant bit set is a candidate. The scan functions
+   store the byte offsets of the candidates in hits and return how many
+   there are. */
+typedef int (*SieveScanFunction)(const unsigned char *sieve, int nbrBytes,
+	int *hits);
+static SieveScanFunction SieveScan;
+
+/* Root update for the next polynomial, using the Gray code: each of the
+   nbrPrimes roots soln1[i] becomes soln1[i] - Bainv2[i] (if polyadd is set)
+   or soln1[i] + Bainv2[i] modulo prime[i]. */
+typedef void (*RootUpdateFunction)(const int *prime, int *soln1,
+	const int *Bainv2, int nbrPrimes, bool polyadd);
+static RootUpdateFunction UpdateRoots;
+
+/* Small prime patterns: the primes below SMALL_PRIME_PATTERN_LIMIT hit the
+   sieve array every few elements, so instead of adding each hit, their
+   logarithms are written into a pattern with period p (plus 16 elements
+   so that any 16 consecutive elements can be read), which is then added
+   to the whole sieve array 8 or 16 elements at a time. */
+#define SMALL_PRIME_PATTERN_LIMIT  64
+#define PATTERN_EXTRA              16
+typedef void (*PatternAddFunction)(short *sieve, int nbrElements,
+	const short *pattern, int period);
+static PatternAddFunction AddPattern;
+static int patternLimit;              // first factor base index not in patterns
+
+/* Fixed width arithmetic for the polynomial coefficients. The functions
+   below are instantiated for each number of limbs used by numbers of 40 to
+   110 digits (the values are computed in 64-bit words), and the ones 
+   matching NumberLength are selected when SIQS starts. Other sizes use the
+   generic BigNbr functions.
+   CandidateValue computes biT = Ax+B (Ax+B-2*delta0 for odd polynomials)
+   and biDividend = biT^2 - kN. UpdateLinearCoeff adds or subtracts
+   2*biDelta to B for the next polynomial of the Gray code. */
+#define FIXED_LIMBS_MIN  6    // NumberLength for 40 digits
+#define FIXED_LIMBS_MAX 14    // NumberLength for 110 digits
+typedef void (*CandidateValueFunction)(const int *biLinearCoeff, int x,
+	bool oddPolynomial, int numLen, int *biT, int *biDividend);
+static CandidateValueFunction CandidateValue;
+typedef void (*CoeffUpdateFunction)(int *biLinearCoeff, const int *biDelta,
+	bool polyadd, int numLen);
+static CoeffUpdateFunction UpdateLinearCoeff;
+
+/* Resieving: after the scan, the primes from resieveFirst onwards are sieved
+   again to find which of them divide each candidate. Trial division then 
+   only has to test those primes instead of the whole end of the factor 
+   base. Smaller primes are tested by comparing the sieve location with 
+   the roots soln1 and soln1-difsoln. */
+static int resieveFirst;              // first factor base index to resieve
+#define RESIEVE_DIVISOR          4    // resieve primes > sieve length / 4
+#define RESIEVE_MIN_HITS         4    // minimum candidates per polynomial to resieve
+
+/* Double large prime variation: each partial relation is an edge between 
+   its 2 large primes (a single large prime p gives an edge between 1 and p).
+   A cycle in this graph gives a full relation. */
+typedef struct {
+	int largePrime1;                    // 1 if only one large prime
+	int largePrime2;
+	unsigned int seed;                  // to get the factors of A
+	int sqrtValue[MAX_LIMBS_SIQS / 2 + 2];  // Ax+B (positive)
+} PartialRelationDLP;
+static std::vector<PartialRelationDLP> partialsDLP;  // edges of graph
+static std::unordered_map<int, int> vertexDLP;       // large prime -> vertex
+static std::vector<int> parentDLP;                   // union-find forest
+static std::vector<std::vector<std::pair<int, int>>> treeDLP; // spanning forest: (vertex, edge)
+static long cyclesDLP;                               // number of cycles found
+
+/* Checkpoint file. When siqsCheckpoint is set, relations are appended to
+   a file as they are found, so that an interrupted run on the same number
+   can be resumed (possibly on another computer). After the header lines
+   (N and factor base parameters) there is one record per line, ending
+   with '.' so that a line truncated when the process died is ignored:
+   R columns... leftHandSide...    relation added to matrix B
+   L Divid seed squareRoot...      partial relation (1 large prime)
+   D prime1 prime2 seed squareRoot...  partial relation (graph edge)
+   S seed                          seed of next polynomial set */
+bool siqsCheckpoint = false;
+static FILE *checkpointFile = NULL;
+static char checkpointName[32];
+
+/* Metrics file. When siqsMetricsName is not empty, a JSON object is 
+   appended to it on a line of its own every siqsMetricsInterval seconds 
+   while sieving ("event":"progress") and at the end of each phase 
+   ("event":"end"), so that the file can be read by other programs. */
+std::string siqsMetricsName;
+int siqsMetricsInterval = 10;   // seconds between progress lines
+enum { PHASE_SETUP, PHASE_SIEVE, PHASE_FILTER, PHASE_LINALG, PHASE_SQRT, NBR_PHASES };
+static const char *phaseNames[NBR_PHASES] = { "setup", "sieve", "filter", "linalg", "sqrt" };
+static double phaseSeconds[NBR_PHASES];    // time used by each phase
+static std::chrono::steady_clock::time_point siqsStart, phaseStart;
+static double metricsLastWrite;            // seconds after siqsStart
+static FILE *metricsFile = NULL;
+static int metricsDigits;                  // digits of number being factored
+static int metricsNeeded;                  // relations needed by sieve stage
+
+/* SIQS parameters for numbers of a given size. The formulas below were
+   tuned for the JavaScript version; a table measured on this computer by
+   SIQSTune is read from PARAM_FILE if it exists. */
+typedef struct {
+	int digits;
+	int nbrPrimes;            // number of primes in factor base
+	int sieveLimit;
+	int largePrimeMult;       // large prime bound / largest prime in factor base
+	int thresholdAdj;         // added to sieve threshold
+} SiqsParams;
+static std::vector<SiqsParams> paramTable;   // sorted by number of digits
+static bool paramTableRead = false;
+static const SiqsParams *tuneParams = NULL;  // parameters tried by SIQSTune
+static double sieveSeconds;                  // duration of last sieve stage
+
+/* Sieve farm: several processes on the same host sieve the same number,
+   each one with a different range of seeds for the factors of A, and write
+   their relations to spool files siqsXXXXXXXX_n.rel (same format as the
+   checkpoint file). The merge process (index 0) reads them, combines 
+   partial relations and performs the linear algebra. The factor found is
+   written to siqsXXXXXXXX.done so that the sieving processes stop. */
+int siqsFarmSize = 0;          // number of sieving processes, 0 = no farm
+int siqsFarmIndex = 0;         // 1 to siqsFarmSize: sieve, 0: merge
+static char farmDoneName[32];
+static std::string farmNumber;  // first line of file with factor found
+static bool farmStopped;        // another process performs linear algebra
+static Znum farmFactor;
+static time_t farmStartTime;    // older done files are from an earlier run
+static std::chrono::steady_clock::time_point farmLastPoll;
+enum eFarmState { FARM_SIEVING, FARM_STOP, FARM_FACTOR };
+
+unsigned long long int gcd(unsigned long long int u, unsigned long long int v);
+
 /* function forward declarations */
 static bool InsertNewRelation(
 	int *rowMatrixB,
 	int *biT, int *biU, int *biR,
 	int numLen);
+static bool RelationInMatrix(const int *rowMatrixB);
 static void BlockLanczos(void);
+static bool LinearAlgebraPhase(int numLen);
 void ShowSIQSStatus(void);
 static unsigned int getFactorsOfA(unsigned int seed, int *indexA);
-static void sieveThread(Znum &result);
+static void sieveThread(int threadNumber);
+static SieveScanFunction SelectSieveScan(void);
+static RootUpdateFunction SelectRootUpdate(void);
+static PatternAddFunction SelectPatternAdd(void);
+static void SelectFixedWidth(int numLen);
+static size_t SetSiqsTables(char *base, int nbrPrimes);
+static void WriteCheckpoint(char type, const int *head, int headLen,
+	const int *values, int count);
 
 #ifdef __EMSCRIPTEN__
 static void showMatrixSize(char *SIQSInfoText, int rows, int cols)
@@ -239,6 +460,97 @@ static void ShowSIQSInfo(int timeSieve, int congruencesFound, int matrixBLength,
 }
 
 #endif
+/* get size in bytes of the level 1 data cache (level = 1) or of the
+   level 2 cache (level = 2). Typical sizes are assumed if not known. */
+static int getCacheSize(int level) {
+	int cacheSize = 0;
+#ifdef _WIN32
+	DWORD length = 0;
+	GetLogicalProcessorInformation(NULL, &length);
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(
+		length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (!info.empty() && GetLogicalProcessorInformation(info.data(), &length)) {
+		for (const auto &proc : info) {
+			if (proc.Relationship == RelationCache && proc.Cache.Level == level &&
+				(proc.Cache.Type == CacheData || proc.Cache.Type == CacheUnified)) {
+				cacheSize = (int)proc.Cache.Size;
+				break;
+			}
+		}
+	}
+#elif defined(_SC_LEVEL1_DCACHE_SIZE)
+	cacheSize = (int)sysconf(level == 1 ? _SC_LEVEL1_DCACHE_SIZE :
+		_SC_LEVEL2_CACHE_SIZE);
+#endif
+	if (cacheSize < 4096) {
+		cacheSize = (level == 1 ? 32768 : 262144);
+	}
+	return cacheSize;
+}
+
+/* add the contents of the buckets to the sieve array one block at a time,
+   then empty the buckets. */
+static void FlushSieveBuckets(short *SieveArray, SieveBuckets &buckets, int X1)
+{
+	int block;
+	for (block = 0; block <= (X1 >> sieveBlockBits); block++)
+	{
+		short *sieveBlock = SieveArray + (block << sieveBlockBits);
+		uint32_t *entry = &buckets.entries[block * bucketSize];
+		uint32_t *bucketEnd = buckets.end[block];
+		for (; entry < bucketEnd; entry++)
+		{
+			sieveBlock[*entry & 0xFFFF] += (short)(*entry >> 16);
+		}
+		buckets.end[block] = &buckets.entries[block * bucketSize];
+	}
+}
+
+/* Add the logarithms of the primes from index up to patternLimit to the 
+   first X1+1 elements of the sieve array using patterns. mask and the 
+   logarithms are updated as in the sieve loops. Returns the index of the
+   next prime to sieve. */
+static int AddSmallPrimePatterns(const PrimeSieveData *primeSieveData,
+	short *SieveArray, int index, int X1, int &mask,
+	short &logPrimeEvenPoly, short &logPrimeOddPoly)
+{
+	short pattern[SMALL_PRIME_PATTERN_LIMIT + PATTERN_EXTRA];
+	int currentPrime, root, rootIndex;
+	int roots[4];
+
+	for (; index < patternLimit; index++)
+	{
+		currentPrime = primeSieveData->value[index];
+		if (currentPrime >= mask)
+		{
+			mask *= 3;
+			logPrimeEvenPoly++;
+			logPrimeOddPoly += 0x100;
+		}
+		if (primeSieveData->difsoln[index] < 0)
+		{
+			continue;          // Prime divides A: do not sieve.
+		}
+		roots[0] = primeSieveData->soln1[index];             // even polynomial
+		roots[1] = roots[0] - primeSieveData->Bainv2_0[index];      // odd polynomial
+		roots[1] += currentPrime & (roots[1] >> 31);
+		roots[2] = roots[0] - primeSieveData->difsoln[index];       // even polynomial
+		roots[2] += currentPrime & (roots[2] >> 31);
+		roots[3] = roots[2] - primeSieveData->Bainv2_0[index];      // odd polynomial
+		roots[3] += currentPrime & (roots[3] >> 31);
+		memset(pattern, 0, (currentPrime + PATTERN_EXTRA) * sizeof(pattern[0]));
+		for (rootIndex = 0; rootIndex < 4; rootIndex++)
+		{
+			for (root = roots[rootIndex]; root < currentPrime + PATTERN_EXTRA; root += currentPrime)
+			{
+				pattern[root] += ((rootIndex & 1) ? logPrimeOddPoly : logPrimeEvenPoly);
+			}
+		}
+		AddPattern(SieveArray, X1 + 1, pattern, currentPrime);
+	}
+	return index;
+}
+
 /* profiling indicates that about 70% of CPU time during SIQS factoring is used within 
 this function, so any attempts to improve performance should probably focus on this
 function. */
@@ -246,7 +558,8 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 	short *SieveArray,
 	int PolynomialIndex,
 	int *biLinearCoeff,
-	int numLen)
+	int numLen,
+	SieveBuckets &buckets)
 {
 	short logPrimeEvenPoly, logPrimeOddPoly;
 	int currentPrime, F1, F2, F3, F4, X1, X2;
@@ -255,7 +568,14 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 	unsigned char polyadd;
 	int S1, G0, G1, G2, G3;
 	int H0, H1, H2, H3, I0, I1, I2, I3;
-	PrimeSieveData *rowPrimeSieveData;  // N.B. element soln1 is modified
+	const int *primeValue = primeSieveData->value;
+	int *soln1 = primeSieveData->soln1;    // N.B. soln1 is modified
+	const int *difsoln = primeSieveData->difsoln;
+	const int *Bainv2_0 = primeSieveData->Bainv2_0;
+	const int *Bainv2;
+	uint32_t logEvenEntry, logOddEntry; // logarithms in bucket entry format
+	uint32_t **bucketEnd;
+	int blockMask;
 
 	F1 = PolynomialIndex;
 	indexFactorA = 0;
@@ -265,27 +585,16 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 		indexFactorA++;
 	}
 	polyadd = (F1 & 2) != 0;
-	if (polyadd)   // Adjust value of B as appropriate
-	{                                // according to the Gray code.
-		AddBigNbrB(biLinearCoeff, biLinearDelta[indexFactorA], biLinearCoeff,
-			numLen);
-		AddBigNbrB(biLinearCoeff, biLinearDelta[indexFactorA], biLinearCoeff,
-			numLen);
-	}
-	else
-	{
-		SubtractBigNbrB(biLinearCoeff, biLinearDelta[indexFactorA],
-			biLinearCoeff, numLen);
-		SubtractBigNbrB(biLinearCoeff, biLinearDelta[indexFactorA],
-			biLinearCoeff, numLen);
-	}
+	// Adjust value of B as appropriate according to the Gray code.
+	UpdateLinearCoeff(biLinearCoeff, biLinearDelta[indexFactorA], polyadd, numLen);
 	indexFactorA--;
 	X1 = SieveLimit << 1;
-	rowPrimeSieveData = primeSieveData + 1;
-	F1 = polyadd ? -rowPrimeSieveData->Bainv2[indexFactorA] :
-		rowPrimeSieveData->Bainv2[indexFactorA];
+	Bainv2 = primeSieveData->Bainv2[indexFactorA];
+	// Compute the roots of the odd primes for the new polynomial.
+	UpdateRoots(primeValue + 2, soln1 + 2, Bainv2 + 2, nbrFactorBasePrimes - 2, polyadd);
+	F1 = polyadd ? -Bainv2[1] : Bainv2[1];
 
-	if (((rowPrimeSieveData->soln1 += F1) & 1) == 0)
+	if (((soln1[1] += F1) & 1) == 0)
 	{
 		*(SieveArray + 0) = (short)(logar2 - threshold);
 		*(SieveArray + 1) = (short)(-threshold);
@@ -295,7 +604,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 		*(SieveArray + 0) = (short)(-threshold);
 		*(SieveArray + 1) = (short)(logar2 - threshold);
 	}
-	if (((rowPrimeSieveData->soln1 + rowPrimeSieveData->Bainv2_0) & 1) == 0)
+	if (((soln1[1] + Bainv2_0[1]) & 1) == 0)
 	{
 		*(SieveArray + 0) += (short)((logar2 - threshold) << 8);
 		*(SieveArray + 1) += (short)((-threshold) << 8);
@@ -309,8 +618,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 	index = 2;
 	for (;;)
 	{
-		rowPrimeSieveData = primeSieveData + index;
-		currentPrime = rowPrimeSieveData->value;
+		currentPrime = primeValue[index];
 		F3 = F2 * currentPrime;
 		if (X1 + 1 < F3)
 		{
@@ -335,16 +643,12 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			logPrimeEvenPoly++;
 		}
 		logPrimeOddPoly = (short)(logPrimeEvenPoly << 8);
-		F1 = polyadd ? -rowPrimeSieveData->Bainv2[indexFactorA] :
-			rowPrimeSieveData->Bainv2[indexFactorA];
-		index2 = (rowPrimeSieveData->soln1 + F1) % currentPrime;
-		rowPrimeSieveData->soln1 = index2 += currentPrime & (index2 >> 31);
-		for (; index2 < F3; index2 += currentPrime)
+		for (index2 = soln1[index]; index2 < F3; index2 += currentPrime)
 		{
 			*(SieveArray + index2) += logPrimeEvenPoly;
 		}
-		for (index2 = (rowPrimeSieveData->soln1 + currentPrime -
-			rowPrimeSieveData->Bainv2_0) % currentPrime;
+		for (index2 = (soln1[index] + currentPrime -
+			Bainv2_0[index]) % currentPrime;
 			index2 < F3;
 			index2 += currentPrime)
 		{
@@ -352,15 +656,15 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 		}
 		if (currentPrime != multiplier)
 		{
-			for (F1 = index2 = (rowPrimeSieveData->soln1 + currentPrime -
-				rowPrimeSieveData->difsoln) % currentPrime;
+			for (F1 = index2 = (soln1[index] + currentPrime -
+				difsoln[index]) % currentPrime;
 				index2 < F3;
 				index2 += currentPrime)
 			{
 				*(SieveArray + index2) += logPrimeEvenPoly;
 			}
 			for (index2 = (F1 + currentPrime -
-				rowPrimeSieveData->Bainv2_0) % currentPrime;
+				Bainv2_0[index]) % currentPrime;
 				index2 < F3;
 				index2 += currentPrime)
 			{
@@ -371,7 +675,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 		F2 *= currentPrime;
 	}
 
-	F1 = (primeSieveData + smallPrimeUpperLimit)->value;
+	F1 = primeValue[smallPrimeUpperLimit];
 	logPrimeEvenPoly = 1;
 	logPrimeOddPoly = 0x100;
 	mask = 5;
@@ -384,21 +688,11 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 	}
 	if (polyadd)
 	{
-		for (; index < smallPrimeUpperLimit; index++)
-		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
-			if ((S1 = rowPrimeSieveData->soln1 -
-				rowPrimeSieveData->Bainv2[indexFactorA]) < 0)
-			{
-				S1 += currentPrime;
-			}
-			rowPrimeSieveData->soln1 = S1;
-		}
-		for (index = smallPrimeUpperLimit; index < firstLimit; index++)
+		index = AddSmallPrimePatterns(primeSieveData, SieveArray, smallPrimeUpperLimit,
+			X1, mask, logPrimeEvenPoly, logPrimeOddPoly);
+		for (; index < firstLimit; index++)
 		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
+			currentPrime = primeValue[index];
 			if (currentPrime >= mask)
 			{
 				mask *= 3;
@@ -408,11 +702,9 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			F2 = currentPrime + currentPrime;
 			F3 = F2 + currentPrime;
 			F4 = F3 + currentPrime;
-			S1 = rowPrimeSieveData->soln1 -
-				rowPrimeSieveData->Bainv2[indexFactorA];
-			rowPrimeSieveData->soln1 = S1 += (S1 >> 31) & currentPrime;
+			S1 = soln1[index];
 			index2 = X1 / F4 * F4 + S1;
-			G0 = -rowPrimeSieveData->difsoln;
+			G0 = -difsoln[index];
 			if (S1 + G0 < 0)
 			{
 				G0 += currentPrime;
@@ -420,7 +712,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			G1 = G0 + currentPrime;
 			G2 = G1 + currentPrime;
 			G3 = G2 + currentPrime;
-			H0 = -rowPrimeSieveData->Bainv2_0;
+			H0 = -Bainv2_0[index];
 			if (S1 + H0 < 0)
 			{
 				H0 += currentPrime;
@@ -428,7 +720,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			H1 = H0 + currentPrime;
 			H2 = H1 + currentPrime;
 			H3 = H2 + currentPrime;
-			I0 = H0 - rowPrimeSieveData->difsoln;
+			I0 = H0 - difsoln[index];
 			if (S1 + I0 < 0)
 			{
 				I0 += currentPrime;
@@ -458,8 +750,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 		}
 		for (; index < secondLimit; index++)
 		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
+			currentPrime = primeValue[index];
 			F2 = currentPrime + currentPrime;
 			F3 = F2 + currentPrime;
 			F4 = F2 + F2;
@@ -470,12 +761,9 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 				logPrimeEvenPoly++;
 				logPrimeOddPoly += 0x100;
 			}
-			if (rowPrimeSieveData->difsoln >= 0)
+			if (difsoln[index] >= 0)
 			{
-				F1 = rowPrimeSieveData->soln1 -
-					rowPrimeSieveData->Bainv2[indexFactorA];
-				F1 += (F1 >> 31) & currentPrime;
-				index2 = (rowPrimeSieveData->soln1 = F1);
+				index2 = F1 = soln1[index];
 				do
 				{
 					*(SieveArray + index2) += logPrimeEvenPoly;
@@ -487,7 +775,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 				{
 					*(SieveArray + index2) += logPrimeEvenPoly;
 				}
-				index2 = F1 - rowPrimeSieveData->Bainv2_0;
+				index2 = F1 - Bainv2_0[index];
 				index2 += (index2 >> 31) & currentPrime;
 				do
 				{
@@ -500,7 +788,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 				{
 					*(SieveArray + index2) += logPrimeOddPoly;
 				}
-				F1 -= rowPrimeSieveData->difsoln;
+				F1 -= difsoln[index];
 				F1 += (F1 >> 31) & currentPrime;
 				index2 = F1;
 				do
@@ -514,7 +802,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 				{
 					*(SieveArray + index2) += logPrimeEvenPoly;
 				}
-				index2 = F1 - rowPrimeSieveData->Bainv2_0;
+				index2 = F1 - Bainv2_0[index];
 				index2 += (index2 >> 31) & currentPrime;
 				do
 				{
@@ -531,28 +819,25 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 		}
 		for (; index < thirdLimit; index++)
 		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
+			currentPrime = primeValue[index];
 			if (currentPrime >= mask)
 			{
 				mask *= 3;
 				logPrimeEvenPoly++;
 				logPrimeOddPoly += 0x100;
 			}
-			F2 = rowPrimeSieveData->soln1 - rowPrimeSieveData->Bainv2[indexFactorA];
-			F2 += currentPrime & (F2 >> 31);
-			index2 = (rowPrimeSieveData->soln1 = F2);
+			index2 = F2 = soln1[index];
 			do
 			{
 				*(SieveArray + index2) += logPrimeEvenPoly;
 			} while ((index2 += currentPrime) <= X1);
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			F1 += currentPrime & (F1 >> 31);
 			do
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			} while ((F1 += currentPrime) <= X1);
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			index2 = F2 += currentPrime & (F2 >> 31);
 			do
 			{
@@ -566,25 +851,24 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 		}
 		for (; index < nbrPrimes2; index++)
 		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
+			currentPrime = primeValue[index];
 			if (currentPrime >= mask)
 			{
 				mask *= 3;
 				logPrimeEvenPoly++;
 				logPrimeOddPoly += 0x100;
 			}
-			F2 = rowPrimeSieveData->soln1 - rowPrimeSieveData->Bainv2[indexFactorA];
-			if ((rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31))) < X1)
+			F2 = soln1[index];
+			if (F2 < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
 			}
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			if ((F1 += currentPrime & (F1 >> 31)) < X1)
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			}
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			if ((F2 += currentPrime & (F2 >> 31)) < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
@@ -593,19 +877,19 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			{
 				*(SieveArray + F2) += logPrimeOddPoly;
 			}
-			rowPrimeSieveData = primeSieveData + ++index;
-			currentPrime = rowPrimeSieveData->value;
-			F2 = rowPrimeSieveData->soln1 - rowPrimeSieveData->Bainv2[indexFactorA];
-			if ((rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31))) < X1)
+			++index;
+			currentPrime = primeValue[index];
+			F2 = soln1[index];
+			if (F2 < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
 			}
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			if ((F1 += currentPrime & (F1 >> 31)) < X1)
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			}
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			if ((F2 += currentPrime & (F2 >> 31)) < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
@@ -614,19 +898,19 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			{
 				*(SieveArray + F2) += logPrimeOddPoly;
 			}
-			rowPrimeSieveData = primeSieveData + ++index;
-			currentPrime = rowPrimeSieveData->value;
-			F2 = rowPrimeSieveData->soln1 - rowPrimeSieveData->Bainv2[indexFactorA];
-			if ((rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31))) < X1)
+			++index;
+			currentPrime = primeValue[index];
+			F2 = soln1[index];
+			if (F2 < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
 			}
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			if ((F1 += currentPrime & (F1 >> 31)) < X1)
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			}
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			if ((F2 += currentPrime & (F2 >> 31)) < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
@@ -636,19 +920,19 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			{
 				*(SieveArray + F2) += logPrimeOddPoly;
 			}
-			rowPrimeSieveData = primeSieveData + ++index;
-			currentPrime = rowPrimeSieveData->value;
-			F2 = rowPrimeSieveData->soln1 - rowPrimeSieveData->Bainv2[indexFactorA];
-			if ((rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31))) < X1)
+			++index;
+			currentPrime = primeValue[index];
+			F2 = soln1[index];
+			if (F2 < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
 			}
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			if ((F1 += currentPrime & (F1 >> 31)) < X1)
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			}
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			if ((F2 += currentPrime & (F2 >> 31)) < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
@@ -659,27 +943,26 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 				*(SieveArray + F2) += logPrimeOddPoly;
 			}
 		}
-		for (; index < nbrFactorBasePrimes; index++)
+		for (; index < bucketLimit; index++)
 		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
+			currentPrime = primeValue[index];
 			if (currentPrime >= mask)
 			{
 				mask *= 3;
 				logPrimeEvenPoly++;
 				logPrimeOddPoly += 0x100;
 			}
-			F2 = rowPrimeSieveData->soln1 - rowPrimeSieveData->Bainv2[indexFactorA];
-			if ((rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31))) < X1)
+			F2 = soln1[index];
+			if (F2 < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
 			}
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			if ((F1 += currentPrime & (F1 >> 31)) < X1)
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			}
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			if ((F2 += currentPrime & (F2 >> 31)) < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
@@ -693,19 +976,11 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 	}
 	else
 	{
-		for (; index < smallPrimeUpperLimit; index++)
+		index = AddSmallPrimePatterns(primeSieveData, SieveArray, smallPrimeUpperLimit,
+			X1, mask, logPrimeEvenPoly, logPrimeOddPoly);
+		for (; index < firstLimit; index++)
 		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
-			S1 = rowPrimeSieveData->soln1 +
-				rowPrimeSieveData->Bainv2[indexFactorA] - currentPrime;
-			S1 += currentPrime & (S1 >> 31);
-			rowPrimeSieveData->soln1 = S1;
-		}
-		for (index = smallPrimeUpperLimit; index < firstLimit; index++)
-		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
+			currentPrime = primeValue[index];
 			if (currentPrime >= mask)
 			{
 				mask *= 3;
@@ -715,11 +990,9 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			F2 = currentPrime + currentPrime;
 			F3 = F2 + currentPrime;
 			F4 = F3 + currentPrime;
-			S1 = rowPrimeSieveData->soln1 +
-				rowPrimeSieveData->Bainv2[indexFactorA] - currentPrime;
-			rowPrimeSieveData->soln1 = S1 += (S1 >> 31) & currentPrime;
+			S1 = soln1[index];
 			index2 = X1 / F4 * F4 + S1;
-			G0 = -rowPrimeSieveData->difsoln;
+			G0 = -difsoln[index];
 			if (S1 + G0 < 0)
 			{
 				G0 += currentPrime;
@@ -727,7 +1000,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			G1 = G0 + currentPrime;
 			G2 = G1 + currentPrime;
 			G3 = G2 + currentPrime;
-			H0 = -rowPrimeSieveData->Bainv2_0;
+			H0 = -Bainv2_0[index];
 			if (S1 + H0 < 0)
 			{
 				H0 += currentPrime;
@@ -735,7 +1008,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			H1 = H0 + currentPrime;
 			H2 = H1 + currentPrime;
 			H3 = H2 + currentPrime;
-			I0 = H0 - rowPrimeSieveData->difsoln;
+			I0 = H0 - difsoln[index];
 			if (S1 + I0 < 0)
 			{
 				I0 += currentPrime;
@@ -765,8 +1038,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 		}
 		for (; index < secondLimit; index++)
 		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
+			currentPrime = primeValue[index];
 			F2 = currentPrime + currentPrime;
 			F3 = F2 + currentPrime;
 			F4 = F2 + F2;
@@ -777,12 +1049,9 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 				logPrimeEvenPoly++;
 				logPrimeOddPoly += 0x100;
 			}
-			if (rowPrimeSieveData->difsoln >= 0)
+			if (difsoln[index] >= 0)
 			{
-				F1 = rowPrimeSieveData->soln1 +
-					rowPrimeSieveData->Bainv2[indexFactorA] - currentPrime;
-				F1 += currentPrime & (F1 >> 31);
-				index2 = (rowPrimeSieveData->soln1 = F1);
+				index2 = F1 = soln1[index];
 				do
 				{
 					*(SieveArray + index2) += logPrimeEvenPoly;
@@ -794,7 +1063,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 				{
 					*(SieveArray + index2) += logPrimeEvenPoly;
 				}
-				index2 = F1 - rowPrimeSieveData->Bainv2_0;
+				index2 = F1 - Bainv2_0[index];
 				index2 += (index2 >> 31) & currentPrime;
 				do
 				{
@@ -807,7 +1076,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 				{
 					*(SieveArray + index2) += logPrimeOddPoly;
 				}
-				F1 -= rowPrimeSieveData->difsoln;
+				F1 -= difsoln[index];
 				F1 += (F1 >> 31) & currentPrime;
 				index2 = F1;
 				do
@@ -821,7 +1090,7 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 				{
 					*(SieveArray + index2) += logPrimeEvenPoly;
 				}
-				index2 = F1 - rowPrimeSieveData->Bainv2_0;
+				index2 = F1 - Bainv2_0[index];
 				index2 += (index2 >> 31) & currentPrime;
 				do
 				{
@@ -838,28 +1107,25 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 		}
 		for (; index < thirdLimit; index++)
 		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
+			currentPrime = primeValue[index];
 			if (currentPrime >= mask)
 			{
 				mask *= 3;
 				logPrimeEvenPoly++;
 				logPrimeOddPoly += 0x100;
 			}
-			F2 = rowPrimeSieveData->soln1 +
-				rowPrimeSieveData->Bainv2[indexFactorA] - currentPrime;
-			index2 = (rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31)));
+			index2 = F2 = soln1[index];
 			do
 			{
 				*(SieveArray + index2) += logPrimeEvenPoly;
 			} while ((index2 += currentPrime) <= X1);
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			F1 += currentPrime & (F1 >> 31);
 			do
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			} while ((F1 += currentPrime) <= X1);
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			F1 = F2 += currentPrime & (F2 >> 31);
 			do
 			{
@@ -874,26 +1140,24 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 		}
 		for (; index < nbrPrimes2; index++)
 		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
+			currentPrime = primeValue[index];
 			if (currentPrime >= mask)
 			{
 				mask *= 3;
 				logPrimeEvenPoly++;
 				logPrimeOddPoly += 0x100;
 			}
-			F2 = rowPrimeSieveData->soln1 +
-				rowPrimeSieveData->Bainv2[indexFactorA] - currentPrime;
-			if ((rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31))) < X1)
+			F2 = soln1[index];
+			if (F2 < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
 			}
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			if ((F1 += currentPrime & (F1 >> 31)) < X1)
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			}
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			if ((F2 += currentPrime & (F2 >> 31)) < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
@@ -903,20 +1167,19 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			{
 				*(SieveArray + F2) += logPrimeOddPoly;
 			}
-			rowPrimeSieveData = primeSieveData + ++index;
-			currentPrime = rowPrimeSieveData->value;
-			F2 = rowPrimeSieveData->soln1 +
-				rowPrimeSieveData->Bainv2[indexFactorA] - currentPrime;
-			if ((rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31))) < X1)
+			++index;
+			currentPrime = primeValue[index];
+			F2 = soln1[index];
+			if (F2 < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
 			}
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			if ((F1 += currentPrime & (F1 >> 31)) < X1)
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			}
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			if ((F2 += currentPrime & (F2 >> 31)) < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
@@ -926,20 +1189,19 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			{
 				*(SieveArray + F2) += logPrimeOddPoly;
 			}
-			rowPrimeSieveData = primeSieveData + ++index;
-			currentPrime = rowPrimeSieveData->value;
-			F2 = rowPrimeSieveData->soln1 +
-				rowPrimeSieveData->Bainv2[indexFactorA] - currentPrime;
-			if ((rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31))) < X1)
+			++index;
+			currentPrime = primeValue[index];
+			F2 = soln1[index];
+			if (F2 < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
 			}
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			if ((F1 += currentPrime & (F1 >> 31)) < X1)
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			}
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			if ((F2 += currentPrime & (F2 >> 31)) < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
@@ -949,20 +1211,19 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			{
 				*(SieveArray + F2) += logPrimeOddPoly;
 			}
-			rowPrimeSieveData = primeSieveData + ++index;
-			currentPrime = rowPrimeSieveData->value;
-			F2 = rowPrimeSieveData->soln1 +
-				rowPrimeSieveData->Bainv2[indexFactorA] - currentPrime;
-			if ((rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31))) < X1)
+			++index;
+			currentPrime = primeValue[index];
+			F2 = soln1[index];
+			if (F2 < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
 			}
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			if ((F1 += currentPrime & (F1 >> 31)) < X1)
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			}
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			if ((F2 += currentPrime & (F2 >> 31)) < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
@@ -973,28 +1234,26 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 				*(SieveArray + F2) += logPrimeOddPoly;
 			}
 		}
-		for (; index < nbrFactorBasePrimes; index++)
+		for (; index < bucketLimit; index++)
 		{
-			rowPrimeSieveData = primeSieveData + index;
-			currentPrime = rowPrimeSieveData->value;
+			currentPrime = primeValue[index];
 			if (currentPrime >= mask)
 			{
 				mask *= 3;
 				logPrimeEvenPoly++;
 				logPrimeOddPoly += 0x100;
 			}
-			F2 = rowPrimeSieveData->soln1 +
-				rowPrimeSieveData->Bainv2[indexFactorA] - currentPrime;
-			if ((rowPrimeSieveData->soln1 = (F2 += currentPrime & (F2 >> 31))) < X1)
+			F2 = soln1[index];
+			if (F2 < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
 			}
-			F1 = F2 - (F3 = rowPrimeSieveData->Bainv2_0);
+			F1 = F2 - (F3 = Bainv2_0[index]);
 			if ((F1 += currentPrime & (F1 >> 31)) < X1)
 			{
 				*(SieveArray + F1) += logPrimeOddPoly;
 			}
-			F2 -= rowPrimeSieveData->difsoln;
+			F2 -= difsoln[index];
 			if ((F2 += currentPrime & (F2 >> 31)) < X1)
 			{
 				*(SieveArray + F2) += logPrimeEvenPoly;
@@ -1006,6 +1265,65 @@ static void PerformSiqsSieveStage(PrimeSieveData *primeSieveData,
 			}
 		}
 	}
+	/* bucket sieve: the remaining primes are larger than a block, so 
+	   store their hits in the bucket of the block they fall in, then
+	   add the contents of each bucket to the sieve array. */
+	blockMask = (1 << sieveBlockBits) - 1;
+	logEvenEntry = (uint32_t)logPrimeEvenPoly << 16;
+	logOddEntry = (uint32_t)logPrimeOddPoly << 16;
+	bucketEnd = buckets.end.data();
+	for (; index < nbrFactorBasePrimes; index++)
+	{
+		if (index % BUCKET_CHECK_PRIMES == 0)
+		{     // Empty buckets if the next primes could overflow one of them.
+			for (F1 = 0; F1 <= (X1 >> sieveBlockBits); F1++)
+			{
+				if (bucketEnd[F1] - &buckets.entries[F1 * bucketSize] >
+					bucketSize - 4 * BUCKET_CHECK_PRIMES)
+				{
+					FlushSieveBuckets(SieveArray, buckets, X1);
+					break;
+				}
+			}
+		}
+		currentPrime = primeValue[index];
+		if (currentPrime >= mask)
+		{
+			mask *= 3;
+			logPrimeEvenPoly++;
+			logPrimeOddPoly += 0x100;
+			logEvenEntry = (uint32_t)logPrimeEvenPoly << 16;
+			logOddEntry = (uint32_t)logPrimeOddPoly << 16;
+		}
+		if (difsoln[index] < 0)
+		{
+			continue;          // Prime divides A: do not sieve.
+		}
+		F2 = soln1[index];
+		for (index2 = F2; index2 < X1; index2 += currentPrime)
+		{
+			*bucketEnd[index2 >> sieveBlockBits]++ = logEvenEntry | (index2 & blockMask);
+		}
+		index2 = F2 - (F3 = Bainv2_0[index]);
+		for (index2 += currentPrime & (index2 >> 31); index2 < X1; index2 += currentPrime)
+		{
+			*bucketEnd[index2 >> sieveBlockBits]++ = logOddEntry | (index2 & blockMask);
+		}
+		F2 -= difsoln[index];
+		for (index2 = F2 += currentPrime & (F2 >> 31); index2 < X1; index2 += currentPrime)
+		{
+			*bucketEnd[index2 >> sieveBlockBits]++ = logEvenEntry | (index2 & blockMask);
+		}
+		F2 -= F3;
+		for (F2 += currentPrime & (F2 >> 31); F2 < X1; F2 += currentPrime)
+		{
+			*bucketEnd[F2 >> sieveBlockBits]++ = logOddEntry | (F2 & blockMask);
+		}
+	}
+	if (bucketLimit < nbrFactorBasePrimes)
+	{
+		FlushSieveBuckets(SieveArray, buckets, X1);
+	}
 }
 
 static void TrialDivisionSub(int Divisor, int divis, const int NumberLengthDividend, 
@@ -1067,7 +1385,8 @@ static void TrialDivisionSub(int Divisor, int divis, const int NumberLengthDivid
 	}
 }
 
-static bool TrialDivisionSubA(const int index,
+static bool TrialDivisionSubA(const PrimeSieveData *primeSieveData,
+	const int index,
 	const int biR[],
 	bool &fullRemainder,
 	const bool oddPolynomial, 
@@ -1080,20 +1399,19 @@ static bool TrialDivisionSubA(const int index,
 	int &nbrColumns) {
 
 	int iRem;
-	const PrimeSieveData *rowPrimeSieveData = primeSieveData + index;
 	const PrimeTrialDivisionData *rowPrimeTrialDivisionData = &primeTrialDivisionData[index];
 
 	if (fullRemainder == false)
 	{
-		Divisor = rowPrimeSieveData->value;
+		Divisor = primeSieveData->value[index];
 		divis = (int)Divisor;
 		if (oddPolynomial)
 		{
-			iRem = index2 - rowPrimeSieveData->soln1 +
-				rowPrimeSieveData->Bainv2_0;
+			iRem = index2 - primeSieveData->soln1[index] +
+				primeSieveData->Bainv2_0[index];
 		}
 		else { // not odd polynomial
-			iRem = index2 - rowPrimeSieveData->soln1;
+			iRem = index2 - primeSieveData->soln1[index];
 		}
 
 		if (iRem >= divis) 	{  // get remainder into range 0 to divis-1
@@ -1108,7 +1426,7 @@ static bool TrialDivisionSubA(const int index,
 		else {
 			iRem += (iRem >> 31) & divis;
 		}
-		if (iRem != 0 && iRem != divis - rowPrimeSieveData->difsoln) {
+		if (iRem != 0 && iRem != divis - primeSieveData->difsoln[index]) {
 			if (expParity != 0)
 			{
 				rowMatrixBbeforeMerge[nbrColumns++] = index;
@@ -1143,13 +1461,36 @@ static bool TrialDivisionSubA(const int index,
 	return false;
 }
 
-static int PerformTrialDivision(PrimeSieveData *primeSieveData,
+/* get the index of the next prime for trial division. Primes from 
+   resieveFirst onwards that were not found by resieving do not divide the
+   dividend, so they are skipped. Factors of A (nextFactorA) must still be
+   tested because the dividend could include them more than once. */
+static inline int NextTrialDivisionIndex(int index, const int resievedPrimes[],
+	int nbrResieved, int &resievedPos, int nextFactorA)
+{                     // resievedPrimes = NULL if there was no resieving.
+	int next;
+	if (++index < resieveFirst || resievedPrimes == NULL) {
+		return index;
+	}
+	while (resievedPos < nbrResieved && resievedPrimes[resievedPos] < index) {
+		resievedPos++;
+	}
+	next = (resievedPos < nbrResieved ? resievedPrimes[resievedPos] : nbrFactorBasePrimes);
+	if (nextFactorA >= index && nextFactorA < next) {
+		next = nextFactorA;
+	}
+	return next;
+}
+
+static long long PerformTrialDivision(PrimeSieveData *primeSieveData,
 	int rowMatrixBbeforeMerge[],		// is altered within this function
 	int index2,
 	const int biDividend[],
 	int rowSquares[],					// is altered within this function				
 	int NumberLengthDividend,
-	const bool oddPolynomial)
+	const bool oddPolynomial,
+	const int resievedPrimes[],         // factor base indexes found by resieving
+	int nbrResieved)
 {
 	int biR[7] = { 0 };
 	int nbrSquares = rowSquares[0];
@@ -1158,7 +1499,6 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 	int index;
 	int expParity;
 	int nbrColumns = rowMatrixBbeforeMerge[0];
-	const PrimeSieveData *rowPrimeSieveData;
 	//const PrimeTrialDivisionData *rowPrimeTrialDivisionData;
 
 	memcpy(biR, biDividend, sizeof(biR));
@@ -1194,8 +1534,10 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 		int indexFactorA = 0;
 		int newFactorAIndex;
 		bool testFactorA = true;
+		int resievedPos = 0;
 		newFactorAIndex = aindex[0];
-		for (index = 1; testFactorA; index++)
+		for (index = 1; testFactorA; index = NextTrialDivisionIndex(index, 
+			resievedPrimes, nbrResieved, resievedPos, testFactorA ? newFactorAIndex : -1))
 		{
 			fullRemainder = false;
 			if (index < 3)
@@ -1215,7 +1557,7 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 				}
 			}
 			for (;;) {
-				if (TrialDivisionSubA(index, biR, fullRemainder, oddPolynomial, index2,
+				if (TrialDivisionSubA(primeSieveData, index, biR, fullRemainder, oddPolynomial, index2,
 					NumberLengthDividend, rowMatrixBbeforeMerge, Divisor, divis,
 					expParity, nbrColumns))
 					break; // Process next prime.
@@ -1235,9 +1577,9 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 							+ (double)biR[0];
 						int sqrtDivid = (int)(floor(sqrt(dDivid)));
 						fullRemainder = true;
-						for (; index < nbrFactorBasePrimes; index++) {
-							rowPrimeSieveData = primeSieveData + index;
-							Divisor = rowPrimeSieveData->value;
+						for (; index < nbrFactorBasePrimes; index = NextTrialDivisionIndex(index,
+							resievedPrimes, nbrResieved, resievedPos, testFactorA ? newFactorAIndex : -1)) {
+							Divisor = primeSieveData->value[index];
 
 							if (testFactorA && index == newFactorAIndex) {
 								fullRemainder = true;
@@ -1253,11 +1595,11 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 								if (fullRemainder == false) {
 									divis = (int)Divisor;
 									if (oddPolynomial) {
-										iRem = index2 - rowPrimeSieveData->soln1 +
-											rowPrimeSieveData->Bainv2_0;
+										iRem = index2 - primeSieveData->soln1[index] +
+											primeSieveData->Bainv2_0[index];
 									}
 									else {
-										iRem = index2 - rowPrimeSieveData->soln1;
+										iRem = index2 - primeSieveData->soln1[index];
 									}
 
 									if (iRem >= divis) {
@@ -1272,7 +1614,7 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 										iRem += (iRem >> 31) & divis;
 									}
 
-									if (iRem != 0 && iRem != divis - rowPrimeSieveData->difsoln)
+									if (iRem != 0 && iRem != divis - primeSieveData->difsoln[index])
 									{
 										break;
 									}
@@ -1335,16 +1677,28 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 							}
 							fullRemainder = false;
 						}
+
+						if (dDivid >= (double)(1U << BITS_PER_INT_GROUP))
+						{                   // Dividend is too large for one large prime.
+							rowSquares[0] = nbrSquares;
+							rowMatrixBbeforeMerge[0] = nbrColumns;
+							if (doubleLargePrime && dDivid < dlpCofactorBound) {
+								return (long long)dDivid;
+							}
+							return 0;
+						}
+						biR[0] = (int)dDivid;
 						break;
 					}
 				}
 			}             /* end inner for */
 		}               /* end for */
 
-		for (; index < nbrFactorBasePrimes; index++) {
+		for (; index < nbrFactorBasePrimes; index = NextTrialDivisionIndex(index,
+			resievedPrimes, nbrResieved, resievedPos, -1)) {
 			fullRemainder = false;
 			for (;;) {
-				if (TrialDivisionSubA(index, biR, fullRemainder, oddPolynomial, index2,
+				if (TrialDivisionSubA(primeSieveData, index, biR, fullRemainder, oddPolynomial, index2,
 					NumberLengthDividend, rowMatrixBbeforeMerge, Divisor, divis,
 					expParity, nbrColumns))
 					break; // Process next prime.
@@ -1364,12 +1718,12 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 							+ (double)biR[0];
 						int sqrtDivid = (int)(floor(sqrt(dDivid)));
 						fullRemainder = true;
-						for (; index < nbrFactorBasePrimes; index++) {
-							rowPrimeSieveData = primeSieveData + index;
-							if (rowPrimeSieveData->value == 41893) 	{
+						for (; index < nbrFactorBasePrimes; index = NextTrialDivisionIndex(index,
+							resievedPrimes, nbrResieved, resievedPos, testFactorA ? newFactorAIndex : -1)) {
+							if (primeSieveData->value[index] == 41893) 	{
 								divis = 5;
 							}
-							Divisor = rowPrimeSieveData->value;
+							Divisor = primeSieveData->value[index];
 							if (testFactorA && index == newFactorAIndex) {
 								fullRemainder = true;
 								if (++indexFactorA == nbrFactorsA) {
@@ -1384,11 +1738,11 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 								if (fullRemainder == false) {
 									divis = (int)Divisor;
 									if (oddPolynomial) {
-										iRem = index2 - rowPrimeSieveData->soln1 +
-											rowPrimeSieveData->Bainv2_0;
+										iRem = index2 - primeSieveData->soln1[index] +
+											primeSieveData->Bainv2_0[index];
 									}
 									else {
-										iRem = index2 - rowPrimeSieveData->soln1;
+										iRem = index2 - primeSieveData->soln1[index];
 									}
 									if (iRem >= divis) {
 										if ((iRem -= divis) >= divis) {
@@ -1401,7 +1755,7 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 										iRem += (iRem >> 31) & divis;
 									}
 
-									if (iRem != 0 && iRem != divis - rowPrimeSieveData->difsoln)
+									if (iRem != 0 && iRem != divis - primeSieveData->difsoln[index])
 									{
 										break;
 									}
@@ -1470,7 +1824,12 @@ static int PerformTrialDivision(PrimeSieveData *primeSieveData,
 						}
 
 						if (dDivid >= (double)(1U << BITS_PER_INT_GROUP))
-						{                   // Dividend is too large.
+						{                   // Dividend is too large for one large prime.
+							rowSquares[0] = nbrSquares;
+							rowMatrixBbeforeMerge[0] = nbrColumns;
+							if (doubleLargePrime && dDivid < dlpCofactorBound) {
+								return (long long)dDivid;
+							}
 							return 0;
 						}
 						biR[0] = (int)dDivid;
@@ -1535,6 +1894,7 @@ static void SmoothRelationFound(
 {
 	int index;
 	int nbrSquares;
+	std::lock_guard<std::mutex> lock(matrixBMutex);   // synchronized(matrixB)
 	if (congruencesFound == matrixBLength)
 	{
 		return;            // All congruences already found.
@@ -1578,6 +1938,83 @@ static void SmoothRelationFound(
 	return;
 }
 
+/* clear the table of partial relations. numLen is the number of limbs of
+   the modulus */
+static void InitPartialHash(int numLen) {
+	nbrPartials = 0;
+	partialRecordSize = numLen / 2 + 3;
+	partialRecords.clear();
+	partialHashBits = 0;
+	while ((1 << partialHashBits) < PARTIAL_HASH_INITIAL) {
+		partialHashBits++;
+	}
+	partialHash.assign((size_t)1 << partialHashBits, -1);
+	partialLookups = 0;
+	partialProbes = 0;
+	partialMaxProbe = 0;
+}
+
+/* first slot of partialHash to be probed for a large prime. The high bits of
+   the product are used because the low bits of odd primes are not random. */
+static inline int PartialHashSlot(int largePrime) {
+	return (int)(((uint32_t)largePrime * 2654435761U) >> (32 - partialHashBits));
+}
+
+/* search the large prime in the table of partial relations. Return the
+   index of its record or -1 if not found. slot is set to the slot of
+   partialHash where the prime is or should be stored. */
+static int FindPartial(int largePrime, int &slot) {
+	int mask = (int)partialHash.size() - 1;
+	int probes = 1;
+	int record;
+
+	for (slot = PartialHashSlot(largePrime); (record = partialHash[slot]) >= 0;
+		slot = (slot + 1) & mask) {
+		int oldPrime = partialRecords[(size_t)record * partialRecordSize];
+		if (oldPrime == largePrime || oldPrime == -largePrime) {
+			break;
+		}
+		probes++;
+	}
+	partialLookups++;
+	partialProbes += probes;
+	if (probes > partialMaxProbe) {
+		partialMaxProbe = probes;
+	}
+	return record;
+}
+
+/* double the size of partialHash and insert all records again */
+static void GrowPartialHash(void) {
+	int mask;
+
+	partialHashBits++;
+	partialHash.assign((size_t)1 << partialHashBits, -1);
+	mask = (int)partialHash.size() - 1;
+	for (int record = 0; record < nbrPartials; record++) {
+		int slot = PartialHashSlot(abs(partialRecords[(size_t)record * partialRecordSize]));
+		while (partialHash[slot] >= 0) {
+			slot = (slot + 1) & mask;
+		}
+		partialHash[slot] = record;
+	}
+}
+
+/* add a new record at the slot returned by FindPartial. Return a pointer to
+   the record; the caller fills the square root and the seed. */
+static int *AddPartial(int slot, int signedPrime) {
+	int *record;
+
+	partialRecords.resize((size_t)(nbrPartials + 1) * partialRecordSize);
+	record = &partialRecords[(size_t)nbrPartials * partialRecordSize];
+	record[0] = signedPrime;
+	partialHash[slot] = nbrPartials++;
+	if (2 * nbrPartials > (int)partialHash.size()) {
+		GrowPartialHash();
+	}
+	return record;
+}
+
 static void PartialRelationFound(
 	unsigned char positive,
 	int *rowMatrixB, int *rowMatrixBbeforeMerge,
@@ -1592,9 +2029,8 @@ static void PartialRelationFound(
 	int expParity;
 	int D, Divisor;
 	int nbrFactorsPartial;
-	int prev;
 	unsigned int seed;
-	int hashIndex;
+	int slot;
 	int *rowPartial;
 	int newDivid = (int)Divid;    // This number is greater than zero.
 	int indexFactorA = 0;
@@ -1603,6 +2039,7 @@ static void PartialRelationFound(
 	int squareRootSize = numLen / 2 + 1;
 	int nbrColumns;
 	PrimeTrialDivisionData *rowPrimeTrialDivisionData;
+	std::lock_guard<std::mutex> lock(matrixBMutex);   // synchronized(matrixB)
 
 	if (congruencesFound == matrixBLength)
 	{
@@ -1612,306 +2049,623 @@ static void PartialRelationFound(
 	totalPartials++;
 	// Check if there is already another relation with the same
 	// factor outside the prime base.
-	// Calculate hash index
-	hashIndex = matrixPartialHashIndex[(int)(Divid & 0xFFE) >> 1];
-	prev = -1;
-	while (hashIndex >= 0)
-	{
+	index = FindPartial(newDivid, slot);
+	if (index >= 0)
+	{   // Match of partials.
 		int oldDivid;
-
-		rowPartial = matrixPartial[hashIndex];
+		double dRem, dDivisor;
+		rowPartial = &partialRecords[(size_t)index * partialRecordSize];
 		oldDivid = rowPartial[0];
-		if (newDivid == oldDivid || newDivid == -oldDivid)
-		{   // Match of partials.
-			double dRem, dDivisor;
-			for (index = 0; index < squareRootSize; index++)
-			{
-				biV[index] = rowPartial[index + 2];
-			}                           // biV = Old positive square root (Ax+B).
-			for (; index < NumberLength; index++)
-			{
-				biV[index] = 0;
-			}
-			seed = rowPartial[squareRootSize + 2];
-			getFactorsOfA(seed, indexFactorsA);
-			IntToBigNbr(newDivid, biR, NumberLength);
-			nbrFactorsPartial = 0;
-			// biT = old (Ax+B)^2.
-			MultBigNbr(biV, biV, biT, NumberLength);
-			// biT = old (Ax+B)^2 - N.
-			SubtractBigNbrB(biT, biModulus, biT, NumberLength);
-			if (oldDivid < 0)
-			{
-				rowPartials[nbrFactorsPartial++] = 0; // Insert -1 as a factor.
-			}
-			if ((uint32_t)biT[NumberLength - 1] >= (uint32_t)LIMB_RANGE)
-			{
-				ChSignBigNbr(biT, NumberLength);   // Make it positive.
-			}
-			NumberLengthDivid = NumberLength;
-			// The number is multiple of the big prime, so divide by it.
-			DivBigNbrByInt(biT, newDivid, biT, NumberLengthDivid);
+		for (index = 0; index < squareRootSize; index++)
+		{
+			biV[index] = rowPartial[index + 1];
+		}                           // biV = Old positive square root (Ax+B).
+		for (; index < NumberLength; index++)
+		{
+			biV[index] = 0;
+		}
+		seed = rowPartial[squareRootSize + 1];
+		getFactorsOfA(seed, indexFactorsA);
+		IntToBigNbr(newDivid, biR, NumberLength);
+		nbrFactorsPartial = 0;
+		// biT = old (Ax+B)^2.
+		MultBigNbr(biV, biV, biT, NumberLength);
+		// biT = old (Ax+B)^2 - N.
+		SubtractBigNbrB(biT, biModulus, biT, NumberLength);
+		if (oldDivid < 0)
+		{
+			rowPartials[nbrFactorsPartial++] = 0; // Insert -1 as a factor.
+		}
+		if ((uint32_t)biT[NumberLength - 1] >= (uint32_t)LIMB_RANGE)
+		{
+			ChSignBigNbr(biT, NumberLength);   // Make it positive.
+		}
+		NumberLengthDivid = NumberLength;
+		// The number is multiple of the big prime, so divide by it.
+		DivBigNbrByInt(biT, newDivid, biT, NumberLengthDivid);
+		if (biT[NumberLengthDivid - 1] == 0)
+		{
+			NumberLengthDivid--;
+		}
+		for (index = 0; index < nbrFactorsA; index++)
+		{
+			DivBigNbrByInt(biT,
+				primeTrialDivisionData[indexFactorsA[index]].value, biT,
+				NumberLengthDivid);
 			if (biT[NumberLengthDivid - 1] == 0)
 			{
 				NumberLengthDivid--;
 			}
-			for (index = 0; index < nbrFactorsA; index++)
+		}
+
+		for (index = 1; index < nbrFactorBasePrimes; index++)
+		{
+			expParity = 0;
+			if (index >= indexMinFactorA && indexFactorA < nbrFactorsA)
 			{
-				DivBigNbrByInt(biT,
-					primeTrialDivisionData[indexFactorsA[index]].value, biT,
-					NumberLengthDivid);
-				if (biT[NumberLengthDivid - 1] == 0)
+				if (index == indexFactorsA[indexFactorA])
 				{
-					NumberLengthDivid--;
+					expParity = 1;
+					indexFactorA++;
 				}
 			}
-
-			for (index = 1; index < nbrFactorBasePrimes; index++)
+			rowPrimeTrialDivisionData = &primeTrialDivisionData[index];
+			Divisor = rowPrimeTrialDivisionData->value;
+			for (;;)
 			{
-				expParity = 0;
-				if (index >= indexMinFactorA && indexFactorA < nbrFactorsA)
-				{
-					if (index == indexFactorsA[indexFactorA])
-					{
-						expParity = 1;
-						indexFactorA++;
-					}
+				dRem = 0;
+				for (int ix = 0; ix < NumberLengthDivid - 1; ix++) {
+					dRem += (double)biT[ix + 1] * (double)rowPrimeTrialDivisionData->exp[ix];
 				}
-				rowPrimeTrialDivisionData = &primeTrialDivisionData[index];
-				Divisor = rowPrimeTrialDivisionData->value;
-				for (;;)
+				dRem +=  biT[0];
+				dDivisor = (double)Divisor;
+				dRem -= floor(dRem / dDivisor)*dDivisor;
+				if (dRem != 0)
 				{
-					dRem = 0;
-					for (int ix = 0; ix < NumberLengthDivid - 1; ix++) {
-						dRem += (double)biT[ix + 1] * (double)rowPrimeTrialDivisionData->exp[ix];
-					}
-					dRem +=  biT[0];
-					dDivisor = (double)Divisor;
-					dRem -= floor(dRem / dDivisor)*dDivisor;
-					if (dRem != 0)
-					{
-						break;
-					}
-					expParity = 1 - expParity;
-					DivBigNbrByInt(biT, Divisor, biT, NumberLengthDivid);
-
-					if (expParity == 0)
-					{
-						rowSquares[rowSquares[0]++] = (int)Divisor;
-					}
-					if (NumberLengthDivid <= 2)
-					{
-						if (biT[0] == 1 && biT[1] == 0)
-						{               // biT = 1, so division has ended.
-							break;
-						}
-					}
-					else if (biT[NumberLengthDivid - 1] == 0)
-					{
-						NumberLengthDivid--;
-					}
+					break;
 				}
-				if (expParity != 0)
+				expParity = 1 - expParity;
+				DivBigNbrByInt(biT, Divisor, biT, NumberLengthDivid);
+
+				if (expParity == 0)
 				{
-					rowPartials[nbrFactorsPartial++] = index;
+					rowSquares[rowSquares[0]++] = (int)Divisor;
 				}
-			}
-			MultBigNbrByIntB(biQuadrCoeff, index2 - SieveLimit, biT,
-				NumberLength);
-			AddBigNbrB(biT, biLinearCoeff, biT, NumberLength); // biT = Ax+B
-			if (oddPolynomial)
-			{                                                     // Ax+B (odd)
-				SubtractBigNbrB(biT, biLinearDelta[0], biT, NumberLength);
-				SubtractBigNbrB(biT, biLinearDelta[0], biT, NumberLength);
-			}
-			if ((uint32_t)biT[NumberLength - 1] >= (uint32_t)LIMB_RANGE)
-			{                                        // If number is negative
-				ChSignBigNbr(biT, NumberLength);   // make it positive.
-			}
-			// biU = Product of old Ax+B times new Ax+B
-			MultBigNbrModN(biV, biT, biU, biModulus, NumberLength);
-			// Add all elements of aindex array to the rowMatrixB array discarding
-			// duplicates.
-			mergeArrays(aindex, nbrFactorsA, rowMatrixB, rowMatrixBbeforeMerge, rowSquares);
-			rowMatrixBbeforeMerge[0] = nbrColumns = rowMatrixB[LENGTH_OFFSET];
-			memcpy(&rowMatrixBbeforeMerge[1], &rowMatrixB[1], nbrColumns * sizeof(int));
-			mergeArrays(rowPartials, nbrFactorsPartial, rowMatrixB, rowMatrixBbeforeMerge, rowSquares);
-			nbrSquares = rowSquares[0];
-			for (index = 1; index < nbrSquares; index++)
-			{
-				D = rowSquares[index];
-				if (D != multiplier)
+				if (NumberLengthDivid <= 2)
 				{
-					MultBigNbrByInt(biR, D, biR, NumberLength);
+					if (biT[0] == 1 && biT[1] == 0)
+					{               // biT = 1, so division has ended.
+						break;
+					}
 				}
-				else
+				else if (biT[NumberLengthDivid - 1] == 0)
 				{
-					AddBigNbr(biU, biModulus, biU, NumberLength);
-					DivBigNbrByInt(biU, multiplier, biU, NumberLength);
+					NumberLengthDivid--;
 				}
 			}
-			if (rowMatrixB[0] > 1 &&
-				InsertNewRelation(rowMatrixB, biT, biU, biR, NumberLength))
+			if (expParity != 0)
 			{
-				partialsFound++;
-				ShowSIQSStatus();
+				rowPartials[nbrFactorsPartial++] = index;
 			}
-			return;
 		}
-		else
-		{
-			prev = hashIndex;
-			hashIndex = rowPartial[1]; // Get next index for same hash.
+		MultBigNbrByIntB(biQuadrCoeff, index2 - SieveLimit, biT,
+			NumberLength);
+		AddBigNbrB(biT, biLinearCoeff, biT, NumberLength); // biT = Ax+B
+		if (oddPolynomial)
+		{                                                     // Ax+B (odd)
+			SubtractBigNbrB(biT, biLinearDelta[0], biT, NumberLength);
+			SubtractBigNbrB(biT, biLinearDelta[0], biT, NumberLength);
 		}
-	} /* end while */
-	  //  synchronized(firstPrimeSieveData)
-	{
-		if (hashIndex == -1 && nbrPartials < MAX_PRIMES * 8)
-		{ // No match and partials table is not full.
-		  // Add partial to table of partials.
-			if (prev >= 0)
+		if ((uint32_t)biT[NumberLength - 1] >= (uint32_t)LIMB_RANGE)
+		{                                        // If number is negative
+			ChSignBigNbr(biT, NumberLength);   // make it positive.
+		}
+		// biU = Product of old Ax+B times new Ax+B
+		MultBigNbrModN(biV, biT, biU, biModulus, NumberLength);
+		// Add all elements of aindex array to the rowMatrixB array discarding
+		// duplicates.
+		mergeArrays(aindex, nbrFactorsA, rowMatrixB, rowMatrixBbeforeMerge, rowSquares);
+		rowMatrixBbeforeMerge[0] = nbrColumns = rowMatrixB[LENGTH_OFFSET];
+		memcpy(&rowMatrixBbeforeMerge[1], &rowMatrixB[1], nbrColumns * sizeof(int));
+		mergeArrays(rowPartials, nbrFactorsPartial, rowMatrixB, rowMatrixBbeforeMerge, rowSquares);
+		nbrSquares = rowSquares[0];
+		for (index = 1; index < nbrSquares; index++)
+		{
+			D = rowSquares[index];
+			if (D != multiplier)
 			{
-				matrixPartial[prev][1] = nbrPartials;
+				MultBigNbrByInt(biR, D, biR, NumberLength);
 			}
 			else
 			{
-				matrixPartialHashIndex[(newDivid & 0xFFE) >> 1] = nbrPartials;
-			}
-			rowPartial = matrixPartial[nbrPartials];
-			// Add all elements of aindex array to the rowMatrixB array discarding
-			// duplicates.
-			mergeArrays(aindex, nbrFactorsA, rowMatrixB, rowMatrixBbeforeMerge, rowSquares);
-			IntToBigNbr(Divid, biR, NumberLength);
-			nbrSquares = rowSquares[0];
-			for (index = 1; index < nbrSquares; index++)
-			{
-				D = rowSquares[index];
-				MultBigNbrByIntModN(biR, D, biR, biModulus, NumberLength);
-				if (D == multiplier)
-				{
-					DivBigNbrByInt(biU, D, biU, NumberLength);
-				}
-			}
-			rowPartial[0] = (positive ? newDivid : -newDivid);
-			// Indicate last index with this hash.
-			rowPartial[1] = -1;
-			MultBigNbrByIntB(biQuadrCoeff, index2 - SieveLimit, biT,
-				NumberLength);
-			AddBigNbrB(biT, biLinearCoeff, biT, NumberLength); // biT = Ax+B
-			if (oddPolynomial)
-			{                                                     // Ax+B (odd)
-				SubtractBigNbrB(biT, biLinearDelta[0], biT, NumberLength);
-				SubtractBigNbrB(biT, biLinearDelta[0], biT, NumberLength);
-			}
-			if ((uint32_t)biT[NumberLength - 1] >= (uint32_t)LIMB_RANGE)
-			{                      // If square root is negative convert to positive.
-				ChSignBigNbr(biT, NumberLength);
-			}
-			for (index = 0; index < squareRootSize; index++)
-			{
-				rowPartial[index + 2] = (int)biT[index];
+				AddBigNbr(biU, biModulus, biU, NumberLength);
+				DivBigNbrByInt(biU, multiplier, biU, NumberLength);
 			}
-			rowPartial[squareRootSize + 2] = (int)oldSeed;
-			nbrPartials++;
 		}
-	}               // End synchronized block.
-	return;
-}
-
-static void SieveLocationHit(int rowMatrixB[], int rowMatrixBbeforeMerge[],
-	int index2,
-	PrimeSieveData *primeSieveData,
-	int rowPartials[],
-	int rowSquares[], int biDividend[],
-	int numLen, int biT[], int *biLinearCoeff,
-	int biR[], int biU[], int biV[],
-	int indexFactorsA[], const bool oddPolynomial)
-{
-	unsigned char positive;
-	int NumberLengthDivid;
-	int index;
-	int Divid;
-	int nbrColumns;
-
-	trialDivisions++;
-	if (trialDivisions == 496)
-	{
-		trialDivisions = 496;
-	}
-	MultBigNbrByInt(biQuadrCoeff, index2 - SieveLimit, biT,
-		numLen);                                      // Ax
-	AddBigNbrB(biT, biLinearCoeff, biT, numLen);    // Ax+B
-	if (oddPolynomial)
-	{                                                     // Ax+B (odd)
-		SubtractBigNbr(biT, biLinearDelta[0], biT, numLen);
-		SubtractBigNbr(biT, biLinearDelta[0], biT, numLen);
-	}
-	MultBigNbr(biT, biT, biDividend, numLen);       // (Ax+B)^2
-														  // To factor: (Ax+B)^2-N
-	SubtractBigNbrB(biDividend, biModulus, biDividend, numLen);
-	/* factor biDividend */
-
-	NumberLengthDivid = numLen; /* Number length for dividend */
-	positive = true;
-	if ((uint32_t)biDividend[NumberLengthDivid - 1] >= (uint32_t)LIMB_RANGE)
-	{ /* Negative */
-		positive = false;
-		ChSignBigNbr(biDividend, NumberLengthDivid); // Convert to positive
+		if (rowMatrixB[0] > 1 &&
+			InsertNewRelation(rowMatrixB, biT, biU, biR, NumberLength))
+		{
+			partialsFound++;
+			ShowSIQSStatus();
+		}
+		return;
 	}
-	rowSquares[0] = 1;
-	for (index = 0; index < nbrFactorsA; index++)
+	// No match. Add partial to table of partials.
+	rowPartial = AddPartial(slot, positive ? newDivid : -newDivid);
+	// Add all elements of aindex array to the rowMatrixB array discarding
+	// duplicates.
+	mergeArrays(aindex, nbrFactorsA, rowMatrixB, rowMatrixBbeforeMerge, rowSquares);
+	IntToBigNbr(Divid, biR, NumberLength);
+	nbrSquares = rowSquares[0];
+	for (index = 1; index < nbrSquares; index++)
 	{
-		DivBigNbrByInt(biDividend, afact[index], biDividend,
-			NumberLengthDivid);
-		if (biDividend[NumberLengthDivid - 1] == 0)
+		D = rowSquares[index];
+		MultBigNbrByIntModN(biR, D, biR, biModulus, NumberLength);
+		if (D == multiplier)
 		{
-			NumberLengthDivid--;
+			DivBigNbrByInt(biU, D, biU, NumberLength);
 		}
 	}
-	nbrColumns = 1;
-	if (!positive)
-	{                                  // Insert -1 as a factor.
-		rowMatrixBbeforeMerge[nbrColumns++] = 0;
+	MultBigNbrByIntB(biQuadrCoeff, index2 - SieveLimit, biT,
+		NumberLength);
+	AddBigNbrB(biT, biLinearCoeff, biT, NumberLength); // biT = Ax+B
+	if (oddPolynomial)
+	{                                                     // Ax+B (odd)
+		SubtractBigNbrB(biT, biLinearDelta[0], biT, NumberLength);
+		SubtractBigNbrB(biT, biLinearDelta[0], biT, NumberLength);
 	}
-	rowMatrixBbeforeMerge[0] = nbrColumns;
-	Divid = PerformTrialDivision(primeSieveData,
-		rowMatrixBbeforeMerge,
-		index2, biDividend,
-		rowSquares, NumberLengthDivid,
-		oddPolynomial);
-	if (Divid == 1)
-	{ // Smooth relation found.
-		SmoothRelationFound(positive, rowMatrixB,
-			rowMatrixBbeforeMerge,
-			index2,
-			rowSquares,
-			biLinearCoeff, numLen, biT, biU, biR,
-			oddPolynomial);
+	if ((uint32_t)biT[NumberLength - 1] >= (uint32_t)LIMB_RANGE)
+	{                      // If square root is negative convert to positive.
+		ChSignBigNbr(biT, NumberLength);
 	}
-	else
+	for (index = 0; index < squareRootSize; index++)
 	{
-		if (Divid > 0 && Divid < largePrimeUpperBound)
-		{
-			PartialRelationFound(positive, rowMatrixB,
-				rowMatrixBbeforeMerge,
-				index2,
-				Divid, rowPartials,
-				rowSquares, biLinearCoeff,
-				numLen, biT, biR, biU, biV,
-				indexFactorsA, oddPolynomial);
-		}
+		rowPartial[index + 1] = (int)biT[index];
 	}
+	rowPartial[squareRootSize + 1] = (int)oldSeed;
+	int head[2] = { rowPartial[0], (int)oldSeed };
+	WriteCheckpoint('L', head, 2, &rowPartial[1], squareRootSize);
 	return;
 }
 
-static unsigned int getFactorsOfA(unsigned int seed, int *indexA)
-{
-	int index, index2, i, tmp;
-	for (index = 0; index < nbrFactorsA; index++)
+/* return (a*b) mod n for n < 2^52. The quotient is estimated using double 
+   precision and the remainder is adjusted afterwards. */
+static long long mulModDLP(long long a, long long b, long long n) {
+	long long q = (long long)((double)a * (double)b / (double)n);
+	long long r = (long long)((unsigned long long)a * (unsigned long long)b -
+		(unsigned long long)q * (unsigned long long)n);
+	while (r < 0) {
+		r += n;
+	}
+	while (r >= n) {
+		r -= n;
+	}
+	return r;
+}
+
+/* strong probable prime test to base a for odd n < 2^52 */
+static bool witnessDLP(long long n, long long a) {
+	long long d = n - 1, x = 1, p = a;
+	int s = 0;
+	while ((d & 1) == 0) {
+		d >>= 1;
+		s++;
+	}
+	for (; d > 0; d >>= 1) {   // x = a^d mod n
+		if (d & 1) {
+			x = mulModDLP(x, p, n);
+		}
+		p = mulModDLP(p, p, n);
+	}
+	if (x == 1 || x == n - 1) {
+		return true;
+	}
+	while (--s > 0) {
+		x = mulModDLP(x, x, n);
+		if (x == n - 1) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Split cofactor that has no prime factors in the factor base. 
+   Return a factor, or 0 if cofactor is prime or it could not be split. 
+   Uses Brent's variant of Pollard's rho method. */
+static long long SplitCofactorDLP(long long cofactor) {
+	const int bases[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23 };  // enough for n < 3.8*10^18
+	long long root = (long long)sqrt((double)cofactor);
+	if (root*root == cofactor) {
+		return root;               // cofactor = p^2
+	}
+	for (int a : bases) {
+		if (!witnessDLP(cofactor, a)) {
+			break;                 // cofactor is composite
+		}
+		if (a == 23) {
+			return 0;              // cofactor is prime
+		}
+	}
+	for (long long c = 1; c < 4; c++) {
+		long long x = 2, y = 2, ys = 2, q = 1, g = 1;
+		for (long long r = 1; g == 1 && r < 0x10000; r *= 2) {
+			x = y;
+			for (long long i = 0; i < r; i++) {
+				y = mulModDLP(y, y, cofactor) + c;   // y = y^2 + c
+			}
+			for (long long k = 0; k < r && g == 1; k += 64) {
+				ys = y;
+				for (long long i = 0; i < 64 && i < r - k; i++) {
+					y = mulModDLP(y, y, cofactor) + c;
+					q = mulModDLP(q, (x > y ? x - y : y - x), cofactor);
+				}
+				g = (long long)gcd(q, cofactor);
+			}
+		}
+		if (g == cofactor) {      // gcd of the last block was n, so backtrack.
+			do {
+				ys = mulModDLP(ys, ys, cofactor) + c;
+				g = (long long)gcd(x > ys ? x - ys : ys - x, cofactor);
+			} while (g == 1);
+		}
+		if (g != cofactor && g != 1) {
+			return g;
+		}
+	}
+	return 0;
+}
+
+/* Get the indexes in the factor base of the prime factors of (Ax+B)^2 - kN 
+   for a stored partial relation. The index is appended once for each power of 
+   the prime. Index 0 stands for -1. On exit biV = Ax+B.
+   Return false if the value does not factor completely. */
+static bool getPartialFactors(const PartialRelationDLP &rel, std::vector<int> &factors,
+	int *biT, int *biV, int numLen)
+{
+	int indexFactorsA[MAX_NBR_FACTORS];
+	int index, Divisor;
+	int NumberLengthDivid;
+	int squareRootSize = numLen / 2 + 1;
+	double dRem, dDivisor;
+	const PrimeTrialDivisionData *rowPrimeTrialDivisionData;
+
+	for (index = 0; index < squareRootSize; index++) {
+		biV[index] = rel.sqrtValue[index];
+	}
+	for (; index < numLen; index++) {
+		biV[index] = 0;
+	}
+	MultBigNbr(biV, biV, biT, numLen);            // biT = (Ax+B)^2
+	SubtractBigNbrB(biT, biModulus, biT, numLen); // biT = (Ax+B)^2 - kN
+	if ((uint32_t)biT[numLen - 1] >= (uint32_t)LIMB_RANGE) {
+		factors.push_back(0);                      // Insert -1 as a factor.
+		ChSignBigNbr(biT, numLen);                // Make it positive.
+	}
+	NumberLengthDivid = numLen;
+	// Divide by the large primes and by the factors of A.
+	DivBigNbrByInt(biT, rel.largePrime1, biT, NumberLengthDivid);
+	DivBigNbrByInt(biT, rel.largePrime2, biT, NumberLengthDivid);
+	getFactorsOfA(rel.seed, indexFactorsA);
+	for (index = 0; index < nbrFactorsA; index++) {
+		DivBigNbrByInt(biT, primeTrialDivisionData[indexFactorsA[index]].value,
+			biT, NumberLengthDivid);
+		factors.push_back(indexFactorsA[index]);
+	}
+	while (NumberLengthDivid > 1 && biT[NumberLengthDivid - 1] == 0) {
+		NumberLengthDivid--;
+	}
+	if (NumberLengthDivid > 7) {
+		return false;        // too large for table of powers of 2^31 mod p
+	}
+
+	for (index = 1; index < nbrFactorBasePrimes; index++) {
+		if (NumberLengthDivid == 1 && biT[0] == 1) {
+			break;           // all factors found.
+		}
+		rowPrimeTrialDivisionData = &primeTrialDivisionData[index];
+		Divisor = rowPrimeTrialDivisionData->value;
+		dDivisor = (double)Divisor;
+		for (;;) {
+			dRem = 0;
+			for (int ix = 0; ix < NumberLengthDivid - 1; ix++) {
+				dRem += (double)biT[ix + 1] * (double)rowPrimeTrialDivisionData->exp[ix];
+			}
+			dRem += biT[0];
+			dRem -= floor(dRem / dDivisor)*dDivisor;
+			if (dRem != 0) {
+				break;
+			}
+			DivBigNbrByInt(biT, Divisor, biT, NumberLengthDivid);
+			factors.push_back(index);
+			if (NumberLengthDivid > 1 && biT[NumberLengthDivid - 1] == 0) {
+				NumberLengthDivid--;
+			}
+		}
+	}
+	return (NumberLengthDivid == 1 && biT[0] == 1);
+}
+
+/* Combine the partial relations in a cycle of the large prime graph into
+   a full relation and add it to matrix B. */
+static bool CombineCycleDLP(const std::vector<int> &cycle,
+	int *biT, int *biR, int *biU, int *biV, int numLen)
+{
+	std::vector<int> factors;
+	std::vector<int> largePrimes;
+	int rowMatrixB[MAX_FACTORS_RELATION];
+	int nbrColumns = 1;
+	int nbrMultiplier = 0;   // number of values Ax+B divided by multiplier
+	int index, count, D;
+
+	IntToBigNbr(1, biU, numLen);
+	IntToBigNbr(1, biR, numLen);
+	for (int edge : cycle) {
+		const PartialRelationDLP &rel = partialsDLP[edge];
+		if (!getPartialFactors(rel, factors, biT, biV, numLen)) {
+			return false;
+		}
+		if (rel.largePrime1 != 1) {
+			largePrimes.push_back(rel.largePrime1);
+		}
+		largePrimes.push_back(rel.largePrime2);
+		// Remove multiplier from Ax+B so that biU can be reduced mod kN.
+		if (multiplier != 1 && RemDivBigNbrByInt(biV, multiplier, numLen) == 0) {
+			DivBigNbrByInt(biV, multiplier, biV, numLen);
+			nbrMultiplier++;
+		}
+		MultBigNbrModN(biV, biU, biT, biModulus, numLen);  // biU *= Ax+B
+		memcpy(biU, biT, numLen * sizeof(biU[0]));
+	}
+
+	std::sort(factors.begin(), factors.end());
+	for (index = 0; index < (int)factors.size(); index += count) {
+		int primeIndex = factors[index];
+		for (count = 1; index + count < (int)factors.size() &&
+			factors[index + count] == primeIndex; count++);
+		if (count & 1) {
+			if (nbrColumns >= MAX_FACTORS_RELATION) {
+				return false;    // Too many factors for matrix B.
+			}
+			rowMatrixB[nbrColumns++] = primeIndex;
+		}
+		if (primeIndex == 0) {
+			continue;
+		}
+		D = primeTrialDivisionData[primeIndex].value;
+		if (D == multiplier) {
+			continue;
+		}
+		for (int c = count / 2; c > 0; c--) {
+			MultBigNbrByIntModN(biR, D, biR, biModulus, numLen);
+		}
+	}
+	rowMatrixB[LENGTH_OFFSET] = nbrColumns;
+	if (nbrColumns <= 1) {
+		return false;
+	}
+	// Every large prime appears twice in the cycle.
+	std::sort(largePrimes.begin(), largePrimes.end());
+	for (index = 0; index < (int)largePrimes.size(); index += 2) {
+		MultBigNbrByIntModN(biR, largePrimes[index], biR, biModulus, numLen);
+	}
+	for (count = (nbrMultiplier + 1) / 2; count > 0; count--) {
+		MultBigNbrByIntModN(biU, multiplier, biU, biModulus, numLen);
+	}
+	return InsertNewRelation(rowMatrixB, biT, biU, biR, numLen);
+}
+
+static int getVertexDLP(int largePrime) {
+	auto it = vertexDLP.find(largePrime);
+	if (it != vertexDLP.end()) {
+		return it->second;
+	}
+	int vertex = (int)parentDLP.size();
+	vertexDLP[largePrime] = vertex;
+	parentDLP.push_back(vertex);
+	treeDLP.emplace_back();
+	return vertex;
+}
+
+static int findRootDLP(int vertex) {
+	while (parentDLP[vertex] != vertex) {
+		parentDLP[vertex] = parentDLP[parentDLP[vertex]];  // path halving
+		vertex = parentDLP[vertex];
+	}
+	return vertex;
+}
+
+/* find the edges on the path between 2 vertices of the same tree */
+static void findPathDLP(int from, int to, std::vector<int> &edges) {
+	std::unordered_map<int, std::pair<int, int>> previous;  // vertex -> (vertex, edge)
+	std::vector<int> queue;
+	queue.push_back(from);
+	previous[from] = std::make_pair(-1, -1);
+	for (size_t head = 0; head < queue.size() && previous.count(to) == 0; head++) {
+		int vertex = queue[head];
+		for (auto &next : treeDLP[vertex]) {
+			if (previous.count(next.first) == 0) {
+				previous[next.first] = std::make_pair(vertex, next.second);
+				queue.push_back(next.first);
+			}
+		}
+	}
+	for (int vertex = to; vertex != from; vertex = previous[vertex].first) {
+		edges.push_back(previous[vertex].second);
+	}
+}
+
+/* Partial relation with one or two large primes found. Add it to the graph 
+   of large primes. If the new edge closes a cycle, combine the relations 
+   in the cycle to get a full relation. */
+/* Add a partial relation to the large prime graph. Return true if it
+   closes a cycle and the resulting full relation is added to matrix B. */
+static bool AddEdgeDLP(const PartialRelationDLP &rel,
+	int *biT, int *biR, int *biU, int *biV, int numLen)
+{
+	int vertex1, vertex2, root1, root2;
+
+	partialsDLP.push_back(rel);
+	vertex1 = getVertexDLP(rel.largePrime1);
+	vertex2 = getVertexDLP(rel.largePrime2);
+	root1 = findRootDLP(vertex1);
+	root2 = findRootDLP(vertex2);
+	if (root1 != root2) {           // join the two trees
+		parentDLP[root1] = root2;
+		treeDLP[vertex1].push_back(std::make_pair(vertex2, (int)partialsDLP.size() - 1));
+		treeDLP[vertex2].push_back(std::make_pair(vertex1, (int)partialsDLP.size() - 1));
+		return false;
+	}
+	// The new edge closes a cycle.
+	std::vector<int> cycle;
+	cyclesDLP++;
+	findPathDLP(vertex1, vertex2, cycle);
+	cycle.push_back((int)partialsDLP.size() - 1);
+	return CombineCycleDLP(cycle, biT, biR, biU, biV, numLen);
+}
+
+static void DoubleLargePrimeFound(int largePrime1, int largePrime2,
+	int index2, int *biLinearCoeff, int numLen, int *biT,
+	int *biR, int *biU, int *biV, const bool oddPolynomial)
+{
+	PartialRelationDLP rel;
+	int index;
+	int squareRootSize = numLen / 2 + 1;
+	std::lock_guard<std::mutex> lock(matrixBMutex);   // synchronized(matrixB)
+
+	if (congruencesFound == matrixBLength) {
+		return;
+	}
+	totalPartials++;
+	MultBigNbrByIntB(biQuadrCoeff, index2 - SieveLimit, biT, numLen);
+	AddBigNbrB(biT, biLinearCoeff, biT, numLen); // biT = Ax+B
+	if (oddPolynomial)
+	{                                             // Ax+B (odd)
+		SubtractBigNbrB(biT, biLinearDelta[0], biT, numLen);
+		SubtractBigNbrB(biT, biLinearDelta[0], biT, numLen);
+	}
+	if ((uint32_t)biT[numLen - 1] >= (uint32_t)LIMB_RANGE)
+	{                      // If square root is negative convert to positive.
+		ChSignBigNbr(biT, numLen);
+	}
+	rel.largePrime1 = largePrime1;
+	rel.largePrime2 = largePrime2;
+	rel.seed = oldSeed;
+	for (index = 0; index < squareRootSize; index++) {
+		rel.sqrtValue[index] = biT[index];
+	}
+	int head[3] = { largePrime1, largePrime2, (int)oldSeed };
+	WriteCheckpoint('D', head, 3, rel.sqrtValue, squareRootSize);
+	if (AddEdgeDLP(rel, biT, biR, biU, biV, numLen)) {
+		partialsFound++;
+		ShowSIQSStatus();
+	}
+}
+
+static void SieveLocationHit(int rowMatrixB[], int rowMatrixBbeforeMerge[],
+	int index2,
+	PrimeSieveData *primeSieveData,
+	int rowPartials[],
+	int rowSquares[], int biDividend[],
+	int numLen, int biT[], int *biLinearCoeff,
+	int biR[], int biU[], int biV[],
+	int indexFactorsA[], const bool oddPolynomial,
+	const int resievedPrimes[], int nbrResieved)
+{
+	unsigned char positive;
+	int NumberLengthDivid;
+	int index;
+	long long Divid;
+	int nbrColumns;
+
+	trialDivisions++;
+	if (trialDivisions == 496)
+	{
+		trialDivisions = 496;
+	}
+	// To factor: (Ax+B)^2-N
+	CandidateValue(biLinearCoeff, index2 - SieveLimit, oddPolynomial, numLen,
+		biT, biDividend);
+	/* factor biDividend */
+
+	NumberLengthDivid = numLen; /* Number length for dividend */
+	positive = true;
+	if ((uint32_t)biDividend[NumberLengthDivid - 1] >= (uint32_t)LIMB_RANGE)
+	{ /* Negative */
+		positive = false;
+		ChSignBigNbr(biDividend, NumberLengthDivid); // Convert to positive
+	}
+	rowSquares[0] = 1;
+	for (index = 0; index < nbrFactorsA; index++)
+	{
+		DivBigNbrByInt(biDividend, afact[index], biDividend,
+			NumberLengthDivid);
+		if (biDividend[NumberLengthDivid - 1] == 0)
+		{
+			NumberLengthDivid--;
+		}
+	}
+	nbrColumns = 1;
+	if (!positive)
+	{                                  // Insert -1 as a factor.
+		rowMatrixBbeforeMerge[nbrColumns++] = 0;
+	}
+	rowMatrixBbeforeMerge[0] = nbrColumns;
+	Divid = PerformTrialDivision(primeSieveData,
+		rowMatrixBbeforeMerge,
+		index2, biDividend,
+		rowSquares, NumberLengthDivid,
+		oddPolynomial, resievedPrimes, nbrResieved);
+	if (Divid == 1)
+	{ // Smooth relation found.
+		SmoothRelationFound(positive, rowMatrixB,
+			rowMatrixBbeforeMerge,
+			index2,
+			rowSquares,
+			biLinearCoeff, numLen, biT, biU, biR,
+			oddPolynomial);
+	}
+	else if (doubleLargePrime)
+	{
+		if (Divid > 0 && Divid < largePrimeUpperBound)
+		{
+			DoubleLargePrimeFound(1, (int)Divid, index2, biLinearCoeff,
+				numLen, biT, biR, biU, biV, oddPolynomial);
+		}
+		else if (Divid >= dlpMinComposite)
+		{                 // Cofactor could be the product of 2 large primes.
+			long long factor = SplitCofactorDLP(Divid);
+			if (factor > 1 && factor < largePrimeUpperBound &&
+				Divid / factor < largePrimeUpperBound)
+			{
+				DoubleLargePrimeFound((int)factor, (int)(Divid / factor), index2,
+					biLinearCoeff, numLen, biT, biR, biU, biV, oddPolynomial);
+			}
+		}
+	}
+	else
+	{
+		if (Divid > 0 && Divid < largePrimeUpperBound)
+		{
+			PartialRelationFound(positive, rowMatrixB,
+				rowMatrixBbeforeMerge,
+				index2,
+				(int)Divid, rowPartials,
+				rowSquares, biLinearCoeff,
+				numLen, biT, biR, biU, biV,
+				indexFactorsA, oddPolynomial);
+		}
+	}
+	return;
+}
+
+static unsigned int getFactorsOfA(unsigned int seed, int *indexA)
+{
+	int index, index2, i, tmp;
+	for (index = 0; index < nbrFactorsA; index++)
 	{
 		do
 		{
-			seed = 1141592621 * seed + 321435;
+			seed = SEED_MULT * seed + SEED_ADD;
 			i = (int)(((double)seed * (double)span) / (double)0x100000000ll + indexMinFactorA);
 			for (index2 = 0; index2 < index; index2++)
 			{
@@ -1942,24 +2696,736 @@ static unsigned int getFactorsOfA(unsigned int seed, int *indexA)
 /* Multithread procedure:                                               */
 /*                                                                      */
 /* 1) Main thread generates factor base and other parameters.           */
-/* 2) Start M threads where the number M is specified by the user in a  */
-/*    box beneath the applet.                                           */
+/* 2) Start M threads, where M is the number of logical processors     */
+/*    (reduced if there are too few polynomials per set).               */
 /* 3) For each polynomial:                                              */
-/*    3a) Main thread generates the data for the set of 2^n polynomials.*/
+/*    3a) Last thread to finish the previous set generates the data for */
+/*        the set of 2^n polynomials.                                   */
 /*    3b) Each child thread computes a range of polynomials             */
 /*        (u*2^n/M to (u+1)*2^n/M exclusive).                           */
 /* Partial and full relation routines must be synchronized.             */
 /************************************************************************/
-void FactoringSIQSx(const Znum &zN, Znum &Factor) {
+/* Return the first lines of a relation file: the number to factor and the
+   factor base parameters. Files written with other parameters are not used. */
+static std::string RelationFileHeader(const Znum &zN, int FactorBase) {
+	char params[100];
+	sprintf(params, "P %d %d %d %d %d\n", multiplier, nbrFactorBasePrimes,
+		SieveLimit, nbrFactorsA, FactorBase);
+	return "N " + zN.str() + "\n" + params;
+}
+
+/* Name of relation file: siqsXXXXXXXX followed by suffix, truncated to fit
+   in size characters. The hex digits depend on the number to factor. */
+static void RelationFileName(char *name, size_t size, const Znum &zN, const char *suffix) {
+	snprintf(name, size, "siqs%08lx%s",
+		(unsigned long)mpz_fdiv_ui(ZT(zN), 4294967291UL), suffix);
+}
+
+/* Read relation file from offset, which must point to the start of a
+   record. Relations are added to matrix B and partial relations to the
+   table of partials or, if toGraph is true, to the large prime graph where
+   partials with the same large prime found by different processes are
+   combined. Returns offset of the first line not read (the last line could
+   be incomplete if another process is writing it). */
+static long ReadRelations(FILE *file, long offset, bool toGraph) {
+	char line[4096];
+	char *ptr, *end;
+	int values[MAX_FACTORS_RELATION + MAX_LIMBS_SIQS];
+	int biT[MAX_LIMBS_SIQS] = { 0 };
+	int biR[MAX_LIMBS_SIQS] = { 0 };
+	int biU[MAX_LIMBS_SIQS] = { 0 };
+	int biV[MAX_LIMBS_SIQS] = { 0 };
+	int nbrValues, slot;
+	int squareRootSize = NumberLength / 2 + 1;
+	int *rowPartial;
+	PartialRelationDLP rel;
+
+	fseek(file, offset, SEEK_SET);
+	while (fgets(line, sizeof(line), file) != NULL) {
+		if (strchr(line, '\n') == NULL) {
+			break;             // line not complete yet.
+		}
+		offset = ftell(file);
+		nbrValues = 0;
+		for (ptr = line + 1; nbrValues < (int)(sizeof(values) / sizeof(values[0])); ptr = end) {
+			long value = strtol(ptr, &end, 10);
+			if (end == ptr) {
+				break;
+			}
+			values[nbrValues++] = (int)value;
+		}
+		if (strcmp(ptr, " .\n") != 0) {
+			continue;          // record truncated when the process died.
+		}
+		switch (line[0]) {
+		case 'R':
+			if (values[0] < 2 || values[0] > MAX_FACTORS_RELATION ||
+				nbrValues != values[0] + NumberLength ||
+				congruencesFound >= matrixBLength || RelationInMatrix(values)) {
+				break;        // relation could also be obtained from a cycle above
+			}
+			memcpy(matrixB[congruencesFound], values, values[0] * sizeof(int));
+			memcpy(vectLeftHandSide[congruencesFound], &values[values[0]],
+				NumberLength * sizeof(int));
+			congruencesFound++;
+			smoothsFound++;
+			break;
+		case 'L':
+			if (nbrValues != 2 + squareRootSize) {
+				break;
+			}
+			if (toGraph) {
+				rel.largePrime1 = 1;
+				rel.largePrime2 = abs(values[0]);
+				rel.seed = (unsigned int)values[1];
+				memcpy(rel.sqrtValue, &values[2], squareRootSize * sizeof(int));
+				totalPartials++;
+				if (AddEdgeDLP(rel, biT, biR, biU, biV, NumberLength)) {
+					partialsFound++;
+				}
+				break;
+			}
+			if (FindPartial(abs(values[0]), slot) >= 0) {
+				break;        // another partial with the same large prime
+			}
+			rowPartial = AddPartial(slot, values[0]);
+			memcpy(&rowPartial[1], &values[2], squareRootSize * sizeof(int));
+			rowPartial[squareRootSize + 1] = values[1];
+			totalPartials++;
+			break;
+		case 'D':
+			if (nbrValues != 3 + squareRootSize) {
+				break;
+			}
+			rel.largePrime1 = values[0];
+			rel.largePrime2 = values[1];
+			rel.seed = (unsigned int)values[2];
+			memcpy(rel.sqrtValue, &values[3], squareRootSize * sizeof(int));
+			totalPartials++;
+			if (AddEdgeDLP(rel, biT, biR, biU, biV, NumberLength)) {
+				partialsFound++;
+			}
+			break;
+		case 'S':
+			if (nbrValues == 1 && !toGraph) {
+				newSeed = (unsigned int)values[0];
+			}
+			break;
+		}
+	}
+	return offset;
+}
+
+/* append record to checkpoint file. Must be called with matrixBMutex locked. */
+static void WriteCheckpoint(char type, const int *head, int headLen,
+	const int *values, int count) {
+	int index;
+	if (checkpointFile == NULL) {
+		return;
+	}
+	fprintf(checkpointFile, "%c", type);
+	for (index = 0; index < headLen; index++) {
+		fprintf(checkpointFile, " %d", head[index]);
+	}
+	for (index = 0; index < count; index++) {
+		fprintf(checkpointFile, " %d", values[index]);
+	}
+	fprintf(checkpointFile, " .\n");
+	if (type == 'R' || type == 'S') {
+		fflush(checkpointFile);
+	}
+}
+
+/* Load the relations saved by a previous run on the same number, then open
+   the checkpoint file to append new records. If the file was written with
+   different parameters it is started again. */
+static void OpenCheckpoint(const Znum &zN, int FactorBase) {
+	char line[4096];
+	std::string header = RelationFileHeader(zN, FactorBase);
+	std::string fileHeader;
+	bool valid = false;
+	FILE *file;
+
+	if (siqsFarmSize > 0) {    // each process of a sieve farm has a spool file
+		char suffix[16];
+		snprintf(suffix, sizeof(suffix), "_%d.rel", siqsFarmIndex);
+		RelationFileName(checkpointName, sizeof(checkpointName), zN, suffix);
+	}
+	else {
+		RelationFileName(checkpointName, sizeof(checkpointName), zN, ".rel");
+	}
+	file = fopen(checkpointName, "r");
+	if (file != NULL) {
+		for (int i = 0; i < 2 && fgets(line, sizeof(line), file) != NULL; i++) {
+			fileHeader += line;
+		}
+		if (fileHeader == header) {
+			valid = true;
+			ReadRelations(file, ftell(file), false);
+		}
+		fclose(file);
+	}
+	if (valid) {
+		if (lang == 0) {
+			printf("SIQS resumed from %s: %d relations, %ld partial relations\n",
+				checkpointName, (int)congruencesFound, totalPartials);
+		}
+		else {
+			printf("SIQS reanudado desde %s: %d relaciones, %ld relaciones parciales\n",
+				checkpointName, (int)congruencesFound, totalPartials);
+		}
+		checkpointFile = fopen(checkpointName, "a");
+		if (checkpointFile != NULL) {
+			fprintf(checkpointFile, "\n");   // end any truncated record
+		}
+	}
+	else {
+		checkpointFile = fopen(checkpointName, "w");
+		if (checkpointFile != NULL) {
+			fprintf(checkpointFile, "%s", header.c_str());
+		}
+	}
+	if (checkpointFile == NULL) {
+		fprintf(stderr, "** cannot open SIQS checkpoint file %s\n", checkpointName);
+	}
+	else {
+		fflush(checkpointFile);
+	}
+}
+
+/* Sieve farm: when the merge process has enough relations it creates
+   siqsXXXXXXXX.done with the number to factor, so the sieving processes
+   stop, and after the linear algebra phase it adds the factor found.
+   A sieving process that finds the factor by itself writes both lines.
+   A done file left by an earlier run on the same number is ignored. */
+static enum eFarmState ReadFarmState(Znum &Factor) {
+	char line[4096];
+	enum eFarmState state = FARM_SIEVING;
+	struct stat info;
+	if (stat(farmDoneName, &info) != 0 || info.st_mtime < farmStartTime) {
+		return FARM_SIEVING;
+	}
+	FILE *file = fopen(farmDoneName, "r");
+	if (file == NULL) {
+		return FARM_SIEVING;
+	}
+	if (fgets(line, sizeof(line), file) != NULL && farmNumber == line) {
+		state = FARM_STOP;
+		if (fgets(line, sizeof(line), file) != NULL && line[0] == 'F' &&
+			strchr(line, '\n') != NULL) {
+			line[strcspn(line, "\n")] = 0;
+			Factor = Znum(line + 2);
+			state = FARM_FACTOR;
+		}
+	}
+	fclose(file);
+	return state;
+}
+
+/* Factor = NULL: tell sieving processes to stop */
+static void WriteFarmState(const Znum *Factor) {
+	FILE *file = fopen(farmDoneName, "w");
+	if (file != NULL) {
+		if (Factor == NULL) {
+			fprintf(file, "%s", farmNumber.c_str());
+		}
+		else {
+			fprintf(file, "%sF %s\n", farmNumber.c_str(), Factor->str().c_str());
+		}
+		fclose(file);
+	}
+}
+
+/* Sieve farm: wait until the process that performs the linear algebra
+   writes the factor. Returns false if it did not do so in FARM_WAIT_SECONDS,
+   for instance because it was stopped. */
+static bool WaitFarmFactor(Znum &Factor) {
+	auto start = std::chrono::steady_clock::now();
+	while (ReadFarmState(Factor) != FARM_FACTOR) {
+		if (std::chrono::steady_clock::now() - start >= std::chrono::seconds(FARM_WAIT_SECONDS)) {
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::seconds(FARM_POLL_SECONDS));
+	}
+	return true;
+}
+
+/* Sieve farm: tell the process that wrote the factor that this process has
+   read it, by adding a line to the done file */
+static void AckFarmFactor(void) {
+	FILE *file = fopen(farmDoneName, "r+");   // do not create it again
+	if (file != NULL) {
+		fseek(file, 0, SEEK_END);
+		fprintf(file, "A %d\n", siqsFarmIndex);
+		fclose(file);
+	}
+}
+
+/* Sieve farm: the process that wrote the factor waits until the other
+   processes have read it (or FARM_ACK_SECONDS), then removes the done file
+   and the spool files so that a later run on the same number starts again. */
+static void RemoveFarmFiles(const Znum &zN) {
+	char name[40], suffix[16], line[4096];
+	auto start = std::chrono::steady_clock::now();
+	for (;;) {
+		int acks = 0;
+		FILE *file = fopen(farmDoneName, "r");
+		if (file != NULL) {
+			while (fgets(line, sizeof(line), file) != NULL) {
+				if (line[0] == 'A') {
+					acks++;
+				}
+			}
+			fclose(file);
+		}
+		if (acks >= siqsFarmSize ||
+			std::chrono::steady_clock::now() - start >= std::chrono::seconds(FARM_ACK_SECONDS)) {
+			break;
+		}
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+	}
+	remove(farmDoneName);
+	for (int index = 1; index <= siqsFarmSize; index++) {
+		snprintf(suffix, sizeof(suffix), "_%d.rel", index);
+		RelationFileName(name, sizeof(name), zN, suffix);
+		remove(name);
+	}
+}
+
+/* Sieve farm: the merge process reads the spool files written by the
+   sieving processes 1 to siqsFarmSize as they grow, until there are enough
+   relations for the linear algebra phase. */
+static void MergeSpoolFiles(const Znum &zN, int FactorBase) {
+	char name[40], suffix[16], line[4096];
+	std::string header = RelationFileHeader(zN, FactorBase);
+	std::vector<long> offset(siqsFarmSize + 1, 0);
+	FILE *file;
+	int index, lastCongruences = -1;
+
+	for (;;) {
+		for (index = 1; index <= siqsFarmSize; index++) {
+			snprintf(suffix, sizeof(suffix), "_%d.rel", index);
+			RelationFileName(name, sizeof(name), zN, suffix);
+			file = fopen(name, "r");
+			if (file == NULL) {
+				continue;          // process not started yet.
+			}
+			if (offset[index] == 0) {
+				std::string fileHeader;
+				for (int i = 0; i < 2 && fgets(line, sizeof(line), file) != NULL; i++) {
+					fileHeader += line;
+				}
+				if (fileHeader == header) {
+					offset[index] = ftell(file);
+				}
+			}
+			if (offset[index] > 0) {
+				offset[index] = ReadRelations(file, offset[index], true);
+			}
+			fclose(file);
+		}
+		if (congruencesFound >= matrixBLength) {
+			WriteFarmState(NULL);     // sieving processes can stop
+			break;
+		}
+		if (ReadFarmState(farmFactor) == FARM_FACTOR) {
+			farmStopped = true;       // a sieving process found the factor
+			congruencesFound = matrixBLength;
+			return;
+		}
+		if (congruencesFound != lastCongruences) {
+			lastCongruences = congruencesFound;
+			if (lang == 0) {
+				printf("%d of %d congruences found in spool files\n",
+					(int)congruencesFound, matrixBLength);
+			}
+			else {
+				printf("%d de %d congruencias halladas en archivos de cola\n",
+					(int)congruencesFound, matrixBLength);
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::seconds(FARM_POLL_SECONDS));
+	}
+}
+
+/* Sieve farm: a sieving process that did not get the factor reads all the
+   spool files as the merge process does. Its own relations are read again
+   from its spool file, so the ones found by sieving are dropped first. */
+static void LocalFarmMerge(const Znum &zN, int FactorBase) {
+	if (lang == 0) {
+		printf("No factor from the merge process after %d seconds: merging spool files\n",
+			FARM_WAIT_SECONDS);
+	}
+	else {
+		printf("Sin factor del proceso de combinacin tras %d segundos: combinando archivos de cola\n",
+			FARM_WAIT_SECONDS);
+	}
+	if (checkpointFile != NULL) {
+		fclose(checkpointFile);     // the spool file is only read from now on
+		checkpointFile = NULL;
+	}
+	congruencesFound = 0;
+	InitPartialHash(NumberLength);
+	partialsDLP.clear();
+	vertexDLP.clear();
+	parentDLP.clear();
+	treeDLP.clear();
+	cyclesDLP = 0;
+	farmStopped = false;
+	MergeSpoolFiles(zN, FactorBase);
+}
+
+/* Advance the seed used by getFactorsOfA by the given number of steps,
+   so that every process of a sieve farm uses different values of A. */
+static unsigned int SkipSeeds(unsigned int seed, unsigned int steps) {
+	unsigned int mult = SEED_MULT;
+	unsigned int add = SEED_ADD;
+	for (; steps != 0; steps >>= 1) {
+		if (steps & 1) {
+			seed = mult * seed + add;
+		}
+		add = (mult + 1) * add;     // compose the step with itself
+		mult *= mult;
+	}
+	return seed;
+}
+
+/* read table of parameters written by SIQSTune. Lines starting with # are
+   comments; other lines have: digits, primes in factor base, sieve limit,
+   large prime multiplier, threshold adjustment. */
+static void ReadParamTable(void) {
+	char line[200];
+	SiqsParams entry;
+	FILE *file;
+	int lineNbr = 0;
+
+	paramTableRead = true;
+	paramTable.clear();
+	file = fopen(PARAM_FILE, "r");
+	if (file == NULL) {
+		return;              // use formulas
+	}
+	while (fgets(line, sizeof(line), file) != NULL) {
+		lineNbr++;
+		if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+			continue;
+		}
+		if (sscanf(line, "%d %d %d %d %d", &entry.digits,
+			&entry.nbrPrimes, &entry.sieveLimit, &entry.largePrimeMult,
+			&entry.thresholdAdj) == 5 && entry.digits >= 1 && entry.digits <= 300 &&
+			entry.nbrPrimes > 50 && entry.nbrPrimes <= 1000000 &&
+			entry.sieveLimit >= 1000 && entry.sieveLimit <= MAX_SIEVE_LIMIT &&
+			entry.largePrimeMult >= 1 && entry.largePrimeMult <= 1000 &&
+			entry.thresholdAdj >= -20 && entry.thresholdAdj <= 20) {
+			paramTable.push_back(entry);
+		}
+		else {
+			fprintf(stderr, "** %s line %d ignored: %s", PARAM_FILE, lineNbr, line);
+		}
+	}
+	fclose(file);
+	if (lang == 0) {
+		printf("SIQS parameters read from %s: %d sizes\n", PARAM_FILE, (int)paramTable.size());
+	}
+	else {
+		printf("Parmetros de SIQS ledos de %s: %d tamaos\n", PARAM_FILE, (int)paramTable.size());
+	}
+	std::sort(paramTable.begin(), paramTable.end(),
+		[](const SiqsParams &a, const SiqsParams &b) { return a.digits < b.digits; });
+}
+
+/* get parameters for number whose natural logarithm is logN. Between two
+   sizes in the table the factor base size and sieve limit are interpolated. */
+static void GetSiqsParams(double logN, SiqsParams &params) {
+	double digits = logN / log(10.0);
+	params.digits = (int)digits;
+	params.nbrPrimes = (int)exp(sqrt(logN * log(logN)) * 0.318);
+	params.sieveLimit = (int)exp(8.5 + 0.015 * logN);
+	params.largePrimeMult = 100;
+	params.thresholdAdj = 0;
+	if (tuneParams != NULL) {
+		params = *tuneParams;
+		return;
+	}
+	if (!paramTableRead) {
+		ReadParamTable();
+	}
+	if (paramTable.empty() || digits < paramTable.front().digits ||
+		digits > paramTable.back().digits) {
+		return;              // outside table: use formulas
+	}
+	size_t i;
+	for (i = 0; paramTable[i].digits < digits; i++);
+	const SiqsParams &upper = paramTable[i];
+	const SiqsParams &lower = paramTable[i > 0 ? i - 1 : 0];
+	double ratio = (upper.digits == lower.digits) ? 1 :
+		(digits - lower.digits) / (upper.digits - lower.digits);
+	params.nbrPrimes = (int)(lower.nbrPrimes + ratio * (upper.nbrPrimes - lower.nbrPrimes));
+	params.sieveLimit = (int)(lower.sieveLimit + ratio * (upper.sieveLimit - lower.sieveLimit));
+	params.largePrimeMult = (ratio < 0.5) ? lower.largePrimeMult : upper.largePrimeMult;
+	params.thresholdAdj = (ratio < 0.5) ? lower.thresholdAdj : upper.thresholdAdj;
+}
+
+/* odd primes up to limit (sieve of Eratosthenes) */
+static void OddPrimesUpTo(int limit, std::vector<int> &primes) {
+	std::vector<char> composite(limit / 2 + 1, 0);   // composite[i]: 2i+1
+
+	primes.clear();
+	for (int i = 1; 2 * i + 1 <= limit; i++) {
+		if (composite[i] == 0) {
+			int p = 2 * i + 1;
+			primes.push_back(p);
+			for (long long k = (long long)p * p / 2; 2 * k + 1 <= limit; k += p) {
+				composite[k] = 1;
+			}
+		}
+	}
+}
+
+/* residues[i] = number mod primes[i] for first <= i < last. All primes are
+   reduced together one limb at a time, so the inner loop has no dependency
+   between iterations. The quotient is estimated in double precision: it is
+   less than 2^31 so the estimate is wrong by 1 at most. */
+static void RemaindersByPrimes(const int *number, int numLen, const int *primes,
+	int *residues, int first, int last) {
+	std::vector<double> inverse(last - first);
+	int i;
+
+	for (i = first; i < last; i++) {
+		inverse[i - first] = 1.0 / (double)primes[i];
+		residues[i] = 0;
+	}
+	for (int index = numLen - 1; index >= 0; index--) {
+		uint64_t limb = (uint32_t)number[index];
+		for (i = first; i < last; i++) {
+			uint64_t x = ((uint64_t)residues[i] << BITS_PER_INT_GROUP) + limb;
+			uint64_t q = (uint64_t)((double)x * inverse[i - first]);
+			int64_t rem = (int64_t)(x - q * (uint64_t)primes[i]);
+			if (rem < 0) {
+				rem += primes[i];
+			}
+			else if (rem >= primes[i]) {
+				rem -= primes[i];
+			}
+			residues[i] = (int)rem;
+		}
+	}
+}
+
+/* arithmetic mod an odd prime p < 2^31 using Montgomery multiplication
+   (R = 2^32), which needs no division */
+typedef struct {
+	uint32_t p;
+	uint32_t pinv;       // -1/p mod 2^32
+	uint32_t r2;         // R^2 mod p
+} MontPrime;
+
+static void MontInit(MontPrime &m, uint32_t p) {
+	uint32_t inv = p;    // correct to 3 bits, each step doubles them
+	for (int step = 0; step < 4; step++) {
+		inv *= 2 - p * inv;
+	}
+	m.p = p;
+	m.pinv = 0 - inv;
+	m.r2 = (uint32_t)((uint64_t)(0x100000000ULL % p) * (0x100000000ULL % p) % p);
+}
+
+static inline uint32_t MontMul(uint32_t a, uint32_t b, const MontPrime &m) {
+	uint64_t t = (uint64_t)a * b;
+	uint32_t q = (uint32_t)t * m.pinv;
+	uint32_t u = (uint32_t)((t + (uint64_t)q * m.p) >> 32);
+	return (u >= m.p ? u - m.p : u);
+}
+
+/* base^expon mod p, base and result in normal form */
+static int MontPowMod(int base, int expon, const MontPrime &m) {
+	uint32_t power = MontMul(1, m.r2, m);         // 1 in Montgomery form
+	uint32_t square = MontMul((uint32_t)base, m.r2, m);
+	while (expon != 0) {
+		if ((expon & 1) != 0) {
+			power = MontMul(power, square, m);
+		}
+		square = MontMul(square, square, m);
+		expon >>= 1;
+	}
+	return (int)MontMul(power, 1, m);
+}
+
+static inline int MulModPrime(int a, int b, int p) {
+	return (int)((uint64_t)a * (uint64_t)b % (uint32_t)p);
+}
+
+/* square root of NbrMod mod prime, which must be a quadratic residue */
+static int SqrtModPrime(int NbrMod, const MontPrime &m) {
+	int currentPrime = (int)m.p;
+	int SqrRootMod, Power2, Q, E, D, V, W, X, Y, Z, T1;
+
+	if ((currentPrime & 3) == 3) {
+		SqrRootMod = MontPowMod(NbrMod, (currentPrime + 1) / 4, m);
+	}
+	else if ((currentPrime & 7) == 5) {   // currentPrime = 5 (mod 8)
+		SqrRootMod = MontPowMod(MulModPrime(NbrMod, 2, currentPrime),
+			(currentPrime - 5) / 8, m);
+		D = MulModPrime(2 * NbrMod % currentPrime, SqrRootMod, currentPrime);
+		D = MulModPrime(D, SqrRootMod, currentPrime) - 1;
+		if (D < 0) {
+			D += currentPrime;
+		}
+		D = MulModPrime(D, NbrMod, currentPrime);
+		SqrRootMod = MulModPrime(D, SqrRootMod, currentPrime);
+	}
+	else {      // Tonelli-Shanks
+		Q = currentPrime - 1;
+		E = 0;
+		Power2 = 1;
+
+		do {
+			E++;
+			Q /= 2;
+			Power2 *= 2;
+		} while ((Q & 1) == 0); /* E >= 3 */
+
+		Power2 /= 2;
+		X = 1;
+
+		do {
+			X++;
+			Z = MontPowMod(X, Q, m);
+		} while (MontPowMod(Z, Power2, m) == 1);
+
+		Y = Z;
+		X = MontPowMod(NbrMod, (Q - 1) / 2, m);
+		V = MulModPrime(NbrMod, X, currentPrime);
+		W = MulModPrime(V, X, currentPrime);
+
+		while (W != 1) {
+			T1 = 0;
+			D = W;
+			while (D != 1) {
+				D = MulModPrime(D, D, currentPrime);
+				T1++;
+			}
+			D = MontPowMod(Y, 1 << (E - T1 - 1), m);
+			Y = MulModPrime(D, D, currentPrime);
+			E = T1;
+			V = MulModPrime(V, D, currentPrime);
+			W = MulModPrime(W, Y, currentPrime);
+		} /* end while */
+		SqrRootMod = V;
+	} /* end if */
+	return SqrRootMod;
+}
+
+/* call func(first, last) for parts of the range 0 to n-1, one per thread.
+   The threads are started here and joined before returning. */
+template <typename F>
+static void SpawnRange(int n, int nbrThreads, F func) {
+	std::vector<std::thread> threads;
+	for (int t = 1; t < nbrThreads; t++) {
+		threads.emplace_back(func, (int)((long long)n * t / nbrThreads),
+			(int)((long long)n * (t + 1) / nbrThreads));
+	}
+	func(0, n / nbrThreads);
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
+/* compute kN mod p for all the candidate primes and a square root of it for
+   those that are quadratic residues (roots[i] = -1 for the others). The 
+   primes are split among threads. */
+static void FactorBaseRoots(const std::vector<int> &primes, std::vector<int> &roots) {
+	int nbrThreads = (int)std::thread::hardware_concurrency();
+	int count = (int)primes.size();
+
+	roots.resize(count);
+	if (nbrThreads < 1 || count < FB_MT_MIN) {
+		nbrThreads = 1;
+	}
+	SpawnRange(count, nbrThreads, [&](int first, int last) {
+		RemaindersByPrimes(biModulus, NumberLength, primes.data(), roots.data(),
+			first, last);
+		for (int i = first; i < last; i++) {
+			MontPrime m;
+			int p = primes[i];
+			int NbrMod = roots[i];
+			MontInit(m, (uint32_t)p);
+			roots[i] = -1;           // not in factor base
+			if (p == multiplier || NbrMod == 0) {
+				continue;
+			}
+			/* Tonelli-Shanks needs a quadratic residue. For the other primes
+			   it is cheaper to check the square root found. */
+			if ((p & 7) == 1 && MontPowMod(NbrMod, (p - 1) / 2, m) != 1) {
+				continue;
+			}
+			int root = SqrtModPrime(NbrMod, m);
+			if (MulModPrime(root, root, p) == NbrMod) {
+				roots[i] = root;
+			}
+		}
+	});
+}
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/* append a line to the metrics file. phase is the phase in progress, or the
+   one that has just ended if phaseEnd is set. */
+static void WriteMetrics(int phase, bool phaseEnd) {
+	double seconds[NBR_PHASES];
+	double sieveTime;
+	long polynomials = polynomialsSieved;
+	long divisions = trialDivisions;
+
+	metricsLastWrite = SecondsSince(siqsStart);
+	if (metricsFile == NULL) {
+		return;
+	}
+	memcpy(seconds, phaseSeconds, sizeof(seconds));
+	if (!phaseEnd) {
+		seconds[phase] += SecondsSince(phaseStart);
+	}
+	sieveTime = (seconds[PHASE_SIEVE] > 0 ? seconds[PHASE_SIEVE] : 1e-3);
+	fprintf(metricsFile, "{\"digits\":%d,\"event\":\"%s\",\"phase\":\"%s\",\"elapsed\":%.3f,",
+		metricsDigits, phaseEnd ? "end" : "progress", phaseNames[phase], metricsLastWrite);
+	fprintf(metricsFile, "\"relations\":%d,\"relations_needed\":%d,\"full\":%ld,"
+		"\"from_partials\":%ld,\"partials\":%ld,",
+		(int)congruencesFound, metricsNeeded, smoothsFound, partialsFound, totalPartials);
+	fprintf(metricsFile, "\"polynomials\":%ld,\"trial_divisions\":%ld,"
+		"\"candidates_per_poly\":%.3f,",
+		polynomials, divisions, polynomials > 0 ? (double)divisions / polynomials : 0.0);
+	fprintf(metricsFile, "\"full_per_s\":%.2f,\"partials_per_s\":%.2f,\"combined_per_s\":%.2f,"
+		"\"relations_per_s\":%.2f",
+		smoothsFound / sieveTime, totalPartials / sieveTime, partialsFound / sieveTime,
+		congruencesFound / sieveTime);
+	for (int index = 0; index < NBR_PHASES; index++) {
+		fprintf(metricsFile, ",\"%s_s\":%.3f", phaseNames[index], seconds[index]);
+	}
+	fprintf(metricsFile, "}\n");
+	fflush(metricsFile);
+}
+
+/* record the time used by a phase and start the next one */
+static void EndPhase(int phase) {
+	phaseSeconds[phase] += SecondsSince(phaseStart);
+	phaseStart = std::chrono::steady_clock::now();
+	WriteMetrics(phase, true);
+}
+
+/* factor zN. A nontrivial factor is returned in Factor. If factorList is not 
+   NULL it receives all the factors found using every dependency; their 
+   product is zN but they are not necessarily prime. */
+void FactoringSIQSx(const Znum &zN, Znum &Factor, std::vector<Znum> *factorList) {
 	int origNumberLength;
 	int FactorBase;
 	int currentPrime;
 	int NbrMod;
 	//BigInteger TempResult;
-	PrimeSieveData *rowPrimeSieveData;  // elements value and modsqrt are modified
 	PrimeTrialDivisionData *rowPrimeTrialDivisionData;  // elements value and exp are modified
-	int Power2, SqrRootMod, fact;
-	int D, E, Q, V, W, X, Y, Z, T1, V1, W1, Y1;
+	int fact;
+	int D, E;
 	double Temp, Prod;
 	double bestadjust;
 	int i, j;
@@ -1967,6 +3433,7 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 		47, 53, 59, 61, 67, 71, 73, 79, 83, 89, 97 };  // 1st 26 primes
 	double adjustment[sizeof(arrmult) / sizeof(arrmult[0])];
 	double dNumberToFactor, dlogNumberToFactor;
+	SiqsParams params;
 
 	first = true;
 	if (!GetConsoleScreenBufferInfo(hConsole, &csbi))
@@ -1990,19 +3457,37 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 	polynomialsSieved = 0;
 	nbrPartials = 0;
 	newSeed = 0;
+	siqsStart = phaseStart = std::chrono::steady_clock::now();
+	memset(phaseSeconds, 0, sizeof(phaseSeconds));
+	metricsLastWrite = 0;
+	metricsDigits = (int)zN.str().size();
+	if (!siqsMetricsName.empty()) {
+		metricsFile = fopen(siqsMetricsName.c_str(), "a");
+		if (metricsFile == NULL) {
+			fprintf(stderr, "** cannot open SIQS metrics file %s\n", siqsMetricsName.c_str());
+		}
+	}
 
 	//  threadArray = new Thread[numberThreads];
 	//Temp = logBigNbr(NbrToFactor);
 	Temp = logBigNbr(zN);
-	nbrFactorBasePrimes = (int)exp(sqrt(Temp * log(Temp)) * 0.318);
-	SieveLimit = (int)exp(8.5 + 0.015 * Temp) & 0xFFFFFFF8;
+	GetSiqsParams(Temp, params);
+	nbrFactorBasePrimes = params.nbrPrimes;
+	SieveLimit = params.sieveLimit & 0xFFFFFFF8;
 	if (SieveLimit > MAX_SIEVE_LIMIT)
 	{
 		SieveLimit = MAX_SIEVE_LIMIT;
 	}
 	nbrFactorsA = (int)(Temp*0.051 + 1);
+	if (nbrFactorsA > MAX_NBR_FACTORS) {
+		nbrFactorsA = MAX_NBR_FACTORS;
+	}
 	NbrPolynomials = (1 << (nbrFactorsA - 1)) - 1;
 
+	/* allocate the tables that depend on the size of the factor base */
+	siqsArena.assign((SetSiqsTables(NULL, nbrFactorBasePrimes) + 7) / 8, 0);
+	SetSiqsTables((char *)siqsArena.data(), nbrFactorBasePrimes);
+
 	//factorSiqs = NbrToFactor;  
 	//NumberLength = BigIntToBigNbr(factorSiqs, biModulus);
 	NumberLength = ZtoBigNbr(biModulus, zN);  // Modulus = N
@@ -2011,7 +3496,7 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 	biModulus[NumberLength] = 0;
 	// TestNbr2 = Modulus = N
 	memcpy(biTestNbr2, biModulus, (NumberLength + 1) * sizeof(int));
-	memset(matrixPartialHashIndex, 0xFF, sizeof(matrixPartialHashIndex));
+	InitPartialHash(NumberLength);
 #ifdef __EMSCRIPTEN__
 	InitSIQSStrings(SieveLimit);
 	startSieveTenths = (int)(tenths() - originalTenthSecond);
@@ -2022,11 +3507,10 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 
 	/* search for best Knuth-Schroeppel multiplier */
 	bestadjust = -10.0e0;
-	primeSieveData[0].value = 1;
+	primeSieveData->value[0] = 1;
 	primeTrialDivisionData[0].value = 1;
-	rowPrimeSieveData = &primeSieveData[1];
 	rowPrimeTrialDivisionData = &primeTrialDivisionData[1];
-	rowPrimeSieveData->value = 2;
+	primeSieveData->value[1] = 2;
 	rowPrimeTrialDivisionData->value = 2;
 	// (2^31)^(j+1) mod 2
 	rowPrimeTrialDivisionData->exp[0] = rowPrimeTrialDivisionData->exp[1] =
@@ -2044,39 +3528,41 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 		adjustment[j] -= log((double)arrmult[j]) / (2.0e0);
 	}
 
-	/* set up adjustment array*/
-	currentPrime = 3;
-	while (currentPrime < 10000) {
-		int halfCurrentPrime;
-
-		/* NbrMod = Modulus % currentPrime */
-		NbrMod = (int)RemDivBigNbrByInt(biModulus, currentPrime, NumberLength);
-		halfCurrentPrime = (currentPrime - 1) / 2;
-		/* jacobi = NbrMod ^ HalfCurrentPrime % currentPrime */
-		int jacobi = intDoubleModPow(NbrMod, halfCurrentPrime, currentPrime);
-		double dp = (double)currentPrime;
-		double logp = log(dp) / dp;
-
-		for (j = 0; j<sizeof(arrmult) / sizeof(arrmult[0]); j++) {
-			if (arrmult[j] == currentPrime) {
-				adjustment[j] += logp;
-			}
-			else if (jacobi * intDoubleModPow(arrmult[j], halfCurrentPrime,
-				currentPrime) % currentPrime == 1) 	{
-				adjustment[j] += 2 * logp;
-			}
-		}
+	/* candidate primes for the factor base. About half of them are quadratic
+	   residues mod kN. */
+	std::vector<int> fbPrimes, fbRoots;
+	int primeLimit = (int)(2.2 * nbrFactorBasePrimes * log(2.2 * nbrFactorBasePrimes + 3)) + 12000;
+	OddPrimesUpTo(primeLimit, fbPrimes);
 
-		do {
-			currentPrime += 2;
-			for (Q = 3; Q * Q <= currentPrime; Q += 2) { /* Check if currentPrime is prime */
-				if (currentPrime % Q == 0) {
-					break;  /* Composite */
+	/* set up adjustment array*/
+	{
+		int nbrSmall = (int)(std::lower_bound(fbPrimes.begin(), fbPrimes.end(), 10000) -
+			fbPrimes.begin());
+		std::vector<int> residues(nbrSmall);
+		/* residues = Modulus % primes below 10000 */
+		RemaindersByPrimes(biModulus, NumberLength, fbPrimes.data(), residues.data(), 0, nbrSmall);
+		for (i = 0; i < nbrSmall; i++) {
+			int halfCurrentPrime;
+
+			currentPrime = fbPrimes[i];
+			NbrMod = residues[i];
+			halfCurrentPrime = (currentPrime - 1) / 2;
+			/* jacobi = NbrMod ^ HalfCurrentPrime % currentPrime */
+			int jacobi = intDoubleModPow(NbrMod, halfCurrentPrime, currentPrime);
+			double dp = (double)currentPrime;
+			double logp = log(dp) / dp;
+
+			for (j = 0; j < (int)(sizeof(arrmult) / sizeof(arrmult[0])); j++) {
+				if (arrmult[j] == currentPrime) {
+					adjustment[j] += logp;
+				}
+				else if (jacobi * intDoubleModPow(arrmult[j], halfCurrentPrime,
+					currentPrime) % currentPrime == 1) 	{
+					adjustment[j] += 2 * logp;
 				}
 			}
-		} while (Q * Q <= currentPrime);
-
-	}  /* end while */
+		}
+	}
 
 	multiplier = 1;
 	for (j = 0; j<sizeof(arrmult) / sizeof(arrmult[0]); j++) {
@@ -2090,7 +3576,7 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 	MultBigNbrByInt(biTestNbr2, multiplier, biModulus, NumberLength);
 	FactorBase = currentPrime;
 	matrixBLength = nbrFactorBasePrimes + 50;
-	rowPrimeSieveData->modsqrt = (ZisEven(zN)) ? 0 : 1;
+	primeSieveData->modsqrt[1] = (ZisEven(zN)) ? 0 : 1;
 
 	switch ((int)biModulus[0] & 0x07) {
 	case 1:
@@ -2105,11 +3591,10 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 	}
 
 	if (multiplier != 1 && multiplier != 2) {
-		rowPrimeSieveData = &primeSieveData[2];
 		rowPrimeTrialDivisionData = &primeTrialDivisionData[2];
-		rowPrimeSieveData->value = multiplier;
+		primeSieveData->value[2] = multiplier;
 		rowPrimeTrialDivisionData->value = multiplier;
-		rowPrimeSieveData->modsqrt = 0;
+		primeSieveData->modsqrt[2] = 0;
 		// The following works because multiplier has less than 16 significant bits.
 		E = (int)((1U << BITS_PER_INT_GROUP) % multiplier);
 		rowPrimeTrialDivisionData->exp[0] = E;  // (2^31) mod multiplier
@@ -2129,18 +3614,30 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 		j = 2;
 	}
 
-	currentPrime = 3;
-	while (j < nbrFactorBasePrimes) { /* select small primes */
-		NbrMod = (int)RemDivBigNbrByInt(biModulus, currentPrime, NumberLength);
+	/* kN mod p and its square root for all candidates at once */
+	for (;;) {
+		int nbrResidues = (multiplier != 1 && multiplier != 2) ? 3 : 2;
+		FactorBaseRoots(fbPrimes, fbRoots);
+		for (i = 0; i + 1 < (int)fbPrimes.size(); i++) {
+			if (fbRoots[i] >= 0 && ++nbrResidues == nbrFactorBasePrimes) {
+				break;
+			}
+		}
+		if (i + 1 < (int)fbPrimes.size()) {
+			break;
+		}
+		primeLimit *= 2;           // not enough quadratic residues
+		OddPrimesUpTo(primeLimit, fbPrimes);
+	}
 
-		if (currentPrime != multiplier &&
-			intDoubleModPow(NbrMod, (currentPrime - 1) / 2, currentPrime) == 1)
+	for (i = 0; j < nbrFactorBasePrimes; i++) { /* select small primes */
+		currentPrime = fbPrimes[i];
+		if (fbRoots[i] >= 0)
 		{
-			double dBase, dPower, dCurrentPrime, dRem;
+			double dBase, dPower, dCurrentPrime;
 			/* use only if Jacobi symbol = 0 or 1 */
-			rowPrimeSieveData = &primeSieveData[j];
 			rowPrimeTrialDivisionData = &primeTrialDivisionData[j];
-			rowPrimeSieveData->value = (int)currentPrime;
+			primeSieveData->value[j] = (int)currentPrime;
 			rowPrimeTrialDivisionData->value = (int)currentPrime;
 			// The following works because multiplier has less than 26 significant bits.
 			dBase = (double)((1U << BITS_PER_INT_GROUP) % currentPrime);
@@ -2161,89 +3658,26 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 			dPower *= dBase;
 			dPower -= floor(dPower / dCurrentPrime)*dCurrentPrime;
 			rowPrimeTrialDivisionData->exp[5] = (int)dPower; // (2^31)^6 mod currentPrime
-
-			if ((currentPrime & 3) == 3) {
-				SqrRootMod = intDoubleModPow(NbrMod, (currentPrime + 1) / 4, currentPrime);
-			}
-			else if ((currentPrime & 7) == 5) {   // currentPrime = 5 (mod 8)
-				SqrRootMod =
-					intDoubleModPow(NbrMod * 2, (currentPrime - 5) / 8, currentPrime);
-				dRem = (double)2 * NbrMod * (double)SqrRootMod;
-				dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
-				dRem = dRem * (double)SqrRootMod - 1;
-				dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
-				dRem = dRem * (double)NbrMod;
-				dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
-				dRem = dRem * (double)SqrRootMod;
-				dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
-				SqrRootMod = (int)dRem;
-			}
-			else {
-				Q = currentPrime - 1;
-				E = 0;
-				Power2 = 1;
-
-				do {
-					E++;
-					Q /= 2;
-					Power2 *= 2;
-				} while ((Q & 1) == 0); /* E >= 3 */
-
-				Power2 /= 2;
-				X = 1;
-
-				do {
-					X++;
-					Z = intDoubleModPow(X, Q, currentPrime);
-				} while (intDoubleModPow(Z, Power2, currentPrime) == 1);
-
-				Y = Z;
-				X = intDoubleModPow(NbrMod, (Q - 1) / 2, currentPrime);
-				dBase = (double)NbrMod * (double)X;
-				V = (int)(dBase - floor(dBase / dCurrentPrime)*dCurrentPrime);
-				dBase = (double)V * (double)X;
-				W = (int)(dBase - floor(dBase / dCurrentPrime)*dCurrentPrime);
-
-				while (W != 1) {
-					T1 = 0;
-					D = W;
-					while (D != 1) {
-						dBase = (double)D * (double)D;
-						D = (int)(dBase - floor(dBase / dCurrentPrime)*dCurrentPrime);
-						T1++;
-					}
-					D = intDoubleModPow(Y, 1 << (E - T1 - 1), currentPrime);
-					dBase = (double)D * (double)D;
-					Y1 = (int)(dBase - floor(dBase / dCurrentPrime)*dCurrentPrime);
-					E = T1;
-					dBase = (double)V * (double)D;
-					V1 = (int)(dBase - floor(dBase / dCurrentPrime)*dCurrentPrime);
-					dBase = (double)W * (double)Y1;
-					W1 = (int)(dBase - floor(dBase / dCurrentPrime)*dCurrentPrime);
-					Y = Y1;
-					V = V1;
-					W = W1;
-				} /* end while */
-				SqrRootMod = V;
-			} /* end if */
-
-			rowPrimeSieveData->modsqrt = (int)SqrRootMod;
+			primeSieveData->modsqrt[j] = fbRoots[i];
 			j++;
-		} /* end while */
-
-		do {
-			currentPrime += 2;
-			for (Q = 3; Q * Q <= currentPrime; Q += 2) { /* Check if currentPrime is prime */
-				if (currentPrime % Q == 0) {
-					break;  /* Composite */
-				}
-			}
-		} while (Q * Q <= currentPrime);
-
+		}
 	} /* End while */
+	currentPrime = fbPrimes[i];     // prime after the last one tested
 
 	FactorBase = currentPrime;
-	largePrimeUpperBound = 100 * FactorBase;
+	largePrimeUpperBound = params.largePrimeMult * FactorBase;
+	/* The double large prime variation pays off for larger numbers */
+	doubleLargePrime = (Temp > DLP_MIN_DIGITS * log(10.0));
+	dlpMinComposite = (double)FactorBase * (double)FactorBase;
+	dlpCofactorBound = (double)largePrimeUpperBound * (double)largePrimeUpperBound;
+	if (dlpCofactorBound > 4.5e15) {
+		dlpCofactorBound = 4.5e15;   // must fit in 52 bits (see mulModDLP)
+	}
+	partialsDLP.clear();
+	vertexDLP.clear();
+	parentDLP.clear();
+	treeDLP.clear();
+	cyclesDLP = 0;
 
 	dlogNumberToFactor = logBigNbr(zN); 	// find logarithm of number to factor.
 	dNumberToFactor = exp(dlogNumberToFactor);   // convert NbrToFactor to floating point
@@ -2255,7 +3689,7 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 
 	firstLimit = 2;
 	for (j = 2; j < nbrFactorBasePrimes; j++) {
-		firstLimit *= (int)(primeSieveData[j].value);
+		firstLimit *= (int)(primeSieveData->value[j]);
 		if (firstLimit > 2 * SieveLimit) {
 			break;
 		}
@@ -2266,28 +3700,77 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 	threshold =	(unsigned char)
 		(log(sqrt(dNumberToFactor) * SieveLimit /
 					(FactorBase * 64) /
-					primeSieveData[j + 1].value
+					primeSieveData->value[j + 1]
 		     ) / log(3) + 0x81
 		);
+	if (doubleLargePrime) {
+		/* let through values with a larger cofactor */
+		threshold -= (unsigned char)(log(largePrimeUpperBound / 64.0) / log(3) * DLP_THRESHOLD_ADJ);
+	}
+	threshold += (char)params.thresholdAdj;
 	firstLimit = (int)(log(dNumberToFactor) / 3);
+	/* the unrolled loops for the primes below firstLimit start at up to X1 + p
+	   and add offsets of up to 5p, so they write past the end of the sieve
+	   array by less than 6 times the largest of these primes */
+	sieveArraySlack = 6 * primeSieveData->value[firstLimit - 1];
+	for (patternLimit = smallPrimeUpperLimit; patternLimit < firstLimit; patternLimit++) {
+		if (primeSieveData->value[patternLimit] >= SMALL_PRIME_PATTERN_LIMIT) {
+			break;
+		}
+	}
 	for (secondLimit = firstLimit; secondLimit < nbrFactorBasePrimes; secondLimit++) {
-		if (primeSieveData[secondLimit].value * 2 > SieveLimit) {
+		if (primeSieveData->value[secondLimit] * 2 > SieveLimit) {
 			break;
 		}
 	}
 
 	for (thirdLimit = secondLimit; thirdLimit < nbrFactorBasePrimes; thirdLimit++) {
-		if (primeSieveData[thirdLimit].value > 2 * SieveLimit) {
+		if (primeSieveData->value[thirdLimit] > 2 * SieveLimit) {
 			break;
 		}
 	}
 
-	nbrPrimes2 = nbrFactorBasePrimes - 4;
+	/* If the sieve array does not fit in the L2 cache, primes larger than
+	   a sieve block (the size of the L1 data cache) are sieved using 
+	   buckets. Offsets within a block must fit in 16 bits. */
+	j = getCacheSize(1);
+	for (sieveBlockBits = 11; sieveBlockBits < 15; sieveBlockBits++) {
+		if ((2 << sieveBlockBits) * (int)sizeof(short) > j) {
+			break;
+		}
+	}
+	for (bucketLimit = firstLimit; bucketLimit < nbrFactorBasePrimes; bucketLimit++) {
+		if (primeSieveData->value[bucketLimit] > (1 << sieveBlockBits)) {
+			break;
+		}
+	}
+	if (2 * SieveLimit * (int)sizeof(short) <= getCacheSize(2)) {
+		bucketLimit = nbrFactorBasePrimes;
+	}
+	if (secondLimit > bucketLimit) {
+		secondLimit = bucketLimit;
+	}
+	if (thirdLimit > bucketLimit) {
+		thirdLimit = bucketLimit;
+	}
+	nbrPrimes2 = bucketLimit - 4;
+	for (resieveFirst = firstLimit; resieveFirst < nbrFactorBasePrimes; resieveFirst++) {
+		if (primeSieveData->value[resieveFirst] > 2 * SieveLimit / RESIEVE_DIVISOR) {
+			break;
+		}
+	}
+	/* each root of a prime p hits a given block with probability
+	   blocksize/p */
+	Prod = 0;
+	for (j = bucketLimit; j < nbrFactorBasePrimes; j++) {
+		Prod += 4.0 * (1 << sieveBlockBits) / primeSieveData->value[j];
+	}
+	bucketSize = (int)(1.5 * Prod) + 8 * BUCKET_CHECK_PRIMES;
 	Prod = sqrt(2 * dNumberToFactor) / (double)SieveLimit;
 
 	fact = (int)pow(Prod, 1 / (float)nbrFactorsA);
 	for (i = 2;; i++) {
-		if (primeSieveData[i].value > fact) {
+		if (primeSieveData->value[i] > fact) {
 			break;
 		}
 	}
@@ -2300,55 +3783,109 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 	/*********************************************/
 	/* Generate sieve threads                    */
 	/*********************************************/
-	sieveThread(Factor);
-	NumberLength = origNumberLength;
-	//BigtoZ (Factor, TempResult);
-#if 0
-	for (threadNumber = 0; threadNumber<numberThreads; threadNumber++)
-	{
-		//new Thread(this).start();                // Start new thread.
-		//synchronized(amodq)
-		{
-			//      while (threadArray[threadNumber] == null &&
-			//        getTerminateThread() == false)
-			{
-				//try
-				//{
-				//  amodq.wait();
-				//}
-				//catch (InterruptedException ie) {}
-			}
+	numberThreads = (int)std::thread::hardware_concurrency();
+	// each thread should get at least 4 pairs of polynomials from each set.
+	if (numberThreads > (NbrPolynomials - 1) / 8) {
+		numberThreads = (NbrPolynomials - 1) / 8;
+	}
+	if (numberThreads < 1) {
+		numberThreads = 1;
+	}
+	firstPrimeSieveData = primeSieveData;
+	SieveScan = SelectSieveScan();
+	UpdateRoots = SelectRootUpdate();
+	AddPattern = SelectPatternAdd();
+	SelectFixedWidth(NumberLength);
+	NumberLengthSiqs = NumberLength;
+	farmStopped = false;
+	if (siqsFarmSize > 0) {
+		RelationFileName(farmDoneName, sizeof(farmDoneName), zN, ".done");
+		farmNumber = "N " + zN.str() + "\n";
+		farmStartTime = time(NULL);
+		farmLastPoll = std::chrono::steady_clock::now();
+		if (siqsFarmIndex == 0) {
+			MergeSpoolFiles(zN, FactorBase);  // wait for enough relations
+		}
+		else {      // each process gets 1/siqsFarmSize of the seeds
+			newSeed = SkipSeeds(0, (unsigned int)((siqsFarmIndex - 1) *
+				(0x100000000LL / siqsFarmSize)));
+			OpenCheckpoint(zN, FactorBase);
 		}
 	}
-	//synchronized(matrixB)
+	else if (siqsCheckpoint) {
+		OpenCheckpoint(zN, FactorBase);  // resume previous run if possible
+	}
+	metricsNeeded = matrixBLength;
+	EndPhase(PHASE_SETUP);
 	{
-		while (factorSiqs == null && getTerminateThread() == false)
-		{
-			try
-			{
-				matrixB.wait();
-			}
-			catch (InterruptedException ie) {}
+		std::vector<std::thread> threadArray;
+		for (int threadNumber = 1; threadNumber < numberThreads; threadNumber++) {
+			threadArray.emplace_back(sieveThread, threadNumber);
+		}
+		sieveThread(0);          // main thread sieves the first range
+		for (auto &t : threadArray) {
+			t.join();            // wait until all sieve threads have finished
 		}
 	}
-#endif
-	if (/*getTerminateThread() ||*/ (Factor == 0))
-	{
-		//throw new ArithmeticException();
+	EndPhase(PHASE_SIEVE);
+	sieveSeconds = phaseSeconds[PHASE_SIEVE];
+	if (partialLookups > 0) {
+		double loadFactor = (double)nbrPartials / (double)partialHash.size();
+		double probes = (double)partialProbes / (double)partialLookups;
+		if (lang == 0) {
+			printf("Partial relations: %d stored, hash table size %d, load factor %.2f, %.2f probes per lookup, longest probe %d\n",
+				nbrPartials, (int)partialHash.size(), loadFactor, probes, partialMaxProbe);
+		}
+		else {
+			printf("Relaciones parciales: %d almacenadas, tabla hash de %d, factor de carga %.2f, %.2f sondeos por bsqueda, sondeo ms largo %d\n",
+				nbrPartials, (int)partialHash.size(), loadFactor, probes, partialMaxProbe);
+		}
 	}
-#if 0
-	for (threadNumber = 0; threadNumber<numberThreads; threadNumber++)
-	{                 // Wake up all sieve threads so they can terminate.
-		if (threadArray[threadNumber].isAlive())
-		{
-			//try
-			{
-				threadArray[threadNumber].interrupt();
+
+	/* all congruences have been found; find the factor */
+	{
+		if (farmStopped && !WaitFarmFactor(Factor)) {
+			LocalFarmMerge(zN, FactorBase);   // merge process seems to have died
+			if (farmStopped) {
+				WaitFarmFactor(Factor);     // another process wrote the factor meanwhile
+			}
+		}
+		if (farmStopped) {
+			AckFarmFactor();
+		}
+		else {
+			siqsFactors.assign(1, zN);
+			while (!LinearAlgebraPhase(NumberLength));
+			std::sort(siqsFactors.begin(), siqsFactors.end());
+			Factor = siqsFactors[0];    // smallest factor found
+			if (factorList != NULL) {
+				*factorList = siqsFactors;
+			}
+			if (siqsFarmSize > 0) {
+				WriteFarmState(&Factor);
 			}
-			//catch (Exception e) {}
 		}
 	}
-#endif
+	if (checkpointFile != NULL) {
+		fclose(checkpointFile);      // job finished, relations no longer needed
+		checkpointFile = NULL;
+		remove(checkpointName);
+	}
+	if (siqsFarmSize > 0 && !farmStopped) {
+		RemoveFarmFiles(zN);         // this process wrote the factor
+	}
+	NumberLength = origNumberLength;
+	SetSiqsTables(NULL, 0);
+	std::vector<long long>().swap(siqsArena);      // free the arena
+	std::vector<std::vector<int>>().swap(filterPrimes);
+	std::vector<std::vector<int>>().swap(filterRelations);
+	std::vector<Znum>().swap(siqsFactors);
+	std::vector<int>().swap(partialRecords);
+	std::vector<int>().swap(partialHash);
+	if (metricsFile != NULL) {
+		fclose(metricsFile);
+		metricsFile = NULL;
+	}
 #if 0
 	synchronized(this)
 	{
@@ -2360,7 +3897,153 @@ void FactoringSIQSx(const Znum &zN, Znum &Factor) {
 #endif
 }
 
+/* factor N with the given parameters. Return the time used in seconds
+   (a large value if the factor is not found). */
+static double TuneTrial(const Znum &N, const SiqsParams &params, double &relsPerSecond) {
+	Znum Factor;
+	tuneParams = &params;
+	auto start = std::chrono::steady_clock::now();
+	FactoringSIQSx(N, Factor);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	tuneParams = NULL;
+	relsPerSecond = (params.nbrPrimes + 50) / (sieveSeconds > 0 ? sieveSeconds : 1e-3);
+	if (Factor <= 1 || Factor >= N || N % Factor != 0) {
+		return 1e30;        // parameters do not work
+	}
+	return seconds;
+}
+
+static void ShowTuneResult(const char *title, const SiqsParams &params,
+	double seconds, double relsPerSecond) {
+	if (lang == 0) {
+		printf("%s %d digits: %d primes, sieve limit %d, large prime mult %d, threshold %+d: %.2f s, %.0f relations/s\n",
+			title, params.digits, params.nbrPrimes, params.sieveLimit,
+			params.largePrimeMult, params.thresholdAdj, seconds, relsPerSecond);
+	}
+	else {
+		printf("%s %d dgitos: %d primos, lmite de criba %d, multiplicador primo grande %d, umbral %+d: %.2f s, %.0f relaciones/s\n",
+			title, params.digits, params.nbrPrimes, params.sieveLimit,
+			params.largePrimeMult, params.thresholdAdj, seconds, relsPerSecond);
+	}
+}
+
+/* time TUNE_RUNS factorisations of N with the given parameters and return
+   the best time, so that one slow run does not decide the result. */
+static double TuneBest(const Znum &N, const SiqsParams &params, double &relsPerSecond) {
+	double best = 1e30, rate = 0;
+
+	relsPerSecond = 0;
+	for (int run = 0; run < TUNE_RUNS; run++) {
+		double seconds = TuneTrial(N, params, rate);
+		if (seconds >= 1e30) {
+			return seconds;      // parameters do not work
+		}
+		if (seconds < best) {
+			best = seconds;
+			relsPerSecond = rate;
+		}
+	}
+	return best;
+}
+
+/* write parameter table. Entries for sizes not tuned in this run are kept. */
+static void WriteParamTable(const std::vector<SiqsParams> &tuned) {
+	std::vector<SiqsParams> table;
+	FILE *file;
+
+	ReadParamTable();
+	for (const SiqsParams &entry : paramTable) {
+		bool replaced = false;
+		for (const SiqsParams &t : tuned) {
+			replaced |= (t.digits == entry.digits);
+		}
+		if (!replaced) {
+			table.push_back(entry);
+		}
+	}
+	table.insert(table.end(), tuned.begin(), tuned.end());
+	std::sort(table.begin(), table.end(),
+		[](const SiqsParams &a, const SiqsParams &b) { return a.digits < b.digits; });
+	file = fopen(PARAM_FILE, "w");
+	if (file == NULL) {
+		fprintf(stderr, "** cannot write %s\n", PARAM_FILE);
+		return;
+	}
+	fprintf(file, "# SIQS parameters measured by SIQSTune\n");
+	fprintf(file, "# digits primes sieveLimit largePrimeMult thresholdAdj\n");
+	for (const SiqsParams &entry : table) {
+		fprintf(file, "%d %d %d %d %d\n", entry.digits, entry.nbrPrimes,
+			entry.sieveLimit, entry.largePrimeMult, entry.thresholdAdj);
+	}
+	fclose(file);
+	paramTableRead = false;          // read new table in next factorisation
+}
+
+/* Tuning mode: for each size from minDigits to maxDigits, factor a random 
+   semiprime with the current parameters and then with smaller and larger
+   values of each parameter in turn, keeping the fastest. The best values
+   are written to PARAM_FILE, which FactoringSIQSx reads. */
+void SIQSTune(int minDigits, int maxDigits) {
+	const double scale[] = { 0.7, 1.4 };  // multiply each parameter by these
+	std::vector<SiqsParams> tuned;
+	gmp_randstate_t state;
+	Znum N, p, q, low, high;
+
+	gmp_randinit_default(state);
+	gmp_randseed_ui(state, 12345);    // same numbers every time
+	for (int digits = minDigits; digits <= maxDigits; digits += TUNE_STEP) {
+		/* semiprime with factors of about the same size */
+		mpz_ui_pow_ui(ZT(low), 10, digits - 1);
+		mpz_ui_pow_ui(ZT(high), 10, digits);
+		do {
+			mpz_urandomm(ZT(p), state, ZT(high));
+			mpz_sqrt(ZT(p), ZT(p));
+			mpz_nextprime(ZT(p), ZT(p));
+			mpz_urandomm(ZT(q), state, ZT(high));
+			mpz_sqrt(ZT(q), ZT(q));
+			mpz_nextprime(ZT(q), ZT(q));
+			N = p * q;
+		} while (N < low || N >= high || p == q);
+
+		SiqsParams best, base, trial;
+		double bestTime, time, bestRate, rate;
+		GetSiqsParams(logBigNbr(N), best);
+		best.digits = digits;
+		bestTime = TuneBest(N, best, bestRate);
+		ShowTuneResult(lang ? "Prueba" : "Trial", best, bestTime, bestRate);
+		for (int param = 0; param < 4; param++) {
+			base = best;
+			for (double s : scale) {
+				trial = base;
+				switch (param) {
+				case 0: trial.nbrPrimes = (int)(base.nbrPrimes * s); break;
+				case 1: trial.sieveLimit = (int)(base.sieveLimit * s); break;
+				case 2: trial.largePrimeMult = (int)(base.largePrimeMult * s); break;
+				case 3: trial.thresholdAdj = base.thresholdAdj + (s < 1 ? -1 : 1); break;
+				}
+				if (trial.sieveLimit > MAX_SIEVE_LIMIT || trial.largePrimeMult > 1000) {
+					continue;
+				}
+				time = TuneBest(N, trial, rate);
+				ShowTuneResult(lang ? "Prueba" : "Trial", trial, time, rate);
+				if (time < bestTime) {
+					best = trial;
+					bestTime = time;
+					bestRate = rate;
+				}
+			}
+		}
+		ShowTuneResult(lang ? "Mejor" : "Best", best, bestTime, bestRate);
+		tuned.push_back(best);
+		WriteParamTable(tuned);      // keep results if tuning is interrupted
+	}
+	gmp_randclear(state);
+}
+
 static void ShowSIQSStatus(void) {
+	if (metricsFile != NULL && SecondsSince(siqsStart) - metricsLastWrite >= siqsMetricsInterval) {
+		WriteMetrics(PHASE_SIEVE, false);
+	}
 #ifdef __EMSCRIPTEN__
 	int elapsedTime = (int)(tenths() - originalTenthSecond);
 	if (elapsedTime / 10 != oldTimeElapsed / 10)
@@ -2436,20 +4119,352 @@ static int EraseSingletons(int nbrFactorBasePrimes) {
 	return matrixBlength;
 }
 
+/* Filtering. After the singletons are erased, the relations that exceed
+   the number of columns by more than FILTER_EXCESS are removed in cliques
+   (groups of relations joined by primes that appear in only two of them),
+   and then columns of low weight are merged: the lightest relation that
+   includes the prime is added to the other ones and then discarded. */
+
+/* Remove cliques from matrixB until the excess of relations over columns
+   is FILTER_EXCESS. The number of rows is returned. */
+static int RemoveCliques(int matrixBlength) {
+	int nbrColumns = primeTrialDivisionData[0].exp[1];
+	int row, column;
+
+	while (matrixBlength - nbrColumns > FILTER_EXCESS) {
+		std::vector<int> firstRow(nbrColumns, -1);
+		std::vector<int> weight(nbrColumns, 0);
+		std::vector<int> parent(matrixBlength);
+		std::vector<int> size(matrixBlength, 0);
+		std::vector<std::pair<int, int>> cliques;     // (size, root)
+		std::vector<char> removeRow(matrixBlength, 0);
+		int toRemove = matrixBlength - nbrColumns - FILTER_EXCESS;
+		int delta = 0;
+
+		// Join the relations that share a column of weight 2.
+		for (row = 0; row < matrixBlength; row++) {
+			parent[row] = row;
+			for (column = matrixB[row][LENGTH_OFFSET] - 1; column >= 1; column--) {
+				int prime = matrixB[row][column];
+				if (weight[prime]++ == 0) {
+					firstRow[prime] = row;
+				}
+			}
+		}
+		for (row = 0; row < matrixBlength; row++) {
+			for (column = matrixB[row][LENGTH_OFFSET] - 1; column >= 1; column--) {
+				int prime = matrixB[row][column];
+				if (weight[prime] == 2 && firstRow[prime] != row) {
+					int root1 = firstRow[prime];
+					int root2 = row;
+					while (parent[root1] != root1) {
+						root1 = parent[root1] = parent[parent[root1]];
+					}
+					while (parent[root2] != root2) {
+						root2 = parent[root2] = parent[parent[root2]];
+					}
+					parent[root1] = root2;
+				}
+			}
+		}
+		for (row = 0; row < matrixBlength; row++) {
+			int root = row;
+			while (parent[root] != root) {
+				root = parent[root];
+			}
+			parent[row] = root;
+			size[root]++;
+		}
+		for (row = 0; row < matrixBlength; row++) {
+			if (size[row] > 1) {
+				cliques.push_back(std::make_pair(size[row], row));
+			}
+		}
+		if (cliques.empty()) {
+			break;        // Nothing else to remove.
+		}
+		// Each clique removed decreases the excess by at most 1, so remove
+		// the largest ones, which hold the most relations.
+		std::sort(cliques.begin(), cliques.end(), std::greater<std::pair<int, int>>());
+		if ((int)cliques.size() > toRemove) {
+			cliques.resize(toRemove);
+		}
+		for (const auto &clique : cliques) {
+			removeRow[clique.second] = 1;
+		}
+		for (row = 0; row < matrixBlength; row++) {
+			if (removeRow[parent[row]]) {
+				delta++;
+			}
+			else if (delta > 0) {
+				memcpy(matrixB[row - delta], matrixB[row], sizeof(matrixB[0]));
+				memcpy(vectLeftHandSide[row - delta], vectLeftHandSide[row], sizeof(vectLeftHandSide[0]));
+			}
+		}
+		// Erase the singletons left by the cliques.
+		matrixBLength = matrixBlength - delta;
+		matrixBlength = EraseSingletons(nbrColumns);
+		nbrColumns = primeTrialDivisionData[0].exp[1];
+	}
+	return matrixBlength;
+}
+
+/* symmetric difference of two sorted sets */
+static void SetAdd(std::vector<int> &dest, const std::vector<int> &source) {
+	std::vector<int> sum;
+	std::set_symmetric_difference(dest.begin(), dest.end(), source.begin(),
+		source.end(), std::back_inserter(sum));
+	dest.swap(sum);
+}
+
+/* add row to the rows of a column, or remove it if it is already there.
+   When the column gets more than FILTER_MERGE_WEIGHT rows it is marked as
+   heavy and its list is freed. */
+static void ToggleColumnRow(std::vector<int> &rows, char &heavy, int row) {
+	auto it = std::find(rows.begin(), rows.end(), row);
+	if (it != rows.end()) {
+		*it = rows.back();
+		rows.pop_back();
+	}
+	else if ((int)rows.size() < FILTER_MERGE_WEIGHT) {
+		rows.push_back(row);
+	}
+	else {
+		heavy = 1;
+		std::vector<int>().swap(rows);
+	}
+}
+
+/* Build filterPrimes and filterRelations from the matrixBlength relations
+   in matrixB and merge the columns with at most FILTER_MERGE_WEIGHT
+   relations while the cost of Block Lanczos, which is proportional to the
+   number of rows times the number of entries, decreases. Return the number
+   of rows and set matrixCols to the number of columns.
+   Only the columns with at most FILTER_MERGE_WEIGHT relations keep the list
+   of their rows; a column that becomes heavier is never merged, so its list
+   is dropped and the lists searched on each update stay short. */
+static int MergeRelations(int matrixBlength) {
+	int nbrColumns = primeTrialDivisionData[0].exp[1];
+	std::vector<std::vector<int>> columnRows(nbrColumns);
+	std::vector<char> heavyColumn(nbrColumns, 0);
+	std::vector<int> newColumn(nbrColumns, -1);
+	int row, column, weight;
+	int nbrRows = matrixBlength;
+	long long nbrEntries = 0;
+
+	filterPrimes.assign(matrixBlength, std::vector<int>());
+	filterRelations.assign(matrixBlength, std::vector<int>());
+	for (row = 0; row < matrixBlength; row++) {
+		filterPrimes[row].assign(&matrixB[row][1], &matrixB[row][matrixB[row][LENGTH_OFFSET]]);
+		filterRelations[row].push_back(row);
+		for (int prime : filterPrimes[row]) {
+			if (!heavyColumn[prime]) {
+				ToggleColumnRow(columnRows[prime], heavyColumn[prime], row);
+			}
+		}
+		nbrEntries += filterPrimes[row].size();
+	}
+	for (weight = 2; weight <= FILTER_MERGE_WEIGHT; weight++) {
+		for (column = 0; column < nbrColumns; column++) {
+			std::vector<int> &rows = columnRows[column];
+			long long deltaEntries;
+			int pivot;
+
+			if (rows.empty() || (int)rows.size() > weight) {
+				continue;
+			}
+			pivot = rows[0];
+			for (int r : rows) {
+				if (filterPrimes[r].size() < filterPrimes[pivot].size()) {
+					pivot = r;
+				}
+			}
+			std::vector<int> others;
+			for (int r : rows) {
+				if (r != pivot) {
+					others.push_back(r);
+				}
+			}
+			if (weight > 2) {     // find out whether the merge is useful
+				deltaEntries = -(long long)filterPrimes[pivot].size();
+				for (int r : others) {
+					std::vector<int> sum(filterPrimes[r]);
+					SetAdd(sum, filterPrimes[pivot]);
+					deltaEntries += (long long)sum.size() - (long long)filterPrimes[r].size();
+				}
+				if ((nbrRows - 1) * (nbrEntries + deltaEntries) >= nbrRows * nbrEntries) {
+					continue;
+				}
+			}
+			// Add the pivot row to the other rows and then delete it.
+			const std::vector<int> pivotPrimes(filterPrimes[pivot]);
+			for (int r : others) {
+				for (int prime : pivotPrimes) {
+					if (!heavyColumn[prime]) {
+						ToggleColumnRow(columnRows[prime], heavyColumn[prime], r);
+					}
+				}
+				nbrEntries -= filterPrimes[r].size();
+				SetAdd(filterPrimes[r], pivotPrimes);
+				SetAdd(filterRelations[r], filterRelations[pivot]);
+				nbrEntries += filterPrimes[r].size();
+			}
+			for (int prime : pivotPrimes) {
+				if (!heavyColumn[prime]) {
+					ToggleColumnRow(columnRows[prime], heavyColumn[prime], pivot);
+				}
+			}
+			nbrEntries -= pivotPrimes.size();
+			std::vector<int>().swap(filterPrimes[pivot]);
+			std::vector<int>().swap(filterRelations[pivot]);
+			nbrRows--;
+		}
+	}
+	// Compact the rows and renumber the columns that are not empty.
+	nbrColumns = 0;
+	row = 0;
+	for (size_t r = 0; r < filterPrimes.size(); r++) {
+		if (filterRelations[r].empty()) {
+			continue;
+		}
+		for (int &prime : filterPrimes[r]) {
+			if (newColumn[prime] < 0) {
+				newColumn[prime] = nbrColumns++;
+			}
+			prime = newColumn[prime];
+		}
+		std::sort(filterPrimes[r].begin(), filterPrimes[r].end());
+		filterPrimes[row].swap(filterPrimes[r]);
+		filterRelations[row].swap(filterRelations[r]);
+		row++;
+	}
+	filterPrimes.resize(row);
+	filterRelations.resize(row);
+	matrixCols = nbrColumns;
+	return row;
+}
+
+/* multiply all values and reduce the product mod modulus. The values are
+   multiplied in pairs as a binary tree, so that the large products have 
+   operands of similar size, which GMP multiplies much faster than one 
+   big number by many small ones. values is overwritten. */
+static void ProductTree(std::vector<Znum> &values, const Znum &modulus, Znum &product) {
+	size_t count = values.size();
+
+	if (count == 0) {
+		product = 1;
+		return;
+	}
+	while (count > 1) {
+		size_t half = 0;
+		for (size_t index = 0; index + 1 < count; index += 2) {
+			values[half++] = values[index] * values[index + 1];
+		}
+		if ((count & 1) != 0) {
+			values[half++] = std::move(values[count - 1]);
+		}
+		count = half;
+	}
+	product = values[0] % modulus;
+}
+
+/* build the square roots X and Y of a dependency: X is the product of the
+   left hand sides of the relations and Y the product of the primes raised
+   to half their exponents (mod kN). Return gcd(X - Y, N). */
+static void SquareRootGcd(const std::vector<int> &relations, const Znum &modulus,
+	const Znum &number, int numLen, Znum &result) {
+	std::vector<int> exponents(nbrFactorBasePrimes, 0);
+	std::vector<Znum> values(relations.size());
+	Znum X, Y;
+
+	for (size_t index = 0; index < relations.size(); index++) {
+		const int *rowMatrixB = matrixB[relations[index]];
+		ValuestoZ(values[index], vectLeftHandSide[relations[index]], numLen);
+		for (int j = 1; j < rowMatrixB[LENGTH_OFFSET]; j++) {
+			exponents[rowMatrixB[j]]++;
+		}
+	}
+	ProductTree(values, modulus, X);
+	values.clear();
+	for (int primeIndex = 1; primeIndex < nbrFactorBasePrimes; primeIndex++) {
+		if (exponents[primeIndex] >= 2) {
+			values.emplace_back();
+			mpz_ui_pow_ui(ZT(values.back()), primeTrialDivisionData[primeIndex].value,
+				exponents[primeIndex] / 2);
+		}
+	}
+	ProductTree(values, modulus, Y);
+	if ((exponents[0] / 2) & 1) {
+		Y = modulus - Y;            // index 0 is the factor -1
+	}
+	X -= Y;
+	result = gcd(X, number);
+}
+
+/* split N using the dependencies found by Block Lanczos. Every nontrivial
+   gcd splits the elements of siqsFactors it divides. The dependencies are
+   shared by several threads, which stop as soon as all the factors found
+   are probable primes. */
+static void SplitWithDependencies(const std::vector<std::vector<int>> &dependencies,
+	int numLen) {
+	Znum modulus, number;
+	std::atomic<int> nextDependency(0);
+	std::atomic<bool> allPrime(false);
+	std::mutex factorsMutex;
+	int nbrThreads = (int)std::thread::hardware_concurrency();
+
+	ValuestoZ(modulus, biModulus, numLen);      // kN
+	ValuestoZ(number, biTestNbr2, numLen);      // N
+	if (nbrThreads > (int)dependencies.size()) {
+		nbrThreads = (int)dependencies.size();
+	}
+	auto worker = [&]() {
+		Znum g, d;
+		int dep;
+		while (!allPrime && (dep = nextDependency++) < (int)dependencies.size()) {
+			SquareRootGcd(dependencies[dep], modulus, number, numLen, g);
+			if (g == 1 || g == number) {
+				continue;
+			}
+			std::lock_guard<std::mutex> lock(factorsMutex);
+			for (size_t f = 0; f < siqsFactors.size(); f++) {
+				d = gcd(siqsFactors[f], g);
+				if (d != 1 && d != siqsFactors[f]) {
+					siqsFactors[f] /= d;
+					siqsFactors.push_back(d);
+				}
+			}
+			bool prime = true;
+			for (auto &f : siqsFactors) {
+				if (mpz_probab_prime_p(ZT(f), 16) == 0) {
+					prime = false;
+					break;
+				}
+			}
+			allPrime = prime;
+		}
+	};
+	std::vector<std::thread> threads;
+	for (int t = 1; t < nbrThreads; t++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+
 /************************/
 /* Linear algebra phase */
 /************************/
-static bool LinearAlgebraPhase(
-	int *biT, int *biR, int *biU,
-	int numLen)
+static bool LinearAlgebraPhase(int numLen)
 {
-	int mask, row, col, j;
-	int *rowMatrixB;
-	int primeIndex;
+	uint64_t mask;
+	int row, col;
 
 #if DEBUG_SIQS
 	{
-		int i;
+		int i, j;
 		printf("*******\n");
 		for (j = 0; j < matrixBLength; j++)
 		{
@@ -2475,70 +4490,66 @@ static bool LinearAlgebraPhase(
 	// Get new number of rows after erasing singletons.
 	int matrixBlength = EraseSingletons(nbrFactorBasePrimes);
 	matrixBLength = matrixBlength;
-	matrixRows = matrixBlength;
-	matrixCols = primeTrialDivisionData[0].exp[1];
+	matrixBlength = RemoveCliques(matrixBlength);
+	// Block Lanczos works on the merged relations.
+	matrixRows = MergeRelations(matrixBlength);
+	matrixBLength = matrixRows;
+	EndPhase(PHASE_FILTER);
 	primeTrialDivisionData[0].exp[1] = 0;         // Restore correct value.
 	BlockLanczos();
+	EndPhase(PHASE_LINALG);
 	// The rows of matrixV indicate which rows must be multiplied so no
-	// primes are multiplied an odd number of times.
-	mask = 1;
-	for (col = 31; col >= 0; col--) {
-		int NumberLengthBak, index;
-
-		IntToBigNbr(1, biT, numLen + 1);  // T = 1
-		IntToBigNbr(1, biR, numLen + 1);  // R = 1
-		memset(vectExpParity, 0, matrixBlength * sizeof(vectExpParity[0]));
-		NumberLengthBak = numLen;
-		if (biModulus[numLen - 1] == 0) {
-			numLen--;
-		}
-		for (row = matrixBlength - 1; row >= 0; row--) {
+	// primes are multiplied an odd number of times. Each row is a sum of
+	// relations, so find the relations used an odd number of times.
+	std::vector<std::vector<int>> dependencies;
+	std::vector<char> useRelation(matrixBlength);
+	for (col = 0; col < 64; col++) {
+		mask = (uint64_t)1 << col;
+		std::fill(useRelation.begin(), useRelation.end(), 0);
+		for (row = matrixRows - 1; row >= 0; row--) {
 			if ((matrixV[row] & mask) != 0) {
-				MultBigNbrModN(vectLeftHandSide[row], biR, biU, biModulus,
-					numLen);  // U = LHS * R (mod Modulus)
-				memcpy(biR, biU, (numLen + 1) * sizeof(biR[0]));
-				rowMatrixB = matrixB[row];
-				for (j = rowMatrixB[LENGTH_OFFSET] - 1; j >= 1; j--) {
-					primeIndex = rowMatrixB[j];
-					vectExpParity[primeIndex] ^= 1;
-					if (vectExpParity[primeIndex] == 0) {
-						if (primeIndex == 0) {
-							SubtractBigNbr(biModulus, biT, biT, numLen); // Multiply biT by -1.
-						}
-						else {
-							MultBigNbrByIntModN(biT,
-								primeTrialDivisionData[primeIndex].value, biT,
-								biModulus, numLen);
-						}
-					}
+				for (int relation : filterRelations[row]) {
+					useRelation[relation] ^= 1;
 				}
 			}
 		}
-		numLen = NumberLengthBak;
-		SubtractBigNbrModN(biR, biT, biR, biModulus, numLen);
-		GcdBigNbr(biR, biTestNbr2, biT, numLen);
-
-		for (index = 1; index < numLen; index++) {
-			if (biT[index] != 0) {
-				break;
+		std::vector<int> relations;
+		for (row = 0; row < matrixBlength; row++) {
+			if (useRelation[row] != 0) {
+				relations.push_back(row);
 			}
 		}
-		if (index < numLen || biT[0] > 1) {   // GCD is not zero or 1.
-			for (index = 0; index < numLen; index++) {
-				if (biT[index] != biTestNbr2[index]) {
+		if (!relations.empty()) {
+			dependencies.push_back(std::move(relations));
+		}
+	}
+	SplitWithDependencies(dependencies, numLen);
+	EndPhase(PHASE_SQRT);
+	return siqsFactors.size() > 1;
+}
+
+static int nn;
+/* Check whether this relation is already in the matrix. */
+static bool RelationInMatrix(const int *rowMatrixB) {
+	int i, k;
+	int nbrColumns = rowMatrixB[LENGTH_OFFSET];
+	const int *curRowMatrixB = matrixB[0];
+	for (i = 0; i < congruencesFound; i++) {
+		if (nbrColumns == *(curRowMatrixB + LENGTH_OFFSET)) {
+			for (k = 1; k < nbrColumns; k++) {
+				if (*(rowMatrixB + k) != curRowMatrixB[k]) {
 					break;
 				}
 			}
-			if (index < numLen) { /* GCD is not 1 */
+			if (k == nbrColumns) {
 				return true;
 			}
 		}
-		mask *= 2;
+		curRowMatrixB += MAX_FACTORS_RELATION;
 	}
 	return false;
 }
 
-static int nn;
 /* return true if relation added to matrixB, 
 or if matrixB is full. 
 return false if relation already in matrixB 
@@ -2548,7 +4559,7 @@ static bool InsertNewRelation(
 	int *biT, int *biU, int *biR,
 	int NumberLengthMod)
 {
-	int i, k;
+	int k;
 	int lenDivisor;
 	int nbrColumns = rowMatrixB[LENGTH_OFFSET];
 	// Insert it only if it is different from previous relations.
@@ -2565,7 +4576,7 @@ static bool InsertNewRelation(
 		BigInteger2Dec(&k, ptrOutput, 0);
 		ptrOutput += strlen(ptrOutput);
 		*ptrOutput++ = ',';
-		for (i = 1; i < *rowMatrixB; i++)
+		for (int i = 1; i < *rowMatrixB; i++)
 		{
 			int2dec(&ptrOutput, *(rowMatrixB + i));
 			*ptrOutput++ = ',';
@@ -2578,20 +4589,8 @@ static bool InsertNewRelation(
 		nn = 3018;
 	}
 #endif
-	// Check whether this relation is already in the matrix.
-	int *curRowMatrixB = matrixB[0];
-	for (i = 0; i < congruencesFound; i++) {
-		if (nbrColumns == *(curRowMatrixB + LENGTH_OFFSET)) {
-			for (k = 1; k < nbrColumns; k++) {
-				if (*(rowMatrixB + k) != curRowMatrixB[k]) {
-					break;
-				}
-			}
-			if (k == nbrColumns) {
-				return false; // Do not insert same relation.
-			}
-		}
-		curRowMatrixB += MAX_FACTORS_RELATION;
+	if (RelationInMatrix(rowMatrixB)) {
+		return false; // Do not insert same relation.
 	}
 
 	/* Convert negative numbers to the range 0 <= n < biModulus */
@@ -2631,6 +4630,7 @@ static bool InsertNewRelation(
 	// Add relation to matrix B.
 	memcpy(matrixB[congruencesFound], &rowMatrixB[0], nbrColumns * sizeof(int));
 	memcpy(vectLeftHandSide[congruencesFound], biR, NumberLengthMod * sizeof(int));
+	WriteCheckpoint('R', rowMatrixB, nbrColumns, biR, NumberLengthMod);
 	congruencesFound++;
 #if 0 // DEBUG_SIQS
 	{
@@ -2660,135 +4660,292 @@ static int intModInv(int NbrMod, int currentPrime) {
 			T1 = U1 - V1;
 			T3 = U3 - V3;
 		}
-		else {
-			QQ = U3 / V3;
-			T1 = U1 - V1 * QQ;
-			T3 = U3 - V3 * QQ;
+		else {
+			QQ = U3 / V3;
+			T1 = U1 - V1 * QQ;
+			T3 = U3 - V3 * QQ;
+		}
+		U1 = V1;
+		U3 = V3;
+		V1 = T1;
+		V3 = T3;
+	}
+	return U1 + (currentPrime & (U1 >> 31));
+}
+
+/* Block Lanczos works on blocks of 64 bits: an n x 64 binary matrix is an
+   array of n uint64_t and column c is bit 63-c. The 64 x 64 matrices are
+   arrays of 64 uint64_t. */
+
+/* Sparse matrix used by Block Lanczos, in compressed sparse column format.
+   Column j (relation j) has the primes matrixRowIndex[matrixColStart[j]] to
+   matrixRowIndex[matrixColStart[j+1]-1]. The same matrix is also stored by
+   rows (the transpose) so that both products are computed as gathers and
+   the rows can be split among threads without locks. */
+static std::vector<int> matrixColStart;
+static std::vector<int> matrixRowIndex;
+static std::vector<int> matrixRowStart;
+static std::vector<int> matrixColIndex;
+static int lanczosThreads;           // threads for sparse matrix products
+
+/* Block Lanczos does two sparse products per iteration, so the helper threads
+   are started once with the matrix and wait for work, instead of being
+   created for every product. Thread 0 is the calling thread. */
+static std::vector<std::thread> lanczosWorkers;
+static std::mutex lanczosMutex;
+static std::condition_variable lanczosStart, lanczosDone;
+static std::function<void(int, int)> lanczosJob;
+static int lanczosJobSize;           // range of the current job is 0 to this - 1
+static int lanczosJobNbr;            // incremented for each job
+static int lanczosPending;           // helper threads still working on the job
+static bool lanczosQuit;
+
+static void LanczosWorker(int t) {
+	int jobNbr = 0;
+	for (;;) {
+		std::unique_lock<std::mutex> lock(lanczosMutex);
+		lanczosStart.wait(lock, [&] { return lanczosQuit || lanczosJobNbr != jobNbr; });
+		if (lanczosQuit) {
+			return;
+		}
+		jobNbr = lanczosJobNbr;
+		int n = lanczosJobSize;
+		lock.unlock();
+		lanczosJob((int)((long long)n * t / lanczosThreads),
+			(int)((long long)n * (t + 1) / lanczosThreads));
+		lock.lock();
+		if (--lanczosPending == 0) {
+			lanczosDone.notify_one();
+		}
+	}
+}
+
+static void StartLanczosWorkers(void) {
+	lanczosQuit = false;
+	lanczosJobNbr = 0;
+	for (int t = 1; t < lanczosThreads; t++) {
+		lanczosWorkers.emplace_back(LanczosWorker, t);
+	}
+}
+
+static void StopLanczosWorkers(void) {
+	{
+		std::lock_guard<std::mutex> lock(lanczosMutex);
+		lanczosQuit = true;
+	}
+	lanczosStart.notify_all();
+	for (auto &worker : lanczosWorkers) {
+		worker.join();
+	}
+	lanczosWorkers.clear();
+	lanczosJob = nullptr;
+}
+
+/* build sparse matrix from the matrixBLength rows of filterPrimes, whose
+   column indexes are less than matrixCols. */
+static void BuildSparseMatrix(void) {
+	int row, index, nnz = 0;
+
+	matrixColStart.assign(matrixBLength + 1, 0);
+	matrixRowStart.assign(matrixCols + 1, 0);
+	for (row = 0; row < matrixBLength; row++) {
+		matrixColStart[row] = nnz;
+		for (int prime : filterPrimes[row]) {
+			matrixRowStart[prime + 1]++;
+		}
+		nnz += (int)filterPrimes[row].size();
+	}
+	matrixColStart[matrixBLength] = nnz;
+	matrixRowIndex.resize(nnz);
+	matrixColIndex.resize(nnz);
+	for (index = 0; index < matrixCols; index++) {
+		matrixRowStart[index + 1] += matrixRowStart[index];
+	}
+	std::vector<int> next(matrixRowStart.begin(), matrixRowStart.end() - 1);
+	for (row = 0; row < matrixBLength; row++) {
+		index = matrixColStart[row];
+		for (int prime : filterPrimes[row]) {
+			matrixRowIndex[index++] = prime;
+			matrixColIndex[next[prime]++] = row;
+		}
+	}
+	lanczosThreads = 1;
+	if (nnz >= LANCZOS_MT_MIN) {
+		lanczosThreads = (int)std::thread::hardware_concurrency();
+		if (lanczosThreads < 1) {
+			lanczosThreads = 1;
 		}
-		U1 = V1;
-		U3 = V3;
-		V1 = T1;
-		V3 = T3;
 	}
-	return U1 + (currentPrime & (U1 >> 31));
+	StartLanczosWorkers();
 }
 
-/* Multiply binary matrices of length m x 32 by 32 x 32 */
-/* The product matrix has size m x 32. Then add it to a m x 32 matrix. */
-static void MatrixMultAdd(int *LeftMatr, int *RightMatr, int *ProdMatr) {
-	int matrLength = matrixBLength;
-	int row;
+static void FreeSparseMatrix(void) {
+	StopLanczosWorkers();
+	std::vector<int>().swap(matrixColStart);
+	std::vector<int>().swap(matrixRowIndex);
+	std::vector<int>().swap(matrixRowStart);
+	std::vector<int>().swap(matrixColIndex);
+}
 
-	for (row = 0; row < matrLength; row++) {
-		int col;
-		int prodMatr = *(ProdMatr + row);
-		int leftMatr = *(LeftMatr + row);
-		for (col = 0; col<32; col++) {
-			if (leftMatr < 0) {
-				prodMatr ^= *(RightMatr + col);
+/* call func(first, last) for parts of the range 0 to n-1, using the
+   Lanczos worker threads */
+template <typename F>
+static void ParallelRange(int n, F func) {
+	if (lanczosThreads <= 1) {
+		func(0, n);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(lanczosMutex);
+		lanczosJob = func;
+		lanczosJobSize = n;
+		lanczosPending = lanczosThreads - 1;
+		lanczosJobNbr++;
+	}
+	lanczosStart.notify_all();
+	func(0, (int)((long long)n / lanczosThreads));
+	std::unique_lock<std::mutex> lock(lanczosMutex);
+	lanczosDone.wait(lock, [] { return lanczosPending == 0; });
+}
+
+/* Fill table so that table[k][v] is the XOR of the rows of RightMatr selected
+   by the bits of v, where v is byte k (from the top) of a row of the left
+   matrix. Then a row of the product needs 8 lookups instead of 64 tests. */
+static void BuildMultTable(const uint64_t *RightMatr, uint64_t table[8][256]) {
+	for (int k = 0; k < 8; k++) {
+		table[k][0] = 0;
+		for (int bit = 0; bit < 8; bit++) {
+			uint64_t rightRow = RightMatr[8 * k + 7 - bit];
+			for (int v = 0; v < (1 << bit); v++) {
+				table[k][v | (1 << bit)] = table[k][v] ^ rightRow;
 			}
-			leftMatr *= 2;
 		}
-		*(ProdMatr + row) = prodMatr;
 	}
 }
 
-/* Multiply binary matrices of length m x 32 by 32 x 32 */
-/* The product matrix has size m x 32 */
-static void MatrixMultiplication(int *LeftMatr, int *RightMatr, int *ProdMatr) {
-	int matrLength = 32;
+static inline uint64_t MultByTable(uint64_t leftRow, const uint64_t table[8][256]) {
+	return table[0][leftRow >> 56] ^ table[1][(leftRow >> 48) & 0xFF] ^
+		table[2][(leftRow >> 40) & 0xFF] ^ table[3][(leftRow >> 32) & 0xFF] ^
+		table[4][(leftRow >> 24) & 0xFF] ^ table[5][(leftRow >> 16) & 0xFF] ^
+		table[6][(leftRow >> 8) & 0xFF] ^ table[7][leftRow & 0xFF];
+}
+
+/* Multiply binary matrices of length m x 64 by 64 x 64 */
+/* The product matrix has size m x 64. Then add it to a m x 64 matrix. */
+static void MatrixMultAdd(const uint64_t *LeftMatr, const uint64_t *RightMatr, uint64_t *ProdMatr) {
+	thread_local uint64_t table[8][256];
 	int row;
 
-	for (row = 0; row < matrLength; row++) {
+	BuildMultTable(RightMatr, table);
+	for (row = matrixBLength - 1; row >= 0; row--) {
+		ProdMatr[row] ^= MultByTable(LeftMatr[row], table);
+	}
+}
+
+/* Multiply binary matrices of length 64 x 64 by 64 x 64 */
+/* The product matrix has size 64 x 64 */
+static void MatrixMultiplication(const uint64_t *LeftMatr, const uint64_t *RightMatr, uint64_t *ProdMatr) {
+	int row;
+
+	for (row = 0; row < 64; row++) {
 		int col;
-		int prodMatr = 0;
-		int leftMatr = *(LeftMatr + row);
-		for (col = 0; col < 32; col++) {
-			if (leftMatr < 0) {
-				prodMatr ^= *(RightMatr + col);
+		uint64_t prodMatr = 0;
+		uint64_t leftMatr = LeftMatr[row];
+		for (col = 0; col < 64; col++) {
+			if ((int64_t)leftMatr < 0) {
+				prodMatr ^= RightMatr[col];
 			}
-			leftMatr *= 2;
+			leftMatr <<= 1;
 		}
-		*(ProdMatr + row) = prodMatr;
+		ProdMatr[row] = prodMatr;
 	}
 }
 
-/* Multiply the transpose of a binary matrix of length n x 32 by */
-/* another binary matrix of length n x 32 */
-/* The product matrix has size 32 x 32 */
-static void MatrTranspMult(int matrLength, int *LeftMatr, int *RightMatr, int *ProdMatr) {
-	int row, col;
-	int iMask = 1;
+/* Multiply the transpose of a binary matrix of length n x 64 by */
+/* another binary matrix of length n x 64 */
+/* The product matrix has size 64 x 64 */
+static void MatrTranspMult(int matrLength, const uint64_t *LeftMatr, const uint64_t *RightMatr, uint64_t *ProdMatr) {
+	thread_local uint64_t sums[8][256];
+	int row, k, bit, v;
 
-	for (col = 31; col >= 0; col--) {
-		int prodMatr = 0;
-		for (row = 0; row < matrLength; row++) {
-			if ((*(LeftMatr + row) & iMask) != 0) {
-				prodMatr ^= *(RightMatr + row);
+	/* add each row of RightMatr to the entry selected by each byte of the
+	   corresponding row of LeftMatr */
+	memset(sums, 0, sizeof(sums));
+	for (row = 0; row < matrLength; row++) {
+		uint64_t leftRow = LeftMatr[row];
+		uint64_t rightRow = RightMatr[row];
+		for (k = 7; k >= 0; k--) {
+			sums[k][leftRow & 0xFF] ^= rightRow;
+			leftRow >>= 8;
+		}
+	}
+	for (k = 0; k < 8; k++) {
+		for (bit = 0; bit < 8; bit++) {
+			uint64_t prodMatr = 0;
+			for (v = 1 << bit; v < 256; v = (v + 1) | (1 << bit)) {
+				prodMatr ^= sums[k][v];
 			}
+			ProdMatr[8 * k + 7 - bit] = prodMatr;
 		}
-		*(ProdMatr + col) = prodMatr;
-		iMask *= 2;
 	}
 }
 
-static void MatrixAddition(int *leftMatr, int *rightMatr, int *sumMatr) {
+static void MatrixAddition(const uint64_t *leftMatr, const uint64_t *rightMatr, uint64_t *sumMatr) {
 	int row;
 
-	for (row = 32 - 1; row >= 0; row--) {
-		*(sumMatr + row) = *(leftMatr + row) ^ *(rightMatr + row);
+	for (row = 64 - 1; row >= 0; row--) {
+		sumMatr[row] = leftMatr[row] ^ rightMatr[row];
 	}
 }
 
-static void MatrMultBySSt(int length, int *Matr, int diagS, int *Prod) {
+static void MatrMultBySSt(int length, const uint64_t *Matr, uint64_t diagS, uint64_t *Prod) {
 	int row;
 
 	for (row = length - 1; row >= 0; row--) {
-		*(Prod + row) = diagS & *(Matr + row);
+		Prod[row] = diagS & Matr[row];
 	}
 }
 
 /* Compute Bt * B * input matrix where B is the matrix that holds the */
-/* factorization relations */
-static void MultiplyAByMatrix(int *Matr, int *TempMatr, int *ProdMatr) {
-	int index;
-	int row;
-	int *rowMatrixB;
-
-	/* Compute TempMatr = B * Matr */
-	memset(TempMatr, 0, matrixBLength * sizeof(int));
-	for (row = matrixBLength - 1; row >= 0; row--) {
-		int rowValue;
-		rowMatrixB = matrixB[row];
-		rowValue = *(Matr + row);
-		for (index = *(rowMatrixB + LENGTH_OFFSET) - 1; index >= 1; index--) {
-			*(TempMatr + *(rowMatrixB + index)) ^= rowValue;
+/* factorization relations. Both products are split among threads. */
+static void MultiplyAByMatrix(const uint64_t *Matr, uint64_t *TempMatr, uint64_t *ProdMatr) {
+	/* Compute TempMatr = B * Matr: each prime gathers its relations */
+	ParallelRange(matrixCols, [Matr, TempMatr](int first, int last) {
+		const int *colIndex = matrixColIndex.data();
+		for (int row = first; row < last; row++) {
+			uint64_t sum = 0;
+			for (int k = matrixRowStart[row]; k < matrixRowStart[row + 1]; k++) {
+				sum ^= Matr[colIndex[k]];
+			}
+			TempMatr[row] = sum;
 		}
-	}
+	});
 
-	/* Compute ProdMatr = Bt * TempMatr */
-	for (row = matrixBLength - 1; row >= 0; row--) {
-		int prodMatr = 0;
-		rowMatrixB = matrixB[row];
-		for (index = *(rowMatrixB + LENGTH_OFFSET) - 1; index >= 1; index--) {
-			prodMatr ^= *(TempMatr + *(rowMatrixB + index));
+	/* Compute ProdMatr = Bt * TempMatr: each relation gathers its primes */
+	ParallelRange(matrixBLength, [TempMatr, ProdMatr](int first, int last) {
+		const int *rowIndex = matrixRowIndex.data();
+		for (int col = first; col < last; col++) {
+			uint64_t sum = 0;
+			for (int k = matrixColStart[col]; k < matrixColStart[col + 1]; k++) {
+				sum ^= TempMatr[rowIndex[k]];
+			}
+			ProdMatr[col] = sum;
 		}
-		*(ProdMatr + row) = prodMatr;
-	}
+	});
 }
 
-static void colexchange(int *XmY, int *V, int *V1, int *V2, int col1, int col2) {
+static void colexchange(uint64_t *XmY, uint64_t *V, uint64_t *V1, uint64_t *V2, int col1, int col2) {
 	int row;
-	int mask1, mask2;
-	int *matr1, *matr2;
+	uint64_t mask1, mask2;
+	uint64_t *matr1, *matr2;
 
 	if (col1 == col2) {          // Cannot exchange the same column.
 		return;
 	}          // Exchange columns col1 and col2 of V1:V2
-	mask1 = 0x80000000 >> (col1 & 31);
-	mask2 = 0x80000000 >> (col2 & 31);
-	matr1 = (col1 >= 32 ? V1 : V2);
-	matr2 = (col2 >= 32 ? V1 : V2);
+	mask1 = 0x8000000000000000ULL >> (col1 & 63);
+	mask2 = 0x8000000000000000ULL >> (col2 & 63);
+	matr1 = (col1 >= 64 ? V1 : V2);
+	matr2 = (col2 >= 64 ? V1 : V2);
 
 	for (row = matrixBLength - 1; row >= 0; row--) {
 		// If both bits are different toggle them.
@@ -2799,8 +4956,8 @@ static void colexchange(int *XmY, int *V, int *V1, int *V2, int col1, int col2)
 		}
 	}
 	// Exchange columns col1 and col2 of XmY:V
-	matr1 = (col1 >= 32 ? XmY : V);
-	matr2 = (col2 >= 32 ? XmY : V);
+	matr1 = (col1 >= 64 ? XmY : V);
+	matr2 = (col2 >= 64 ? XmY : V);
 	for (row = matrixBLength - 1; row >= 0; row--)	{
          // If both bits are different toggle them.
 		if (((matr1[row] & mask1) == 0) != ((matr2[row] & mask2) == 0)) {
@@ -2810,19 +4967,19 @@ static void colexchange(int *XmY, int *V, int *V1, int *V2, int col1, int col2)
 	}
 }
 
-static void coladd(int *XmY, int *V, int *V1, int *V2, int col1, int col2) {
+static void coladd(uint64_t *XmY, uint64_t *V, uint64_t *V1, uint64_t *V2, int col1, int col2) {
 	int row;
-	int mask1, mask2;
-	int *matr1, *matr2;
+	uint64_t mask1, mask2;
+	uint64_t *matr1, *matr2;
 
 	if (col1 == col2) {
 		return;
 	} 
 	// Add column col1 to column col2 of V1:V2
-	mask1 = 0x80000000 >> (col1 & 31);
-	mask2 = 0x80000000 >> (col2 & 31);
-	matr1 = (col1 >= 32 ? V1 : V2);
-	matr2 = (col2 >= 32 ? V1 : V2);
+	mask1 = 0x8000000000000000ULL >> (col1 & 63);
+	mask2 = 0x8000000000000000ULL >> (col2 & 63);
+	matr1 = (col1 >= 64 ? V1 : V2);
+	matr2 = (col2 >= 64 ? V1 : V2);
 
 	for (row = matrixBLength - 1; row >= 0; row--) 	{ 
 		// If bit to add is '1'...
@@ -2832,8 +4989,8 @@ static void coladd(int *XmY, int *V, int *V1, int *V2, int col1, int col2) {
 	}
 
 	// Add column col1 to column col2 of XmY:V
-	matr1 = (col1 >= 32 ? XmY : V);
-	matr2 = (col2 >= 32 ? XmY : V);
+	matr1 = (col1 >= 64 ? XmY : V);
+	matr2 = (col2 >= 64 ? XmY : V);
 	for (row = matrixBLength - 1; row >= 0; row--) {
 	    // If bit to add is '1'...
 		if ((matr1[row] & mask1) != 0) { 
@@ -2845,35 +5002,38 @@ static void coladd(int *XmY, int *V, int *V1, int *V2, int col1, int col2) {
 static void BlockLanczos(void)
 {
 	int i, j, k;
-	int oldDiagonalSSt, newDiagonalSSt;
-	int index, mask;
-	int matrixD[32] = { 0 };
-	int matrixE[32] = { 0 };
-	int matrixF[32] = { 0 };
-	int matrixWinv[32] = { 0 };
-	int matrixWinv1[32] = { 0 };
-	int matrixWinv2[32] = { 0 };
-	int matrixVtV0[32] = { 0 };
-	int matrixVt1V0[32] = { 0 };
-	int matrixVt2V0[32] = { 0 };
-	int matrixVtAV[32] = { 0 };
-	int matrixVt1AV1[32] = { 0 };
-	int matrixCalcParenD[32] = { 0 };
-	int vectorIndex[64] = { 0 };
-	int matrixTemp[32] = { 0 };
-	int matrixCalc1[32] = { 0 }; // Matrix that holds temporary data
-	int matrixCalc2[32] = { 0 }; // Matrix that holds temporary data
-	int *matr;
+	uint64_t oldDiagonalSSt, newDiagonalSSt;
+	int index;
+	uint64_t mask;
+	uint64_t matrixD[64] = { 0 };
+	uint64_t matrixE[64] = { 0 };
+	uint64_t matrixF[64] = { 0 };
+	uint64_t matrixWinv[64] = { 0 };
+	uint64_t matrixWinv1[64] = { 0 };
+	uint64_t matrixWinv2[64] = { 0 };
+	uint64_t matrixVtV0[64] = { 0 };
+	uint64_t matrixVt1V0[64] = { 0 };
+	uint64_t matrixVt2V0[64] = { 0 };
+	uint64_t matrixVtAV[64] = { 0 };
+	uint64_t matrixVt1AV1[64] = { 0 };
+	uint64_t matrixCalcParenD[64] = { 0 };
+	int vectorIndex[128] = { 0 };
+	uint64_t matrixTemp[64] = { 0 };
+	uint64_t matrixCalc1[64] = { 0 }; // Matrix that holds temporary data
+	uint64_t matrixCalc2[64] = { 0 }; // Matrix that holds temporary data
+	uint64_t *matr;
 	double dSeed, dMult, dDivisor, dAdd;
-	int Temp, Temp1;
+	uint64_t Temp, Temp1;
 	int stepNbr = 0;
-	int currentOrder, currentMask;
+	int currentOrder;
+	uint64_t currentMask;
 	int row, col;
 	int leftCol, rightCol;
 	int minind, min, minanswer;
-	int *rowMatrixB, *ptrMatrixV, *ptrMatrixXmY;
+	uint64_t *ptrMatrixV, *ptrMatrixXmY;
 
-	newDiagonalSSt = oldDiagonalSSt = -1;
+	BuildSparseMatrix();
+	newDiagonalSSt = oldDiagonalSSt = ~0ULL;
 	memset(matrixWinv, 0, sizeof(matrixWinv));
 	memset(matrixWinv1, 0, sizeof(matrixWinv1));
 	memset(matrixWinv2, 0, sizeof(matrixWinv2));
@@ -2890,16 +5050,22 @@ static void BlockLanczos(void)
 	ptrMatrixXmY = &matrixXmY[matrixBLength - 1];
 	for (ptrMatrixV = &matrixV[matrixBLength - 1]; ptrMatrixV >= matrixV; ptrMatrixV--)
 	{
-		double dSeed2 = (dSeed * dMult + dAdd);
-		dSeed2 -= floor(dSeed2 / dDivisor) * dDivisor;
-		*ptrMatrixXmY-- = (int)dSeed + (int)dSeed2;
-		dSeed = (dSeed2 * dMult + dAdd);
-		dSeed -= floor(dSeed / dDivisor) * dDivisor;
-		dSeed2 = (dSeed * dMult + dAdd);
-		dSeed2 -= floor(dSeed2 / dDivisor) * dDivisor;
-		*ptrMatrixV = (int)dSeed + (int)dSeed2;
-		dSeed = (dSeed2 * dMult + dAdd);
-		dSeed -= floor(dSeed / dDivisor) * dDivisor;
+		for (i = 0; i < 2; i++) {   // each 64-bit word is built from 2 values
+			uint64_t value = 0;
+			for (j = 0; j < 2; j++) {
+				double dSeed2 = (dSeed * dMult + dAdd);
+				dSeed2 -= floor(dSeed2 / dDivisor) * dDivisor;
+				value = (value << 32) + (uint32_t)((unsigned)dSeed + (unsigned)dSeed2);
+				dSeed = (dSeed2 * dMult + dAdd);
+				dSeed -= floor(dSeed / dDivisor) * dDivisor;
+			}
+			if (i == 0) {
+				*ptrMatrixXmY-- = value;
+			}
+			else {
+				*ptrMatrixV = value;
+			}
+		}
 	}
 	// Compute matrix Vt(0) * V(0)
 	MatrTranspMult(matrixBLength, matrixV, matrixV, matrixVtV0);
@@ -2933,7 +5099,7 @@ static void BlockLanczos(void)
 			ptrText += strlen(ptrText);
 			strcpy(ptrText, lang ? "Progreso del lgebra lineal: " : "Linear algebra progress: ");
 			ptrText += strlen(ptrText);
-			int2dec(&ptrText, stepNbr * 3200 / matrixRows);
+			int2dec(&ptrText, stepNbr * 6400 / matrixRows);
 			strcpy(ptrText, "%\n");
 			//databack(SIQSInfo);
 			printf("%s", SIQSInfo);
@@ -2968,16 +5134,16 @@ static void BlockLanczos(void)
 		memcpy(matrixWinv, matrixTemp, sizeof(matrixTemp));
 
 		mask = 1;
-		for (j = 31; j >= 0; j--) {
+		for (j = 63; j >= 0; j--) {
 			matrixD[j] = matrixVtAV[j]; /*  D = VtAV    */
 			matrixWinv[j] = mask; /*  Winv = I    */
 			mask *= 2;
 		}
 
-		index = 31;
+		index = 63;
 		mask = 1;
 
-		for (indexC = 31; indexC >= 0; indexC--) {
+		for (indexC = 63; indexC >= 0; indexC--) {
 			if ((oldDiagonalSSt & mask) != 0) {
 				matrixE[index] = indexC;
 				matrixF[index] = mask;
@@ -2987,7 +5153,7 @@ static void BlockLanczos(void)
 		}
 
 		mask = 1;
-		for (indexC = 31; indexC >= 0; indexC--) {
+		for (indexC = 63; indexC >= 0; indexC--) {
 			if ((oldDiagonalSSt & mask) == 0) {
 				matrixE[index] = indexC;
 				matrixF[index] = mask;
@@ -2997,16 +5163,16 @@ static void BlockLanczos(void)
 		}
 
 		newDiagonalSSt = 0;
-		for (j = 0; j < 32; j++) {
+		for (j = 0; j < 64; j++) {
 			currentOrder = matrixE[j];
 			currentMask = matrixF[j];
-			for (k = j; k < 32; k++) {
+			for (k = j; k < 64; k++) {
 				if ((matrixD[matrixE[k]] & currentMask) != 0) {
 					break;
 				}
 			}
 
-			if (k < 32) {
+			if (k < 64) {
 				i = matrixE[k];
 				Temp = matrixWinv[i];
 				matrixWinv[i] = matrixWinv[currentOrder];
@@ -3015,7 +5181,7 @@ static void BlockLanczos(void)
 				matrixD[i] = matrixD[currentOrder];
 				matrixD[currentOrder] = Temp1;
 				newDiagonalSSt |= currentMask;
-				for (k = 31; k >= 0; k--) {
+				for (k = 63; k >= 0; k--) {
 					if (k != currentOrder && ((matrixD[k] & currentMask) != 0)) {
 						matrixWinv[k] ^= Temp;
 						matrixD[k] ^= Temp1;
@@ -3023,7 +5189,7 @@ static void BlockLanczos(void)
 				} /* end for k */
 			}
 			else {
-				for (k = j; k < 31; k++) {
+				for (k = j; k < 63; k++) {
 					if ((matrixWinv[matrixE[k]] & currentMask) != 0) {
 						break;
 					}
@@ -3035,7 +5201,7 @@ static void BlockLanczos(void)
 				Temp1 = matrixD[i];
 				matrixD[i] = matrixD[currentOrder];
 				matrixD[currentOrder] = Temp1;
-				for (k = 31; k >= 0; k--) {
+				for (k = 63; k >= 0; k--) {
 					if ((matrixWinv[k] & currentMask) != 0) {
 						matrixWinv[k] ^= Temp;
 						matrixD[k] ^= Temp1;
@@ -3054,7 +5220,7 @@ static void BlockLanczos(void)
 			int2dec(&ptrOutput, stepNbr);
 			strcpy(ptrOutput, ": matrixWinv1[0] = ");
 			ptrOutput += strlen(ptrOutput);
-			int2dec(&ptrOutput, matrixWinv1[0]);
+			int2dec(&ptrOutput, (int)matrixWinv1[0]);
 			*ptrOutput = 0;
 			printf("%s\n", output);
 		}
@@ -3063,29 +5229,29 @@ static void BlockLanczos(void)
 			// F = -Winv(i-2) * (I - Vt(i-1)*A*V(i-1)*Winv(i-1)) * ParenD * S*St
 			MatrixMultiplication(matrixVt1AV1, matrixWinv1, matrixCalc2);
 			mask = 1; /* Add identity matrix */
-			for (index = 31; index >= 0; index--) {
+			for (index = 63; index >= 0; index--) {
 				matrixCalc2[index] ^= mask;
 				mask *= 2;
 			}
 			MatrixMultiplication(matrixWinv2, matrixCalc2, matrixCalc1);
 			MatrixMultiplication(matrixCalc1, matrixCalcParenD, matrixF);
-			MatrMultBySSt(32, matrixF, newDiagonalSSt, matrixF);
+			MatrMultBySSt(64, matrixF, newDiagonalSSt, matrixF);
 		}
 
 		// E = -Winv(i-1) * Vt(i)*A*V(i) * S*St
 		if (stepNbr >= 2) {
 			MatrixMultiplication(matrixWinv1, matrixVtAV, matrixE);
-			MatrMultBySSt(32, matrixE, newDiagonalSSt, matrixE);
+			MatrMultBySSt(64, matrixE, newDiagonalSSt, matrixE);
 		}
 
 		// ParenD = Vt(i)*A*A*V(i) * S*St + Vt(i)*A*V(i)
 		// D = I - Winv(i) * ParenD
 		MatrTranspMult(matrixBLength, matrixAV, matrixAV, matrixCalc1); // Vt(i)*A*A*V(i)
-		MatrMultBySSt(32, matrixCalc1, newDiagonalSSt, matrixCalc1);
+		MatrMultBySSt(64, matrixCalc1, newDiagonalSSt, matrixCalc1);
 		MatrixAddition(matrixCalc1, matrixVtAV, matrixCalcParenD);
 		MatrixMultiplication(matrixWinv, matrixCalcParenD, matrixD);
 		mask = 1; /* Add identity matrix */
-		for (index = 31; index >= 0; index--) {
+		for (index = 63; index >= 0; index--) {
 			matrixD[index] ^= mask;
 			mask *= 2;
 		}
@@ -3107,21 +5273,21 @@ static void BlockLanczos(void)
 
 		/* Compute value of new matrix Vt(i)V0 */
 		// Vt(i+1)V(0) = Dt * Vt(i)V(0) + Et * Vt(i-1)V(0) + Ft * Vt(i-2)V(0)
-		MatrTranspMult(32, matrixD, matrixVtV0, matrixCalc2);
+		MatrTranspMult(64, matrixD, matrixVtV0, matrixCalc2);
 		if (stepNbr >= 2) {
-			MatrTranspMult(32, matrixE, matrixVt1V0, matrixCalc1);
+			MatrTranspMult(64, matrixE, matrixVt1V0, matrixCalc1);
 			MatrixAddition(matrixCalc1, matrixCalc2, matrixCalc2);
 			if (stepNbr >= 3) {
-				MatrTranspMult(32, matrixF, matrixVt2V0, matrixCalc1);
+				MatrTranspMult(64, matrixF, matrixVt2V0, matrixCalc1);
 				MatrixAddition(matrixCalc1, matrixCalc2, matrixCalc2);
 			}
 		}
 
-		memcpy(matrixTemp2, matrixV2, sizeof(matrixTemp2));
-		memcpy(matrixV2, matrixV1, sizeof(matrixV2));
-		memcpy(matrixV1, matrixV, sizeof(matrixV1));
-		memcpy(matrixV, matrixCalc3, sizeof(matrixV));
-		memcpy(matrixCalc3, matrixTemp2, sizeof(matrixCalc3));
+		memcpy(matrixTemp2, matrixV2, matrixBLength * sizeof(matrixTemp2[0]));
+		memcpy(matrixV2, matrixV1, matrixBLength * sizeof(matrixV2[0]));
+		memcpy(matrixV1, matrixV, matrixBLength * sizeof(matrixV1[0]));
+		memcpy(matrixV, matrixCalc3, matrixBLength * sizeof(matrixV[0]));
+		memcpy(matrixCalc3, matrixTemp2, matrixBLength * sizeof(matrixCalc3[0]));
 		memcpy(matrixTemp, matrixVt2V0, sizeof(matrixTemp));
 		memcpy(matrixVt2V0, matrixVt1V0, sizeof(matrixVt2V0));
 		memcpy(matrixVt1V0, matrixVtV0, sizeof(matrixVt1V0));
@@ -3137,27 +5303,27 @@ static void BlockLanczos(void)
 		matrixV1[row] = matrixV2[row] = 0;
 	}
 	for (row = matrixBLength - 1; row >= 0; row--) {
-		int rowMatrixXmY, rowMatrixV;
+		uint64_t rowMatrixXmY, rowMatrixV;
 
-		rowMatrixB = matrixB[row];
 		rowMatrixXmY = matrixXmY[row];
 		rowMatrixV = matrixV[row];
-		// The vector rowMatrixB includes the indexes of the columns set to '1'.
-		for (index = rowMatrixB[LENGTH_OFFSET] - 1; index >= 1; index--) {
-			col = rowMatrixB[index];
+		// The sparse matrix holds the indexes of the columns set to '1'.
+		for (index = matrixColStart[row]; index < matrixColStart[row + 1]; index++) {
+			col = matrixRowIndex[index];
 			matrixV1[col] ^= rowMatrixXmY;
 			matrixV2[col] ^= rowMatrixV;
 		}
 	}
+	FreeSparseMatrix();
 
-	rightCol = 64;
+	rightCol = 128;
 	leftCol = 0;
 	while (leftCol < rightCol) {
 		for (col = leftCol; col < rightCol; col++)
 		{       // For each column find the first row which has a '1'.
 				// Columns outside this range must have '0' in all rows.
-			matr = (col >= 32 ? matrixV1 : matrixV2);
-			mask = 0x80000000 >> (col & 31);
+			matr = (col >= 64 ? matrixV1 : matrixV2);
+			mask = 0x8000000000000000ULL >> (col & 63);
 			vectorIndex[col] = -1;    // indicate all rows in zero in advance.
 			for (row = 0; row < matrixBLength; row++) {
 				if ((matr[row] & mask) != 0)
@@ -3179,149 +5345,782 @@ static void BlockLanczos(void)
 			}
 		}
 
-		if (leftCol == rightCol) {
-			break;
+		if (leftCol == rightCol) {
+			break;
+		}
+
+		// At this moment all columns from leftCol to rightCol are non-zero.
+		// Get the first row that includes a '1'.
+		min = vectorIndex[leftCol];
+		minind = leftCol;
+		for (col = leftCol + 1; col < rightCol; col++) {
+			if (vectorIndex[col] < min) {
+				min = vectorIndex[col];
+				minind = col;
+			}
+		}
+
+		minanswer = 0;
+		for (col = leftCol; col < rightCol; col++) {
+			if (vectorIndex[col] == min) {
+				minanswer++;
+			}
+		}
+
+		if (minanswer > 1) {    // Two columns with the same first row to '1'.
+			for (col = minind + 1; col < rightCol; col++) {
+				if (vectorIndex[col] == min)
+				{        // Add first column which has '1' in the same row to
+						 // the other columns so they have '0' in this row after
+						 // this operation.
+					coladd(matrixXmY, matrixV, matrixV1, matrixV2, minind, col);
+				}
+			}
+		}
+		else {
+			rightCol--;
+			colexchange(matrixXmY, matrixV, matrixV1, matrixV2, minind, rightCol);
+		}
+	}
+
+	leftCol = 0; /* find linear independent solutions */
+	while (leftCol < rightCol) {
+		for (col = leftCol; col < rightCol; col++)
+		{         // For each column find the first row which has a '1'.
+			matr = (col >= 64 ? matrixXmY : matrixV);
+			mask = 0x8000000000000000ULL >> (col & 63);
+			vectorIndex[col] = -1;    // indicate all rows in zero in advance.
+			for (row = 0; row < matrixBLength; row++) {
+				if ((matr[row] & mask) != 0)
+				{         // First row for this mask is found. Store it.
+					vectorIndex[col] = row;
+					break;
+				}
+			}
+		}
+
+		for (col = leftCol; col < rightCol; col++)
+		{  // If all zeros in col 'col', exchange it with last column with
+		   // data different from zero (rightCol).
+			if (vectorIndex[col] < 0) {
+				rightCol--;                 // Update rightCol to exclude that column.
+				colexchange(matrixXmY, matrixV, matrixV1, matrixV2, rightCol, col);
+				vectorIndex[col] = vectorIndex[rightCol];
+				vectorIndex[rightCol] = -1; // This column now has zeros.
+			}
+		}
+
+		if (leftCol == rightCol) {
+			break;  // exit from while loop
+		}
+
+		// At this moment all columns from leftCol to rightCol are non-zero.
+		// Get the first row that includes a '1'.
+		min = vectorIndex[leftCol];
+		minind = leftCol;
+		for (col = leftCol + 1; col < rightCol; col++) {
+			if (vectorIndex[col] < min) {
+				min = vectorIndex[col];
+				minind = col;
+			}
+		}
+
+		minanswer = 0;
+		for (col = leftCol; col < rightCol; col++) {
+			if (vectorIndex[col] == min) {
+				minanswer++;
+			}
+		}
+
+		if (minanswer > 1)
+		{            // At least two columns with the same first row to '1'.
+			for (col = minind + 1; col < rightCol; col++) {
+				if (vectorIndex[col] == min)
+				{        // Add first column which has '1' in the same row to
+						 // the other columns so they have '0' in this row after
+						 // this operation.
+					coladd(matrixXmY, matrixV, matrixV1, matrixV2, minind, col);
+				}
+			}
+		}
+		else {
+			colexchange(matrixXmY, matrixV, matrixV1, matrixV2, minind, leftCol);
+			leftCol++;
+		}
+	}
+}
+
+int CalcInverseA(const int NumberLengthA, int currentPrime, 
+	PrimeTrialDivisionData *rowPrimeTrialDivisionData) {
+
+	double dRem, dCurrentPrime;
+	const int * const Dividend = biQuadrCoeff;
+
+	// Get A mod current prime.
+	dRem = 0;
+	for (int ix = 1; ix < NumberLengthA; ix++) {
+		dRem += (double)Dividend[ix] * (double)rowPrimeTrialDivisionData->exp[ix-1];
+	}
+	dRem += (double)Dividend[0];
+
+	dCurrentPrime = (double)currentPrime;
+	dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime; // Rem = Rem% Current Prime
+	// Get its inverse
+	int inverseA = intModInv((int)dRem, currentPrime);
+	return inverseA;
+}
+
+/*****************************************************/
+/* Initialization stage for first polynomial of set. */
+/* Must be called with amodqMutex locked.            */
+/* Fills in the shared table firstPrimeSieveData.     */
+/*****************************************************/
+static void InitPolynomialSet(void) {
+	int index, index2;
+	int currentPrime;
+	int D, Q;
+	int *PtrLinearDelta = nullptr;
+	int inverseA, twiceInverseA;
+	int NumberLengthA;
+	int biDividend[MAX_LIMBS_SIQS];
+	PrimeTrialDivisionData *rowPrimeTrialDivisionData;
+
+	oldSeed = newSeed;
+	newSeed = getFactorsOfA(oldSeed, aindex);
+	if (checkpointFile != NULL) {
+		std::lock_guard<std::mutex> lock(matrixBMutex);
+		WriteCheckpoint('S', (int *)&newSeed, 1, NULL, 0);
+	}
+	for (index = 0; index<nbrFactorsA; index++)
+	{                        // Get the values of the factors of A.
+		afact[index] = primeSieveData->value[aindex[index]];
+	}
+
+	// Compute the leading coefficient in biQuadrCoeff.
+	IntToBigNbr(afact[0], biQuadrCoeff, NumberLengthSiqs); // bIQuadrCoeff = afact[0]
+
+	for (index = 1; index < nbrFactorsA; index++) {
+		// BiQuadrCoeff *= afact[index]
+		MultBigNbrByInt(biQuadrCoeff, afact[index], biQuadrCoeff,
+			NumberLengthSiqs);
+	}
+
+	/* adjust NumberLengthA (remove leading zeros) */
+	for (NumberLengthA = NumberLengthSiqs; NumberLengthA >= 2; NumberLengthA--) {
+		if (biQuadrCoeff[NumberLengthA - 1] != 0) {
+			break;
+		}
+	}
+
+	for (index = 0; index < nbrFactorsA; index++) {
+		currentPrime = afact[index];
+		// D = (biQuadrCoeff%(currentPrime*currentPrime))/currentPrime
+		D = RemDivBigNbrByInt(biQuadrCoeff,
+			currentPrime*currentPrime, NumberLengthA) / currentPrime;
+		Q = primeSieveData->modsqrt[aindex[index]] *
+			intModInv(D, currentPrime) % currentPrime;
+		amodq[index] = D << 1;
+		tmodqq[index] = RemDivBigNbrByInt(biModulus,
+			currentPrime*currentPrime, NumberLengthSiqs);
+		if (Q + Q > currentPrime) {
+			Q = currentPrime - Q;
+		}
+		DivBigNbrByInt(biQuadrCoeff, currentPrime, biDividend,
+			NumberLengthA);  // biDividend = biQuadrCoeff/currentPrime
+		MultBigNbrByInt(biDividend, Q, biLinearDelta[index],
+			NumberLengthA);  // biLinearDelta[index] = biDividend * Q
+		for (index2 = NumberLengthA; index2 < NumberLengthSiqs; index2++) {
+			biLinearDelta[index][index2] = 0;
+		}
+	}
+	for (index = 1; index < nbrFactorBasePrimes; index++) {
+		double dRem, dCurrentPrime;
+		rowPrimeTrialDivisionData = &primeTrialDivisionData[index];
+
+
+		currentPrime = rowPrimeTrialDivisionData->value;     // Get current prime.
+		dCurrentPrime = (double)currentPrime;
+
+		// Get A mod current prime.
+		inverseA = CalcInverseA(NumberLengthA, currentPrime, rowPrimeTrialDivisionData);
+
+		twiceInverseA = inverseA << 1;       // and twice this value.
+		dRem = (double)twiceInverseA * (double)primeSieveData->modsqrt[index];
+		dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
+		primeSieveData->difsoln[index] = (int)dRem;
+
+		for (index2 = nbrFactorsA - 1; index2 > 0; index2--) {
+			//memcpy(Dividend, biLinearDelta[index2], sizeof(Dividend));
+			PtrLinearDelta = biLinearDelta[index2];
+			dRem = 0.0;
+			for (int ix = 1; ix < NumberLengthA; ix++) {
+				dRem += (double)PtrLinearDelta[ix] * (double)rowPrimeTrialDivisionData->exp[ix - 1];
+			}
+			dRem += (double)PtrLinearDelta[0];
+			dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
+			dRem *= twiceInverseA;
+			dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
+			primeSieveData->Bainv2[index2 - 1][index] = (int)dRem;
+		}
+
+		//memcpy(Dividend, biLinearDelta[0], sizeof(Dividend));
+		PtrLinearDelta = biLinearDelta[0];
+		dRem = 0;
+		for (int ix = 1; ix < NumberLengthA; ix++) {
+			dRem += (double)PtrLinearDelta[ix] * (double)rowPrimeTrialDivisionData->exp[ix - 1];
+		}
+		dRem += (double)PtrLinearDelta[0];
+		dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
+
+		dRem *= twiceInverseA;
+		dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
+		primeSieveData->Bainv2_0[index] = (int)dRem;
+		if (primeSieveData->Bainv2_0[index] != 0) {
+			primeSieveData->Bainv2_0[index] =
+				currentPrime - primeSieveData->Bainv2_0[index];
+		}
+	}
+
+	for (index2 = 0; index2 < nbrFactorsA; index2++)
+	{
+		primeSieveData->difsoln[aindex[index2]] = -1; // Do not sieve.
+	}
+}
+
+/* scalar scan: test 8 bytes at a time */
+static int SieveScanScalar(const unsigned char *sieve, int nbrBytes, int *hits) {
+	int nbrHits = 0;
+	for (int offset = 0; offset < nbrBytes; offset += 8) {
+		uint64_t bytes;
+		memcpy(&bytes, sieve + offset, sizeof(bytes));
+		if ((bytes & 0x8080808080808080ULL) != 0) {
+			for (int i = 0; i < 8; i++) {
+				if ((sieve[offset + i] & 0x80) != 0) {
+					hits[nbrHits++] = offset + i;
+				}
+			}
+		}
+	}
+	return nbrHits;
+}
+
+#ifdef SIQS_X86_SIMD
+/* store offsets of bits set in mask */
+static inline int SieveScanMask(unsigned int mask, int offset, int *hits, int nbrHits) {
+	unsigned long bit;
+	while (mask != 0) {
+		_BitScanForward(&bit, mask);
+		hits[nbrHits++] = offset + (int)bit;
+		mask &= mask - 1;
+	}
+	return nbrHits;
+}
+
+/* SSE2 scan: 32 bytes at a time using 2 16-byte registers */
+static int SieveScanSSE2(const unsigned char *sieve, int nbrBytes, int *hits) {
+	int nbrHits = 0;
+	for (int offset = 0; offset < nbrBytes; offset += 32) {
+		__m128i low = _mm_loadu_si128((const __m128i *)(sieve + offset));
+		__m128i high = _mm_loadu_si128((const __m128i *)(sieve + offset + 16));
+		unsigned int mask = (unsigned int)_mm_movemask_epi8(low) |
+			((unsigned int)_mm_movemask_epi8(high) << 16);
+		if (mask != 0) {
+			nbrHits = SieveScanMask(mask, offset, hits, nbrHits);
+		}
+	}
+	return nbrHits;
+}
+
+/* AVX2 scan: 32 bytes at a time */
+#if defined(__GNUC__) && !defined(__AVX2__)
+__attribute__((target("avx2")))
+#endif
+static int SieveScanAVX2(const unsigned char *sieve, int nbrBytes, int *hits) {
+	int nbrHits = 0;
+	for (int offset = 0; offset < nbrBytes; offset += 32) {
+		__m256i bytes = _mm256_loadu_si256((const __m256i *)(sieve + offset));
+		unsigned int mask = (unsigned int)_mm256_movemask_epi8(bytes);
+		if (mask != 0) {
+			nbrHits = SieveScanMask(mask, offset, hits, nbrHits);
+		}
+	}
+	return nbrHits;
+}
+#endif
+
+/* return 2 if this CPU (and the OS) supports AVX2, 1 if it supports only
+   SSE2 and 0 otherwise */
+static int SimdSupport(void) {
+#ifdef SIQS_X86_SIMD
+	int cpuInfo[4];
+	__cpuid(cpuInfo, 0);
+	int maxLeaf = cpuInfo[0];
+	__cpuid(cpuInfo, 1);
+	bool sse2 = (cpuInfo[3] & (1 << 26)) != 0;
+	bool osxsave = (cpuInfo[2] & (1 << 27)) != 0;
+	if (osxsave && maxLeaf >= 7 && (_xgetbv(0) & 6) == 6) {
+		/* OS saves the YMM registers */
+		__cpuidex(cpuInfo, 7, 0);
+		if ((cpuInfo[1] & (1 << 5)) != 0) {
+			return 2;
+		}
+	}
+	if (sse2) {
+		return 1;
+	}
+#endif
+	return 0;
+}
+
+/* select the fastest scan function supported by this CPU */
+static SieveScanFunction SelectSieveScan(void) {
+#ifdef SIQS_X86_SIMD
+	switch (SimdSupport()) {
+	case 2:
+		return SieveScanAVX2;
+	case 1:
+		return SieveScanSSE2;
+	}
+#endif
+	return SieveScanScalar;
+}
+
+static void UpdateRootsScalar(const int *prime, int *soln1, const int *Bainv2,
+	int nbrPrimes, bool polyadd) {
+	int index, root;
+	if (polyadd) {
+		for (index = 0; index < nbrPrimes; index++) {
+			root = soln1[index] - Bainv2[index];
+			soln1[index] = root + (prime[index] & (root >> 31));
+		}
+	}
+	else {
+		for (index = 0; index < nbrPrimes; index++) {
+			root = soln1[index] + Bainv2[index] - prime[index];
+			soln1[index] = root + (prime[index] & (root >> 31));
+		}
+	}
+}
+
+#ifdef SIQS_X86_SIMD
+/* SSE2 root update: 4 primes at a time */
+static void UpdateRootsSSE2(const int *prime, int *soln1, const int *Bainv2,
+	int nbrPrimes, bool polyadd) {
+	int index = 0;
+	for (; index + 4 <= nbrPrimes; index += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i *)(prime + index));
+		__m128i root = _mm_loadu_si128((const __m128i *)(soln1 + index));
+		__m128i b = _mm_loadu_si128((const __m128i *)(Bainv2 + index));
+		root = (polyadd ? _mm_sub_epi32(root, b) :
+			_mm_sub_epi32(_mm_add_epi32(root, b), p));
+		root = _mm_add_epi32(root, _mm_and_si128(p, _mm_srai_epi32(root, 31)));
+		_mm_storeu_si128((__m128i *)(soln1 + index), root);
+	}
+	UpdateRootsScalar(prime + index, soln1 + index, Bainv2 + index,
+		nbrPrimes - index, polyadd);
+}
+
+/* AVX2 root update: 8 primes at a time */
+#if defined(__GNUC__) && !defined(__AVX2__)
+__attribute__((target("avx2")))
+#endif
+static void UpdateRootsAVX2(const int *prime, int *soln1, const int *Bainv2,
+	int nbrPrimes, bool polyadd) {
+	int index = 0;
+	for (; index + 8 <= nbrPrimes; index += 8) {
+		__m256i p = _mm256_loadu_si256((const __m256i *)(prime + index));
+		__m256i root = _mm256_loadu_si256((const __m256i *)(soln1 + index));
+		__m256i b = _mm256_loadu_si256((const __m256i *)(Bainv2 + index));
+		root = (polyadd ? _mm256_sub_epi32(root, b) :
+			_mm256_sub_epi32(_mm256_add_epi32(root, b), p));
+		root = _mm256_add_epi32(root, _mm256_and_si256(p, _mm256_srai_epi32(root, 31)));
+		_mm256_storeu_si256((__m256i *)(soln1 + index), root);
+	}
+	UpdateRootsScalar(prime + index, soln1 + index, Bainv2 + index,
+		nbrPrimes - index, polyadd);
+}
+#endif
+
+/* select the fastest root update function supported by this CPU */
+static RootUpdateFunction SelectRootUpdate(void) {
+#ifdef SIQS_X86_SIMD
+	switch (SimdSupport()) {
+	case 2:
+		return UpdateRootsAVX2;
+	case 1:
+		return UpdateRootsSSE2;
+	}
+#endif
+	return UpdateRootsScalar;
+}
+
+static void AddPatternScalar(short *sieve, int nbrElements, const short *pattern,
+	int period) {
+	int offset = 0;
+	for (int index = 0; index < nbrElements; index++) {
+		sieve[index] += pattern[offset];
+		if (++offset == period) {
+			offset = 0;
 		}
+	}
+}
 
-		// At this moment all columns from leftCol to rightCol are non-zero.
-		// Get the first row that includes a '1'.
-		min = vectorIndex[leftCol];
-		minind = leftCol;
-		for (col = leftCol + 1; col < rightCol; col++) {
-			if (vectorIndex[col] < min) {
-				min = vectorIndex[col];
-				minind = col;
-			}
+#ifdef SIQS_X86_SIMD
+/* SSE2 pattern add: 8 elements at a time */
+static void AddPatternSSE2(short *sieve, int nbrElements, const short *pattern,
+	int period) {
+	int index = 0;
+	int offset = 0;
+	for (; index + 8 <= nbrElements; index += 8) {
+		__m128i values = _mm_loadu_si128((const __m128i *)(sieve + index));
+		values = _mm_add_epi16(values, _mm_loadu_si128((const __m128i *)(pattern + offset)));
+		_mm_storeu_si128((__m128i *)(sieve + index), values);
+		offset += 8;
+		while (offset >= period) {
+			offset -= period;
 		}
+	}
+	for (; index < nbrElements; index++) {
+		sieve[index] += pattern[offset++];
+	}
+}
 
-		minanswer = 0;
-		for (col = leftCol; col < rightCol; col++) {
-			if (vectorIndex[col] == min) {
-				minanswer++;
-			}
+/* AVX2 pattern add: 16 elements at a time */
+#if defined(__GNUC__) && !defined(__AVX2__)
+__attribute__((target("avx2")))
+#endif
+static void AddPatternAVX2(short *sieve, int nbrElements, const short *pattern,
+	int period) {
+	int index = 0;
+	int offset = 0;
+	for (; index + 16 <= nbrElements; index += 16) {
+		__m256i values = _mm256_loadu_si256((const __m256i *)(sieve + index));
+		values = _mm256_add_epi16(values, _mm256_loadu_si256((const __m256i *)(pattern + offset)));
+		_mm256_storeu_si256((__m256i *)(sieve + index), values);
+		offset += 16;
+		while (offset >= period) {
+			offset -= period;
 		}
+	}
+	for (; index < nbrElements; index++) {
+		sieve[index] += pattern[offset++];
+	}
+}
+#endif
 
-		if (minanswer > 1) {    // Two columns with the same first row to '1'.
-			for (col = minind + 1; col < rightCol; col++) {
-				if (vectorIndex[col] == min)
-				{        // Add first column which has '1' in the same row to
-						 // the other columns so they have '0' in this row after
-						 // this operation.
-					coladd(matrixXmY, matrixV, matrixV1, matrixV2, minind, col);
-				}
-			}
+/* select the fastest pattern add function supported by this CPU */
+static PatternAddFunction SelectPatternAdd(void) {
+#ifdef SIQS_X86_SIMD
+	switch (SimdSupport()) {
+	case 2:
+		return AddPatternAVX2;
+	case 1:
+		return AddPatternSSE2;
+	}
+#endif
+	return AddPatternScalar;
+}
+
+/* low 64 bits of a * b, the high 64 bits are stored in high */
+static inline uint64_t MulWide(uint64_t a, uint64_t b, uint64_t &high) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	return _umul128(a, b, &high);
+#elif defined(__SIZEOF_INT128__)
+	unsigned __int128 product = (unsigned __int128)a * b;
+	high = (uint64_t)(product >> 64);
+	return (uint64_t)product;
+#else
+	uint64_t aLo = (uint32_t)a, aHi = a >> 32, bLo = (uint32_t)b, bHi = b >> 32;
+	uint64_t mid1 = aHi * bLo, mid2 = aLo * bHi, low = aLo * bLo;
+	uint64_t mid = (low >> 32) + (uint32_t)mid1 + (uint32_t)mid2;
+	high = aHi * bHi + (mid1 >> 32) + (mid2 >> 32) + (mid >> 32);
+	return (mid << 32) | (uint32_t)low;
+#endif
+}
+
+/* number of 64-bit words needed for L 31-bit limbs */
+template <int L>
+struct FixedWords {
+	static const int W = (BITS_PER_INT_GROUP * L + 63) / 64;
+};
+
+/* convert L 31-bit limbs (the most significant one holds the sign) to 
+   64-bit words in two's complement */
+template <int L>
+static inline void LimbsToWords(const int *limbs, uint64_t *words) {
+	const int W = FixedWords<L>::W;
+	const int numLen = L;
+	int64_t top = limbs[numLen - 1];
+	int pos = BITS_PER_INT_GROUP * (numLen - 1);
+	int index;
+
+	for (index = 0; index < W; index++) {
+		words[index] = 0;
+	}
+	for (index = 0; index < numLen - 1; index++) {
+		uint64_t limb = (uint32_t)limbs[index] & MAX_INT_NBR;
+		int bit = BITS_PER_INT_GROUP * index;
+		words[bit / 64] |= limb << (bit % 64);
+		if (bit % 64 > 64 - BITS_PER_INT_GROUP) {
+			words[bit / 64 + 1] |= limb >> (64 - bit % 64);
 		}
-		else {
-			rightCol--;
-			colexchange(matrixXmY, matrixV, matrixV1, matrixV2, minind, rightCol);
+	}
+	words[pos / 64] |= (uint64_t)top << (pos % 64);
+	if (pos / 64 + 1 < W) {
+		words[pos / 64 + 1] = (uint64_t)(pos % 64 == 0 ? top >> 63 : top >> (64 - pos % 64));
+		for (index = pos / 64 + 2; index < W; index++) {
+			words[index] = (uint64_t)(top >> 63);
 		}
 	}
+}
 
-	leftCol = 0; /* find linear independent solutions */
-	while (leftCol < rightCol) {
-		for (col = leftCol; col < rightCol; col++)
-		{         // For each column find the first row which has a '1'.
-			matr = (col >= 32 ? matrixXmY : matrixV);
-			mask = 0x80000000 >> (col & 31);
-			vectorIndex[col] = -1;    // indicate all rows in zero in advance.
-			for (row = 0; row < matrixBLength; row++) {
-				if ((matr[row] & mask) != 0)
-				{         // First row for this mask is found. Store it.
-					vectorIndex[col] = row;
-					break;
-				}
-			}
+/* convert 64-bit words in two's complement to L 31-bit limbs */
+template <int L>
+static inline void WordsToLimbs(const uint64_t *words, int *limbs) {
+	const int W = FixedWords<L>::W;
+	const int numLen = L;
+	for (int index = 0; index < numLen; index++) {
+		int bit = BITS_PER_INT_GROUP * index;
+		uint64_t value = words[bit / 64] >> (bit % 64);
+		if (bit % 64 != 0) {
+			value |= (bit / 64 + 1 < W ? words[bit / 64 + 1] :
+				(uint64_t)((int64_t)words[W - 1] >> 63)) << (64 - bit % 64);
 		}
+		limbs[index] = (index < numLen - 1 ? (int)(value & MAX_INT_NBR) : (int)value);
+	}
+}
 
-		for (col = leftCol; col < rightCol; col++)
-		{  // If all zeros in col 'col', exchange it with last column with
-		   // data different from zero (rightCol).
-			if (vectorIndex[col] < 0) {
-				rightCol--;                 // Update rightCol to exclude that column.
-				colexchange(matrixXmY, matrixV, matrixV1, matrixV2, rightCol, col);
-				vectorIndex[col] = vectorIndex[rightCol];
-				vectorIndex[rightCol] = -1; // This column now has zeros.
-			}
-		}
+template <int W>
+static inline void NegateWords(uint64_t *words) {
+	uint64_t carry = 1;
+	for (int index = 0; index < W; index++) {
+		words[index] = ~words[index] + carry;
+		carry = (carry != 0 && words[index] == 0);
+	}
+}
 
-		if (leftCol == rightCol) {
-			break;  // exit from while loop
-		}
+/* sum += addend (subtract = false) or sum -= addend (subtract = true) */
+template <int W>
+static inline void AddWords(uint64_t *sum, const uint64_t *addend, bool subtract) {
+	uint64_t carry = 0;
+	for (int index = 0; index < W; index++) {
+		uint64_t value = (subtract ? ~addend[index] : addend[index]);
+		uint64_t partial = sum[index] + value;
+		uint64_t carryOut = (partial < value);
+		sum[index] = partial + (subtract && index == 0 ? 1 : carry);
+		carry = carryOut | (sum[index] < partial);
+	}
+}
 
-		// At this moment all columns from leftCol to rightCol are non-zero.
-		// Get the first row that includes a '1'.
-		min = vectorIndex[leftCol];
-		minind = leftCol;
-		for (col = leftCol + 1; col < rightCol; col++) {
-			if (vectorIndex[col] < min) {
-				min = vectorIndex[col];
-				minind = col;
-			}
-		}
+template <int L>
+static void CandidateValueFixed(const int *biLinearCoeff, int x,
+	bool oddPolynomial, int /*numLen*/, int *biT, int *biDividend) {
+	const int W = FixedWords<L>::W;
+	uint64_t A[W], B[W], T[W], square[W], high, carry;
+	int i, j;
 
-		minanswer = 0;
-		for (col = leftCol; col < rightCol; col++) {
-			if (vectorIndex[col] == min) {
-				minanswer++;
-			}
+	LimbsToWords<L>(biQuadrCoeff, A);
+	LimbsToWords<L>(biLinearCoeff, B);
+	carry = 0;                                   // T = A*|x|
+	for (i = 0; i < W; i++) {
+		T[i] = MulWide(A[i], (uint64_t)(x < 0 ? -(int64_t)x : x), high) + carry;
+		carry = high + (T[i] < carry);
+	}
+	if (x < 0) {
+		NegateWords<W>(T);
+	}
+	AddWords<W>(T, B, false);                    // Ax+B
+	if (oddPolynomial) {
+		LimbsToWords<L>(biLinearDelta[0], B);
+		AddWords<W>(T, B, true);
+		AddWords<W>(T, B, true);
+	}
+	WordsToLimbs<L>(T, biT);
+	if ((int64_t)T[W - 1] < 0) {
+		NegateWords<W>(T);                       // the sign does not change the square
+	}
+	for (i = 0; i < W; i++) {
+		square[i] = 0;
+	}
+	for (i = 0; i < W; i++) {                    // low W words of T^2
+		carry = 0;
+		for (j = 0; i + j < W; j++) {
+			uint64_t low = MulWide(T[i], T[j], high);
+			low += carry;
+			high += (low < carry);
+			square[i + j] += low;
+			carry = high + (square[i + j] < low);
 		}
+	}
+	LimbsToWords<L>(biModulus, A);
+	AddWords<W>(square, A, true);                // (Ax+B)^2 - kN
+	WordsToLimbs<L>(square, biDividend);
+}
 
-		if (minanswer > 1)
-		{            // At least two columns with the same first row to '1'.
-			for (col = minind + 1; col < rightCol; col++) {
-				if (vectorIndex[col] == min)
-				{        // Add first column which has '1' in the same row to
-						 // the other columns so they have '0' in this row after
-						 // this operation.
-					coladd(matrixXmY, matrixV, matrixV1, matrixV2, minind, col);
+static void CandidateValueGeneric(const int *biLinearCoeff, int x,
+	bool oddPolynomial, int numLen, int *biT, int *biDividend) {
+	MultBigNbrByInt(biQuadrCoeff, x, biT, numLen);  // Ax
+	AddBigNbrB(biT, biLinearCoeff, biT, numLen);    // Ax+B
+	if (oddPolynomial)
+	{                                               // Ax+B (odd)
+		SubtractBigNbr(biT, biLinearDelta[0], biT, numLen);
+		SubtractBigNbr(biT, biLinearDelta[0], biT, numLen);
+	}
+	MultBigNbr(biT, biT, biDividend, numLen);       // (Ax+B)^2
+	SubtractBigNbrB(biDividend, biModulus, biDividend, numLen);  // (Ax+B)^2-N
+}
+
+/* B = B + 2*delta or B - 2*delta in a single pass over L limbs */
+template <int L>
+static void UpdateLinearCoeffFixed(int *biLinearCoeff, const int *biDelta,
+	bool polyadd, int /*numLen*/) {
+	int64_t carry = 0;
+	int64_t delta2;
+
+	for (int index = 0; index < L - 1; index++) {
+		delta2 = 2 * (int64_t)biDelta[index];
+		carry = (carry >> BITS_PER_INT_GROUP) + biLinearCoeff[index] +
+			(polyadd ? delta2 : -delta2);
+		biLinearCoeff[index] = (int)(carry & MAX_INT_NBR);
+	}
+	delta2 = 2 * (int64_t)biDelta[L - 1];
+	carry = (carry >> BITS_PER_INT_GROUP) + biLinearCoeff[L - 1] +
+		(polyadd ? delta2 : -delta2);
+	biLinearCoeff[L - 1] = (int)carry;   // last limb is not masked
+}
+
+static void UpdateLinearCoeffGeneric(int *biLinearCoeff, const int *biDelta,
+	bool polyadd, int numLen) {
+	if (polyadd) {
+		AddBigNbrB(biLinearCoeff, biDelta, biLinearCoeff, numLen);
+		AddBigNbrB(biLinearCoeff, biDelta, biLinearCoeff, numLen);
+	}
+	else {
+		SubtractBigNbrB(biLinearCoeff, biDelta, biLinearCoeff, numLen);
+		SubtractBigNbrB(biLinearCoeff, biDelta, biLinearCoeff, numLen);
+	}
+}
+
+/* select the fixed width functions for numbers of numLen limbs */
+static void SelectFixedWidth(int numLen) {
+	static const CandidateValueFunction candidateValue[] = {
+		CandidateValueFixed<6>, CandidateValueFixed<7>, CandidateValueFixed<8>,
+		CandidateValueFixed<9>, CandidateValueFixed<10>, CandidateValueFixed<11>,
+		CandidateValueFixed<12>, CandidateValueFixed<13>, CandidateValueFixed<14> };
+	static const CoeffUpdateFunction updateLinearCoeff[] = {
+		UpdateLinearCoeffFixed<6>, UpdateLinearCoeffFixed<7>, UpdateLinearCoeffFixed<8>,
+		UpdateLinearCoeffFixed<9>, UpdateLinearCoeffFixed<10>, UpdateLinearCoeffFixed<11>,
+		UpdateLinearCoeffFixed<12>, UpdateLinearCoeffFixed<13>, UpdateLinearCoeffFixed<14> };
+
+	if (numLen >= FIXED_LIMBS_MIN && numLen <= FIXED_LIMBS_MAX) {
+		CandidateValue = candidateValue[numLen - FIXED_LIMBS_MIN];
+		UpdateLinearCoeff = updateLinearCoeff[numLen - FIXED_LIMBS_MIN];
+	}
+	else {
+		CandidateValue = CandidateValueGeneric;
+		UpdateLinearCoeff = UpdateLinearCoeffGeneric;
+	}
+}
+
+/* Resieve the primes from resieveFirst onwards and record, for each
+   candidate, the indexes of the primes that hit it (in ascending order).
+   The sieve array itself tells whether a location is a candidate, so the
+   list of candidates is only searched for actual hits. */
+static void ResieveCandidates(const PrimeSieveData *primeSieveData,
+	const unsigned char *sieve, const int *hits, int nbrHits,
+	std::vector<std::vector<int>> &resievedPrimes)
+{
+	int X1 = SieveLimit << 1;
+	int index, currentPrime, root, rootIndex, offset;
+	int roots[4];
+
+	if ((int)resievedPrimes.size() < nbrHits) {
+		resievedPrimes.resize(nbrHits);
+	}
+	for (index = 0; index < nbrHits; index++) {
+		resievedPrimes[index].clear();
+	}
+	for (index = resieveFirst; index < nbrFactorBasePrimes; index++) {
+		if (primeSieveData->difsoln[index] < 0) {
+			continue;       // Factor of A: tested by trial division.
+		}
+		currentPrime = primeSieveData->value[index];
+		roots[0] = primeSieveData->soln1[index];             // even polynomial
+		roots[1] = roots[0] - primeSieveData->Bainv2_0[index];      // odd polynomial
+		roots[1] += currentPrime & (roots[1] >> 31);
+		roots[2] = roots[0] - primeSieveData->difsoln[index];       // even polynomial
+		roots[2] += currentPrime & (roots[2] >> 31);
+		roots[3] = roots[2] - primeSieveData->Bainv2_0[index];      // odd polynomial
+		roots[3] += currentPrime & (roots[3] >> 31);
+		// If the prime divides kN, both roots are the same.
+		for (rootIndex = 0; rootIndex < (primeSieveData->difsoln[index] == 0 ? 2 : 4); rootIndex++) {
+			for (root = roots[rootIndex]; root < X1; root += currentPrime) {
+				offset = 2 * root + (rootIndex & 1);
+				if ((sieve[offset] & 0x80) != 0) {
+					resievedPrimes[std::lower_bound(hits, hits + nbrHits, offset) - hits].push_back(index);
 				}
 			}
 		}
-		else {
-			colexchange(matrixXmY, matrixV, matrixV1, matrixV2, minind, leftCol);
-			leftCol++;
-		}
 	}
 }
 
-int CalcInverseA(const int NumberLengthA, int currentPrime, 
-	PrimeTrialDivisionData *rowPrimeTrialDivisionData) {
-
-	double dRem, dCurrentPrime;
-	const int * const Dividend = biQuadrCoeff;
+/* get a table with count elements at offset used from the start of the 
+   arena, then advance used to the next multiple of 64 bytes (cache line).
+   Returns NULL if there is no arena yet. */
+template <typename T>
+static T *ArenaAlloc(char *base, size_t &used, size_t count) {
+	T *table = (base == NULL ? NULL : (T *)(base + used));
+	used += (count * sizeof(T) + 63) & ~(size_t)63;
+	return table;
+}
 
-	// Get A mod current prime.
-	dRem = 0;
-	for (int ix = 1; ix < NumberLengthA; ix++) {
-		dRem += (double)Dividend[ix] * (double)rowPrimeTrialDivisionData->exp[ix-1];
+/* point the SIQS tables to the arena (which starts at base) and return the
+   number of bytes needed for a factor base with nbrPrimes primes. If base 
+   is NULL, only the size is computed and the pointers are set to NULL. */
+static size_t SetSiqsTables(char *base, int nbrPrimes) {
+	size_t used = 0;
+	int rowsAlloc = nbrPrimes + 50;      // same as matrixBLength
+
+	primeSieveData = (base == NULL ? NULL : &sieveDataTables);
+	sieveDataTables.value = ArenaAlloc<int>(base, used, nbrPrimes + 3);
+	sieveDataTables.modsqrt = ArenaAlloc<int>(base, used, nbrPrimes + 3);
+	for (int j = 0; j < MAX_NBR_FACTORS; j++) {
+		sieveDataTables.Bainv2[j] = ArenaAlloc<int>(base, used, nbrPrimes + 3);
 	}
-	dRem += (double)Dividend[0];
-
-	dCurrentPrime = (double)currentPrime;
-	dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime; // Rem = Rem% Current Prime
-	// Get its inverse
-	int inverseA = intModInv((int)dRem, currentPrime);
-	return inverseA;
+	sieveDataTables.Bainv2_0 = ArenaAlloc<int>(base, used, nbrPrimes + 3);
+	sieveDataTables.soln1 = ArenaAlloc<int>(base, used, nbrPrimes + 3);
+	sieveDataTables.difsoln = ArenaAlloc<int>(base, used, nbrPrimes + 3);
+	primeTrialDivisionData = ArenaAlloc<PrimeTrialDivisionData>(base, used, nbrPrimes + 3);
+	vectLeftHandSide = ArenaAlloc<int[MAX_FACTORS_RELATION]>(base, used, rowsAlloc);
+	matrixB = ArenaAlloc<int[MAX_FACTORS_RELATION]>(base, used, rowsAlloc);
+	vectExpParity = ArenaAlloc<int>(base, used, rowsAlloc);
+	matrixAV = ArenaAlloc<uint64_t>(base, used, rowsAlloc);
+	matrixV = ArenaAlloc<uint64_t>(base, used, rowsAlloc);
+	matrixV1 = ArenaAlloc<uint64_t>(base, used, rowsAlloc);
+	matrixV2 = ArenaAlloc<uint64_t>(base, used, rowsAlloc);
+	matrixXmY = ArenaAlloc<uint64_t>(base, used, rowsAlloc);
+	newColumns = ArenaAlloc<int>(base, used, rowsAlloc);
+	matrixCalc3 = ArenaAlloc<uint64_t>(base, used, rowsAlloc);
+	matrixTemp2 = ArenaAlloc<uint64_t>(base, used, rowsAlloc);
+	return used;
 }
 
 /*********************************/
 /* Sieve thread                  */
-/* return factor found in result */
+/* Each thread has its own copy  */
+/* of the sieve data & sieves    */
+/* its own range of polynomials  */
+/* from each set.                */
 /*********************************/
-static void sieveThread(Znum &result) {
+static void sieveThread(int threadNumber) {
 	int polySet;
 	int biT[MAX_LIMBS_SIQS] = { 0 };
 	int biU[MAX_LIMBS_SIQS] = { 0 };
 	int biV[MAX_LIMBS_SIQS] = { 0 };
 	int biR[MAX_LIMBS_SIQS] = { 0 };
-	//  int multiplier = this.multiplier;
-	PrimeSieveData *rowPrimeSieveData;
-	PrimeSieveData *rowPrimeSieveData0;
 	PrimeTrialDivisionData *rowPrimeTrialDivisionData;
-	short SieveArray[2 * MAX_SIEVE_LIMIT];
 	int rowPartials[200];
 	int biLinearCoeff[MAX_LIMBS_SIQS];
-	//  int threadNumber = this.threadNumber;
 	int biDividend[MAX_LIMBS_SIQS];
 	int biAbsLinearCoeff[MAX_LIMBS_SIQS];
 	int indexFactorsA[50];
@@ -3332,233 +6131,107 @@ static void sieveThread(Znum &result) {
 	firstPolynomial |= 1;
 	int grayCode = firstPolynomial ^ (firstPolynomial >> 1);
 	firstPolynomial++;
-	int i, PolynomialIndex, index, index2;
+	int i, PolynomialIndex;
 	int currentPrime;
-	int RemB, D, Q;
-	int *PtrLinearDelta = nullptr;
+	int RemB;
 	int rowMatrixBbeforeMerge[200];
 	int rowMatrixB[200];
 	unsigned char positive;
-	int inverseA, twiceInverseA;
+	int inverseA;
 	int NumberLengthA, NumberLengthB;
+	/* soln1 is updated for every polynomial, so each thread needs its own
+	   copy of the roots. Values that are the same for all polynomials 
+	   in a set are copied from firstPrimeSieveData. */
+	int nbrSieveData = nbrFactorBasePrimes + 3;
+	std::vector<int> threadSieveArrays((MAX_NBR_FACTORS + 3) * (size_t)nbrSieveData);
+	PrimeSieveData threadSieveData = *firstPrimeSieveData;  // primes are shared
+	PrimeSieveData *primeSieveData = &threadSieveData;
+	threadSieveData.soln1 = &threadSieveArrays[0];
+	threadSieveData.difsoln = &threadSieveArrays[nbrSieveData];
+	threadSieveData.Bainv2_0 = &threadSieveArrays[2 * nbrSieveData];
+	for (i = 0; i < MAX_NBR_FACTORS; i++) {
+		threadSieveData.Bainv2[i] = &threadSieveArrays[(i + 3) * nbrSieveData];
+	}
+	/* the sieve array is on the heap, so the thread does not depend on the
+	   default stack size */
+	std::vector<short> sieveArrayBuffer(2 * SieveLimit + sieveArraySlack);
+	short *SieveArray = &sieveArrayBuffer[0];
+	std::vector<int> sieveHits(2 * 2 * SieveLimit);
+	int nbrHits;
+	std::vector<std::vector<int>> resievedPrimes;   // for each candidate
+	bool resieve;
+	SieveBuckets buckets;
+	if (bucketLimit < nbrFactorBasePrimes) {
+		int nbrBlocks = ((2 * SieveLimit) >> sieveBlockBits) + 1;
+		buckets.entries.resize(nbrBlocks * bucketSize);
+		for (i = 0; i < nbrBlocks; i++) {
+			buckets.end.push_back(&buckets.entries[i * bucketSize]);
+		}
+	}
 
 	memset(biLinearCoeff, 0, sizeof(biLinearCoeff));
-	//  synchronized(amodq)
-	{
-		if (threadNumber == 0) 	{
-			//      primeSieveData = this.primeSieveData;
-		}
-		else {
-			for (i = 0; i<nbrFactorBasePrimes; i++) {
-				rowPrimeSieveData = &primeSieveData[i];
-				rowPrimeSieveData0 = &primeSieveData[i];
-				rowPrimeSieveData->value = rowPrimeSieveData0->value;
-				rowPrimeSieveData->modsqrt = rowPrimeSieveData0->modsqrt;
-				memcpy(rowPrimeSieveData->Bainv2, rowPrimeSieveData0->Bainv2, sizeof(rowPrimeSieveData0->Bainv2));
-			}
-		}
-		//    threadArray[threadNumber] = Thread.currentThread();
-		//    amodq.notifyAll();
-	}               // End synchronized block.
 
 	for (polySet = 1;; polySet++) {  // For each polynomial set...
-		//if (getTerminateThread())
-		//{
-		//  throw new ArithmeticException();
-		//}
-		//synchronized(amodq)
 		{
+			std::unique_lock<std::mutex> lock(amodqMutex);  // synchronized(amodq)
 			nbrThreadFinishedPolySet++;
-			if (congruencesFound >= matrixBLength/* || factorSiqs != null*/)
-			{
-				if (nbrThreadFinishedPolySet < polySet * numberThreads) {
-					return;
-				}
-				if (1 /* factorSiqs == null */ ) {
-					while (!LinearAlgebraPhase(biT, biR, biU, NumberLength));
-
-					//BigNbrToBigInt(*result, biT, NumberLength);  // Factor found.
-					ValuestoZ(result, biT, NumberLength); // Factor found. copy its value to result
-#if 0
-					synchronized(matrixB)
-					{
-						factorSiqs = result;
-						matrixB.notify();
-					}
-#endif
-				}
-				else {
-#if 0
-					synchronized(matrixB)
-					{
-						matrixB.notify();
-					}
-#endif
-				}
-
+			if (congruencesFound >= matrixBLength) {
+				polySetReady.notify_all();   // wake up threads waiting for next set
 				return;
 			}
-
 			if (nbrThreadFinishedPolySet == polySet * numberThreads) {
-				/*********************************************/
-				/* Initialization stage for first polynomial */
-				/*********************************************/
-				firstPrimeSieveData = primeSieveData;
-				oldSeed = newSeed;
-				newSeed = getFactorsOfA(oldSeed, aindex);
-				for (index = 0; index<nbrFactorsA; index++)
-				{                        // Get the values of the factors of A.
-					afact[index] = primeSieveData[aindex[index]].value;
-				}
-
-				// Compute the leading coefficient in biQuadrCoeff.
-				IntToBigNbr(afact[0], biQuadrCoeff, NumberLength); // bIQuadrCoeff = afact[0]
-
-				for (index = 1; index < nbrFactorsA; index++) {
-					// BiQuadrCoeff *= afact[index]
-					MultBigNbrByInt(biQuadrCoeff, afact[index], biQuadrCoeff,
-						NumberLength);
-				}
-
-				/* adjust NumberLengthA (remove leading zeros) */
-				for (NumberLengthA = NumberLength; NumberLengthA >= 2; NumberLengthA--) {
-					if (biQuadrCoeff[NumberLengthA - 1] != 0) {
-						break;
-					}
-				}
-
-				for (index = 0; index < nbrFactorsA; index++) {
-					currentPrime = afact[index];
-					// D = (biQuadrCoeff%(currentPrime*currentPrime))/currentPrime
-					D = RemDivBigNbrByInt(biQuadrCoeff,
-						currentPrime*currentPrime, NumberLengthA) / currentPrime;
-					Q = primeSieveData[aindex[index]].modsqrt *
-						intModInv(D, currentPrime) % currentPrime;
-					amodq[index] = D << 1;
-					tmodqq[index] = RemDivBigNbrByInt(biModulus,
-						currentPrime*currentPrime, NumberLength);
-					if (Q + Q > currentPrime) {
-						Q = currentPrime - Q;
-					}
-					DivBigNbrByInt(biQuadrCoeff, currentPrime, biDividend,
-						NumberLengthA);  // biDividend = biQuadrCoeff/currentPrime
-					MultBigNbrByInt(biDividend, Q, biLinearDelta[index],
-						NumberLengthA);  // biLinearDelta[index] = biDividend * Q
-					for (index2 = NumberLengthA; index2 < NumberLength; index2++) {
-						biLinearDelta[index][index2] = 0;
-					}
-				}
-				for (index = 1; index < nbrFactorBasePrimes; index++) {
-					double dRem, dCurrentPrime;
-					rowPrimeTrialDivisionData = &primeTrialDivisionData[index];
-					rowPrimeSieveData = &primeSieveData[index];
-
-
-					currentPrime = rowPrimeTrialDivisionData->value;     // Get current prime.
-					dCurrentPrime = (double)currentPrime;
-
-					// Get A mod current prime.
-					inverseA = CalcInverseA(NumberLengthA, currentPrime, rowPrimeTrialDivisionData);
-
-					twiceInverseA = inverseA << 1;       // and twice this value.
-					dRem = (double)twiceInverseA * (double)rowPrimeSieveData->modsqrt;
-					dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
-					rowPrimeSieveData->difsoln = (int)dRem;
-
-					for (index2 = nbrFactorsA - 1; index2 > 0; index2--) {
-						//memcpy(Dividend, biLinearDelta[index2], sizeof(Dividend));
-						PtrLinearDelta = biLinearDelta[index2];
-						dRem = 0.0;
-						for (int ix = 1; ix < NumberLengthA; ix++) {
-							dRem += (double)PtrLinearDelta[ix] * (double)rowPrimeTrialDivisionData->exp[ix - 1];
-						}
-						dRem += (double)PtrLinearDelta[0];
-						dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
-						dRem *= twiceInverseA;
-						dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
-						rowPrimeSieveData->Bainv2[index2 - 1] = (int)dRem;
-					}
-
-					//memcpy(Dividend, biLinearDelta[0], sizeof(Dividend));
-					PtrLinearDelta = biLinearDelta[0];
-					dRem = 0;
-					for (int ix = 1; ix < NumberLengthA; ix++) {
-						dRem += (double)PtrLinearDelta[ix] * (double)rowPrimeTrialDivisionData->exp[ix - 1];
+				// all threads have finished previous set. 
+				if (siqsFarmSize > 0 &&
+					SecondsSince(farmLastPoll) >= FARM_POLL_SECONDS) {
+					farmLastPoll = std::chrono::steady_clock::now();
+					if (ReadFarmState(farmFactor) != FARM_SIEVING) {
+						farmStopped = true;   // merge process has enough relations
+						congruencesFound = matrixBLength;   // stop all threads
+						polySetReady.notify_all();
+						return;
 					}
-					dRem += (double)PtrLinearDelta[0];
-					dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
-
-					dRem *= twiceInverseA;
-					dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
-					rowPrimeSieveData->Bainv2_0 = (int)dRem;
-					if (rowPrimeSieveData->Bainv2_0 != 0) {
-						rowPrimeSieveData->Bainv2_0 =
-							currentPrime - rowPrimeSieveData->Bainv2_0;
-					}
-				}
-
-				for (index2 = 0; index2 < nbrFactorsA; index2++)
-				{
-					primeSieveData[aindex[index2]].difsoln = -1; // Do not sieve.
-				}
-				//synchronized(TestNbr2)
-				{
-					//TestNbr2.notifyAll();
-				}
-			}           // End initializing first polynomial
-		}             // End synchronized
-#if 0
-		synchronized(TestNbr2)
-		{
-			while (nbrThreadFinishedPolySet < polySet * numberThreads)
-			{
-				try
-				{
-					TestNbr2.wait();
 				}
-				catch (InterruptedException ie) {}
+				InitPolynomialSet();
+				polySetReady.notify_all();
 			}
-		}
-#endif
-		if (/*factorSiqs != null ||*/ congruencesFound >= matrixBLength)
-		{
-			if (nbrThreadFinishedPolySet > numberThreads*polySet)
-			{
-				continue;
-			}
-			//synchronized(amodq)
-			{
-				nbrThreadFinishedPolySet++;
+			else {
+				// wait until last thread has initialised this set
+				polySetReady.wait(lock, [polySet] {
+					return nbrThreadFinishedPolySet >= polySet * numberThreads ||
+						congruencesFound >= matrixBLength; });
+				if (congruencesFound >= matrixBLength) {
+					return;
+				}
 			}
-			return;
-		}
+		}             // End synchronized
+
 		PolynomialIndex = firstPolynomial;
 		// Compute first polynomial parameters.
-		for (i = 0; i<NumberLength; i++) {
+		for (i = 0; i<NumberLengthSiqs; i++) {
 			biLinearCoeff[i] = biLinearDelta[0][i];
 		}
 
 		for (i = 1; i<nbrFactorsA; i++) {
 			if ((grayCode & (1 << i)) == 0) {
 				// biLenearCoeff += biLinearDelta[i];
-				AddBigNbrB(biLinearCoeff, biLinearDelta[i], biLinearCoeff, NumberLength);
+				AddBigNbrB(biLinearCoeff, biLinearDelta[i], biLinearCoeff, NumberLengthSiqs);
 			}
 			else {
 				// biLenearCoeff -= biLinearDelta[i];
-				SubtractBigNbrB(biLinearCoeff, biLinearDelta[i], biLinearCoeff, NumberLength);
+				SubtractBigNbrB(biLinearCoeff, biLinearDelta[i], biLinearCoeff, NumberLengthSiqs);
 			}
 		}
 
-		for (NumberLengthA = NumberLength; NumberLengthA >= 2; NumberLengthA--) {
+		for (NumberLengthA = NumberLengthSiqs; NumberLengthA >= 2; NumberLengthA--) {
 			if (biQuadrCoeff[NumberLengthA - 1] != 0) {
 				break;  // Go out if significant limb.
 			}
 		}
-		if ((uint32_t)biLinearCoeff[NumberLength - 1] >= (uint32_t)LIMB_RANGE)
+		if ((uint32_t)biLinearCoeff[NumberLengthSiqs - 1] >= (uint32_t)LIMB_RANGE)
 		{                               // Number is negative.
 			positive = false;
-			memcpy(biT, biLinearCoeff, NumberLength * sizeof(biT[0]));
-			ChSignBigNbr(biT, NumberLength);   // Make it positive.
+			memcpy(biT, biLinearCoeff, NumberLengthSiqs * sizeof(biT[0]));
+			ChSignBigNbr(biT, NumberLengthSiqs);   // Make it positive.
 			memcpy(biAbsLinearCoeff, biT, sizeof(biT));
 		}
 		else {
@@ -3566,19 +6239,23 @@ static void sieveThread(Znum &result) {
 												   // Get B mod current prime. 
 			memcpy(biAbsLinearCoeff, biLinearCoeff, sizeof(biLinearCoeff));
 		}
-		for (NumberLengthB = NumberLength; NumberLengthB >= 2; NumberLengthB--) {
+		for (NumberLengthB = NumberLengthSiqs; NumberLengthB >= 2; NumberLengthB--) {
 			if (biAbsLinearCoeff[NumberLengthB - 1] != 0)
 			{                                // Go out if significant limb.
 				break;
 			}
 		}
+		memcpy(primeSieveData->difsoln, firstPrimeSieveData->difsoln,
+			nbrFactorBasePrimes * sizeof(int));
+		memcpy(primeSieveData->Bainv2_0, firstPrimeSieveData->Bainv2_0,
+			nbrFactorBasePrimes * sizeof(int));
+		for (i = 0; i < nbrFactorsA - 1; i++) {
+			memcpy(primeSieveData->Bainv2[i], firstPrimeSieveData->Bainv2[i],
+				nbrFactorBasePrimes * sizeof(int));
+		}
 		for (i = nbrFactorBasePrimes - 1; i>0; i--)
 		{
 			double dRem, dCurrentPrime;
-			rowPrimeSieveData = &primeSieveData[i];
-			rowPrimeSieveData0 = firstPrimeSieveData + i;
-			rowPrimeSieveData->difsoln = rowPrimeSieveData0->difsoln;
-			rowPrimeSieveData->Bainv2_0 = rowPrimeSieveData0->Bainv2_0;
 			rowPrimeTrialDivisionData = &primeTrialDivisionData[i];
 			currentPrime = rowPrimeTrialDivisionData->value;     // Get current prime.
 			dCurrentPrime = (double)currentPrime;
@@ -3596,94 +6273,54 @@ static void sieveThread(Znum &result) {
 			{
 				RemB = currentPrime - RemB;
 			}
-			dRem = (double)inverseA * (double)(rowPrimeSieveData0->modsqrt + RemB) +
+			dRem = (double)inverseA * (double)(primeSieveData->modsqrt[i] + RemB) +
 				(double)SieveLimit;
 			dRem -= floor(dRem / dCurrentPrime)*dCurrentPrime;
-			rowPrimeSieveData->soln1 = (int)dRem;
+			primeSieveData->soln1[i] = (int)dRem;
 		}
 
 		do 	{                       // For each polynomial...
-			if (congruencesFound >= matrixBLength /*|| factorSiqs != null*/)
+			if (congruencesFound >= matrixBLength)
 			{
-				if (nbrThreadFinishedPolySet > numberThreads*polySet) {
-					break;
-				}
-				//synchronized(amodq)
-				{
-					nbrThreadFinishedPolySet++;
-				}
-				return;             // Another thread finished factoring.
-			}
-			if (onlyFactoring) 	{
-				polynomialsSieved += 2;
+				break;             // Another thread finished sieving.
 			}
+			polynomialsSieved += 2;    // reported in metrics file
 			/***************/
 			/* Sieve stage */
 			/***************/
 			PerformSiqsSieveStage(primeSieveData, SieveArray,
 				PolynomialIndex,
 				biLinearCoeff,
-				NumberLength);
+				NumberLengthSiqs, buckets);
 			ValuesSieved += 2 * SieveLimit;
 			/************************/
 			/* Trial division stage */
 			/************************/
-			index2 = 2 * SieveLimit - 1;
-			do {
-				index2 -= 16;
-				if (((SieveArray[index2 + 1] | SieveArray[index2 + 2] |
-					SieveArray[index2 + 3] | SieveArray[index2 + 4] |
-					SieveArray[index2 + 5] | SieveArray[index2 + 6] |
-					SieveArray[index2 + 7] | SieveArray[index2 + 8] |
-					SieveArray[index2 + 9] | SieveArray[index2 + 10] |
-					SieveArray[index2 + 11] | SieveArray[index2 + 12] |
-					SieveArray[index2 + 13] | SieveArray[index2 + 14] |
-					SieveArray[index2 + 15] | SieveArray[index2 + 16]) & 0x8080) != 0)
-				{
-					for (i = 16; i>0; i--) {
-						if ((SieveArray[index2 + i] & 0x80) != 0) {
-							if (congruencesFound >= matrixBLength)
-							{       // All congruences were found: stop sieving.
-								index2 = 0;
-								break;
-							}
-							SieveLocationHit(rowMatrixB,
-								rowMatrixBbeforeMerge,
-								index2 + i, primeSieveData,
-								rowPartials,
-								rowSquares,
-								biDividend, NumberLength, biT,
-								biLinearCoeff, biR, biU, biV,
-								indexFactorsA, false);
-							if (congruencesFound >= matrixBLength)
-							{               // All congruences were found: stop sieving.
-								index2 = 0;
-								break;
-							}
-						}
-						if (SieveArray[index2 + i] < 0) {
-							if (congruencesFound >= matrixBLength)
-							{       // All congruences were found: stop sieving.
-								index2 = 0;
-								break;
-							}
-							SieveLocationHit(rowMatrixB,
-								rowMatrixBbeforeMerge,
-								index2 + i, primeSieveData,
-								rowPartials,
-								rowSquares,
-								biDividend, NumberLength, biT,
-								biLinearCoeff, biR, biU, biV,
-								indexFactorsA, true);
-							if (congruencesFound >= matrixBLength)
-							{               // All congruences were found: stop sieving.
-								index2 = 0;
-								break;
-							}
-						}
-					}
+			nbrHits = SieveScan((const unsigned char *)SieveArray,
+				2 * SieveLimit * (int)sizeof(SieveArray[0]), sieveHits.data());
+			/* resieving only pays if there are several candidates */
+			resieve = (nbrHits >= RESIEVE_MIN_HITS);
+			if (resieve) {
+				ResieveCandidates(primeSieveData, (const unsigned char *)SieveArray,
+					sieveHits.data(), nbrHits, resievedPrimes);
+			}
+			for (i = 0; i < nbrHits; i++) {
+				if (congruencesFound >= matrixBLength)
+				{       // All congruences were found: stop sieving.
+					break;
 				}
-			} while (index2 > 0);
+				// even offsets are for the even polynomial (low byte).
+				SieveLocationHit(rowMatrixB,
+					rowMatrixBbeforeMerge,
+					sieveHits[i] >> 1, primeSieveData,
+					rowPartials,
+					rowSquares,
+					biDividend, NumberLengthSiqs, biT,
+					biLinearCoeff, biR, biU, biV,
+					indexFactorsA, (sieveHits[i] & 1) != 0,
+					resieve ? resievedPrimes[i].data() : NULL,
+					resieve ? (int)resievedPrimes[i].size() : 0);
+			}
 			/*******************/
 			/* Next polynomial */
 			/*******************/